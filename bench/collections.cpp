@@ -0,0 +1,78 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../src/interpreter.hpp"
+#include "../src/parser/parser.hpp"
+#include "../src/resolver.hpp"
+#include "../src/scanner.hpp"
+
+namespace {
+struct Script {
+  explicit Script(std::string const& source)
+      : statements_{Parser::parse(Scanner::scan_tokens(source))},
+        resolution_{Resolver::resolve(statements_)} {}
+
+  auto run() const -> void { Interpreter::interpret(statements_, resolution_); }
+
+  std::vector<Statement> statements_;
+  std::unordered_map<Token, std::size_t> resolution_;
+};
+
+auto run(benchmark::State& state, std::string const& body) -> void {
+  Script const script{"var n = " + std::to_string(state.range(0)) + ";\n" +
+                      body};
+  for (auto _ : state) {
+    script.run();
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          state.range(0));
+}
+
+std::string const fill_list{
+    "var xs = List();\n"
+    "for (var i = 0; i < n; i = i + 1) push(xs, i);\n"};
+
+std::string const fill_map{
+    "var m = Map();\n"
+    "for (var i = 0; i < n; i = i + 1) m[i] = i;\n"};
+
+// Scripts that read a collection have to build it first, so their time
+// includes that of BM_ListAppend or BM_MapInsert for the same size.
+
+auto BM_ListAppend(benchmark::State& state) -> void { run(state, fill_list); }
+
+auto BM_ListIndex(benchmark::State& state) -> void {
+  run(state, fill_list +
+                 "for (var i = 0; i < n; i = i + 1) {\n"
+                 "  xs[n - 1 - i] = xs[i] + 1;\n"
+                 "}\n");
+}
+
+auto BM_ListIterate(benchmark::State& state) -> void {
+  run(state, fill_list +
+                 "var sum = 0;\n"
+                 "var size = len(xs);\n"
+                 "for (var i = 0; i < size; i = i + 1) {\n"
+                 "  sum = sum + xs[i];\n"
+                 "}\n");
+}
+
+auto BM_MapInsert(benchmark::State& state) -> void { run(state, fill_map); }
+
+auto BM_MapLookup(benchmark::State& state) -> void {
+  run(state, fill_map +
+                 "var sum = 0;\n"
+                 "for (var i = 0; i < n; i = i + 1) {\n"
+                 "  sum = sum + m[n - 1 - i];\n"
+                 "}\n");
+}
+}  // namespace
+
+BENCHMARK(BM_ListAppend)->Arg(1'000'000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ListIndex)->Arg(1'000'000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ListIterate)->Arg(1'000'000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_MapInsert)->Arg(1'000'000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_MapLookup)->Arg(1'000'000)->Unit(benchmark::kMillisecond);
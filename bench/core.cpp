@@ -0,0 +1,67 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <string_view>
+#include <variant>
+
+#include "../src/core.hpp"
+#include "../src/output.hpp"
+
+namespace {
+class Discard : public Output::Sink {
+ public:
+  ~Discard() override { flush(); }
+
+ protected:
+  auto emit(std::string_view const bytes) -> void override {
+    benchmark::DoNotOptimize(bytes.data());
+  }
+};
+
+// A typical per-request script: read an input, compute, print a result.
+std::string const source{
+    "fun score(x) { return x * 2 + 1; }\n"
+    "var result = score(input);\n"
+    "print result;\n"};
+
+auto script() -> Core::Script {
+  return std::get<Core::Script>(Core::compile(source, {"input"}));
+}
+
+auto BM_CompileAndExecute(benchmark::State& state) -> void {
+  Discard out{};
+  double input{0};
+  for (auto _ : state) {
+    Core::Globals globals{};
+    globals.define("input", ++input);
+    benchmark::DoNotOptimize(
+        Core::execute(script(), globals, out).has_value());
+  }
+}
+
+auto BM_ExecuteInFreshGlobals(benchmark::State& state) -> void {
+  Core::Script const compiled{script()};
+  Discard out{};
+  double input{0};
+  for (auto _ : state) {
+    Core::Globals globals{};
+    globals.define("input", ++input);
+    benchmark::DoNotOptimize(Core::execute(compiled, globals, out).has_value());
+  }
+}
+
+auto BM_ExecuteInReusedGlobals(benchmark::State& state) -> void {
+  Core::Script const compiled{script()};
+  Core::Globals globals{};
+  Discard out{};
+  double input{0};
+  for (auto _ : state) {
+    globals.define("input", ++input);
+    benchmark::DoNotOptimize(Core::execute(compiled, globals, out).has_value());
+  }
+}
+}  // namespace
+
+BENCHMARK(BM_CompileAndExecute)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ExecuteInFreshGlobals)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ExecuteInReusedGlobals)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,201 @@
+#include <benchmark/benchmark.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../src/memory.hpp"
+#include "../src/parser/parser.hpp"
+#include "../src/phases.hpp"
+#include "../src/resolver.hpp"
+#include "../src/scanner.hpp"
+
+namespace {
+constexpr std::size_t NESTING{32};
+constexpr std::size_t CHAIN{128};
+
+// Classes with fields and methods calling each other
+auto write_class(std::ostringstream& out, std::size_t const i) -> void {
+  out << "class C" << i << " {\n"
+      << "  init(a, b) { this.a = a; this.b = b; }\n"
+      << "  sum() { return this.a + this.b; }\n"
+      << "  scaled(k) { return this.sum() * k - " << i << "; }\n"
+      << "  swap() { var t = this.a; this.a = this.b; this.b = t; }\n"
+      << "}\n";
+}
+
+// Blocks, branches and loops nested NESTING deep, each with a local
+auto write_nesting(std::ostringstream& out, std::size_t const i) -> void {
+  out << "fun f" << i << "(n) {\n";
+  for (std::size_t depth = 0; depth < NESTING; ++depth) {
+    out << (depth % 2 == 0 ? "if (n > " : "while (n > ") << depth << ") {\n"
+        << "var v" << depth << " = n - " << depth + i % 7 << ";\n";
+  }
+  out << "n = n - 1;\n" << std::string(NESTING, '}') << "\nreturn n;\n}\n";
+}
+
+// One expression of CHAIN operands, some of them grouped or negated
+auto write_chain(std::ostringstream& out, std::size_t const i) -> void {
+  static constexpr char const* operators[]{" + ", " * ", " - ", " / "};
+  out << "fun e" << i << "(x, y) {\n  return x";
+  for (std::size_t operand = 1; operand < CHAIN; ++operand) {
+    out << operators[(i + operand) % 4];
+    switch (operand % 5) {
+      case 0:
+        out << "(x - " << operand << ")";
+        break;
+      case 1:
+        out << "-y";
+        break;
+      default:
+        out << (operand % 2 == 0 ? "x" : "y");
+    }
+  }
+  out << ";\n}\n";
+}
+
+// A string literal of a few hundred to a few thousand characters
+auto write_string(std::ostringstream& out, std::size_t const i) -> void {
+  out << "var s" << i << " = \"";
+  std::size_t const length{512 + (i * 977) % 3584};
+  for (std::size_t c = 0; c < length; ++c) {
+    out << static_cast<char>('a' + (i + c) % 26);
+  }
+  out << "\";\n";
+}
+
+/**
+ * A program of at least the given size, the same on every run and every
+ * platform: classes, deeply nested functions, long expressions and long
+ * strings, in turn.
+ */
+auto generate(std::size_t const bytes) -> std::string {
+  std::ostringstream out{};
+  for (std::size_t i = 0; static_cast<std::size_t>(out.tellp()) < bytes;
+       ++i) {
+    switch (i % 4) {
+      case 0:
+        write_class(out, i);
+        break;
+      case 1:
+        write_nesting(out, i);
+        break;
+      case 2:
+        write_chain(out, i);
+        break;
+      default:
+        write_string(out, i);
+    }
+  }
+  return out.str();
+}
+
+// Generated once per size, as every benchmark of a size runs many times
+auto source(std::size_t const bytes) -> std::string const& {
+  static std::map<std::size_t, std::string> sources{};
+  auto [source, generated]{sources.try_emplace(bytes)};
+  if (generated) {
+    source->second = generate(bytes);
+  }
+  return source->second;
+}
+
+auto count_nodes(std::vector<Statement> const& statements) -> std::size_t {
+  Phases::Report report{};
+  report.count(statements);
+  return report.nodes_;
+}
+
+// What the front end processed each iteration: nodes only once parsed
+auto set_throughput(benchmark::State& state, std::size_t const bytes,
+                    std::size_t const tokens, std::size_t const nodes)
+    -> void {
+  state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          static_cast<std::int64_t>(bytes));
+  state.counters["tokens_per_second"] = benchmark::Counter(
+      static_cast<double>(tokens),
+      benchmark::Counter::kIsIterationInvariantRate);
+  if (nodes != 0) {
+    state.counters["nodes_per_second"] = benchmark::Counter(
+        static_cast<double>(nodes),
+        benchmark::Counter::kIsIterationInvariantRate);
+  }
+}
+
+auto BM_Scan(benchmark::State& state) -> void {
+  std::string const& contents{
+      source(static_cast<std::size_t>(state.range(0)))};
+  std::size_t tokens{0};
+  std::int64_t retained{0};
+  for (auto _ : state) {
+    std::int64_t const before{Memory::live_bytes()};
+    std::vector<Token> scanned{Scanner::scan_tokens(contents)};
+    retained = Memory::live_bytes() - before;
+    tokens = scanned.size();
+
+    state.PauseTiming();
+    scanned.clear();
+    state.ResumeTiming();
+  }
+  set_throughput(state, contents.size(), tokens, 0);
+  state.counters["bytes_per_token"] =
+      static_cast<double>(retained) / static_cast<double>(tokens);
+}
+
+auto BM_Parse(benchmark::State& state) -> void {
+  std::string const& contents{
+      source(static_cast<std::size_t>(state.range(0)))};
+  std::vector<Token> const tokens{Scanner::scan_tokens(contents)};
+  std::size_t nodes{0};
+  std::int64_t retained{0};
+  for (auto _ : state) {
+    std::int64_t const before{Memory::live_bytes()};
+    std::vector<Statement> statements{Parser::parse(tokens)};
+    retained = Memory::live_bytes() - before;
+
+    state.PauseTiming();
+    if (nodes == 0) {
+      nodes = count_nodes(statements);
+    }
+    statements.clear();
+    state.ResumeTiming();
+  }
+  set_throughput(state, contents.size(), tokens.size(), nodes);
+  state.counters["bytes_per_node"] =
+      static_cast<double>(retained) / static_cast<double>(nodes);
+}
+
+auto BM_Resolve(benchmark::State& state) -> void {
+  std::string const& contents{
+      source(static_cast<std::size_t>(state.range(0)))};
+  std::vector<Token> const tokens{Scanner::scan_tokens(contents)};
+  std::vector<Statement> const statements{Parser::parse(tokens)};
+  std::size_t const nodes{count_nodes(statements)};
+  std::int64_t retained{0};
+  for (auto _ : state) {
+    std::int64_t const before{Memory::live_bytes()};
+    std::unordered_map<Token, std::size_t> resolution{
+        Resolver::resolve(statements)};
+    retained = Memory::live_bytes() - before;
+
+    state.PauseTiming();
+    resolution.clear();
+    state.ResumeTiming();
+  }
+  set_throughput(state, contents.size(), tokens.size(), nodes);
+  state.counters["bytes_per_node"] =
+      static_cast<double>(retained) / static_cast<double>(nodes);
+}
+}  // namespace
+
+// Sources of 1 and 16 MiB
+BENCHMARK(BM_Scan)->Arg(1 << 20)->Arg(16 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Parse)->Arg(1 << 20)->Arg(16 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Resolve)
+    ->Arg(1 << 20)
+    ->Arg(16 << 20)
+    ->Unit(benchmark::kMillisecond);
@@ -0,0 +1,120 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <variant>
+
+#include "../src/core.hpp"
+#include "../src/output.hpp"
+#include "../src/tasks/context.hpp"
+#include "../src/types/generator.hpp"
+
+namespace {
+class Discard : public Output::Sink {
+ public:
+  ~Discard() override { flush(); }
+
+ protected:
+  auto emit(std::string_view const bytes) -> void override {
+    benchmark::DoNotOptimize(bytes.data());
+  }
+};
+
+constexpr std::int64_t YIELDS{10000};
+
+// Reports the time each of `count` yields per iteration takes, next to the
+// time of the whole iteration
+auto per_yield(benchmark::State& state, std::int64_t const count) -> void {
+  state.counters["per_yield"] = benchmark::Counter(
+      static_cast<double>(state.iterations() * count),
+      benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+// The switch every yield and every resume makes: one round trip is two
+Tasks::Context main_context{};
+Tasks::Context other_context{};
+
+auto bounce(void*) -> void {
+  while (true) {
+    Tasks::switch_context(other_context, main_context);
+  }
+}
+
+auto BM_ContextSwitchRoundTrip(benchmark::State& state) -> void {
+  Tasks::Stack stack{};
+  other_context.prepare(stack, &bounce, nullptr);
+  for (auto _ : state) {
+    Tasks::switch_context(main_context, other_context);
+  }
+  per_yield(state, 1);
+}
+
+// A generator with a native body, so that only suspending and resuming are
+// measured
+auto BM_NativeGenerator(benchmark::State& state) -> void {
+  auto const execution{std::make_shared<bool>(true)};
+  for (auto _ : state) {
+    LoxGenerator generator{[](LoxGenerator& self) {
+                             for (std::int64_t i = 0; i < YIELDS; ++i) {
+                               self.yield(static_cast<double>(i));
+                             }
+                           },
+                           execution};
+    while (!generator.done()) {
+      benchmark::DoNotOptimize(generator.next());
+    }
+  }
+  per_yield(state, YIELDS);
+}
+
+// The same loop, with and without a generator producing the values. The
+// difference is what a yield costs a script.
+std::string const loop{
+    "var total = 0;\n"
+    "var i = 0;\n"
+    "while (i < n) {\n"
+    "  total = total + i;\n"
+    "  i = i + 1;\n"
+    "}\n"
+    "print total;\n"};
+
+std::string const generated{
+    "fun count(n) {\n"
+    "  var i = 0;\n"
+    "  while (i < n) {\n"
+    "    yield i;\n"
+    "    i = i + 1;\n"
+    "  }\n"
+    "}\n"
+    "var total = 0;\n"
+    "var numbers = count(n);\n"
+    "while (!done(numbers)) {\n"
+    "  total = total + next(numbers);\n"
+    "}\n"
+    "print total;\n"};
+
+auto run_script(benchmark::State& state, std::string const& source) -> void {
+  Core::Script const script{
+      std::get<Core::Script>(Core::compile(source, {"n"}))};
+  Discard out{};
+  for (auto _ : state) {
+    Core::Globals globals{};
+    globals.define("n", static_cast<double>(YIELDS));
+    benchmark::DoNotOptimize(Core::execute(script, globals, out).has_value());
+  }
+  per_yield(state, YIELDS);
+}
+
+auto BM_ScriptLoop(benchmark::State& state) -> void { run_script(state, loop); }
+
+auto BM_ScriptGenerator(benchmark::State& state) -> void {
+  run_script(state, generated);
+}
+}  // namespace
+
+BENCHMARK(BM_ContextSwitchRoundTrip);
+BENCHMARK(BM_NativeGenerator)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ScriptLoop)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ScriptGenerator)->Unit(benchmark::kMillisecond);
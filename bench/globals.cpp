@@ -0,0 +1,55 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../src/interpreter.hpp"
+#include "../src/output.hpp"
+#include "../src/parser/parser.hpp"
+#include "../src/resolver.hpp"
+#include "../src/scanner.hpp"
+
+namespace {
+constexpr int READS{100'000};
+
+// A loop reading a global and calling a global function, nested in the given
+// number of blocks, each with a local of its own
+auto nested(int const depth) -> std::string {
+  std::string source{"var step = 1;\nfun add(a, b) { return a + b; }\n"};
+  for (int i = 0; i < depth; ++i) {
+    source += "{ var v" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+  }
+  source += "var total = 0;\n"
+            "for (var i = 0; i < " +
+            std::to_string(READS) +
+            "; i = i + 1) total = add(total, step);\n"
+            "print total;\n" +
+            std::string(depth, '}') + "\n";
+  return source;
+}
+
+// The cost of reaching globals should not depend on the depth
+auto BM_GlobalFromDepth(benchmark::State& state) -> void {
+  std::vector<Statement> const statements{Parser::parse(
+      Scanner::scan_tokens(nested(static_cast<int>(state.range(0)))))};
+  std::unordered_map<Token, std::size_t> const resolution{
+      Resolver::resolve(statements)};
+
+  for (auto _ : state) {
+    Output::MemorySink out{};
+    Interpreter::interpret(statements, resolution, out);
+    benchmark::DoNotOptimize(out.contents().data());
+  }
+  state.counters["per_read"] = benchmark::Counter(
+      static_cast<double>(state.iterations()) * READS,
+      benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+}  // namespace
+
+BENCHMARK(BM_GlobalFromDepth)
+    ->Arg(0)
+    ->Arg(16)
+    ->Arg(64)
+    ->Arg(256)
+    ->Unit(benchmark::kMillisecond);
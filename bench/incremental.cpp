@@ -0,0 +1,85 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+#include "../src/incremental.hpp"
+
+namespace {
+// Ten lines per function, plus a top-level call.
+auto generate_source(std::size_t const lines) -> std::string {
+  std::string source;
+  for (std::size_t i = 0; i < lines / 11; ++i) {
+    std::string const n{std::to_string(i)};
+    source += "fun f" + n + "(a, b) {\n";
+    source += "  var x = a + b * " + n + ";\n";
+    source += "  // keep the value of x below the threshold\n";
+    source += "  if (x > 10) {\n";
+    source += "    print x;\n";
+    source += "  } else {\n";
+    source += "    print \"small\";\n";
+    source += "  }\n";
+    source += "  return x;\n";
+    source += "}\n";
+    source += "var v" + n + " = f" + n + "(" + n + ", 2);\n";
+  }
+  return source;
+}
+
+std::string const source{generate_source(50'000)};
+
+// Right after the `x` of a declaration in the middle of the file
+auto middle_identifier() -> std::size_t {
+  return source.find("var x", source.size() / 2) + 5;
+}
+
+auto report(benchmark::State& state, Incremental::Document const& document)
+    -> void {
+  Incremental::Stats const stats{document.stats()};
+  state.counters["tokens_scanned"] = static_cast<double>(stats.tokens_scanned_);
+  state.counters["declarations_parsed"] =
+      static_cast<double>(stats.declarations_parsed_);
+  state.counters["declarations_reused"] =
+      static_cast<double>(stats.declarations_reused_);
+}
+
+auto BM_FullFrontEnd(benchmark::State& state) -> void {
+  for (auto _ : state) {
+    Incremental::Document const document{source};
+    benchmark::DoNotOptimize(document.statements().data());
+  }
+  state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          static_cast<std::int64_t>(source.size()));
+}
+
+// Renames `x` to `xy` and back in one function
+auto BM_SingleCharacterEdit(benchmark::State& state) -> void {
+  Incremental::Document document{source};
+  std::size_t const offset{middle_identifier()};
+  bool inserted{false};
+  for (auto _ : state) {
+    document.apply(inserted ? Incremental::Edit{offset, 1, ""}
+                            : Incremental::Edit{offset, 0, "y"});
+    inserted = !inserted;
+    benchmark::DoNotOptimize(document.statements().data());
+  }
+  report(state, document);
+}
+
+// Adds and removes a line, moving every declaration below it
+auto BM_NewlineEdit(benchmark::State& state) -> void {
+  Incremental::Document document{source};
+  std::size_t const offset{middle_identifier()};
+  bool inserted{false};
+  for (auto _ : state) {
+    document.apply(inserted ? Incremental::Edit{offset, 1, ""}
+                            : Incremental::Edit{offset, 0, "\n"});
+    inserted = !inserted;
+    benchmark::DoNotOptimize(document.statements().data());
+  }
+  report(state, document);
+}
+}  // namespace
+
+BENCHMARK(BM_FullFrontEnd)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SingleCharacterEdit)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_NewlineEdit)->Unit(benchmark::kMicrosecond);
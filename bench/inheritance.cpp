@@ -0,0 +1,77 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../src/interpreter.hpp"
+#include "../src/output.hpp"
+#include "../src/parser/parser.hpp"
+#include "../src/resolver.hpp"
+#include "../src/scanner.hpp"
+
+namespace {
+constexpr int CALLS{100'000};
+
+// A chain of classes, of which only the top one defines root(), ending in
+// Leaf, and a loop making the given call on an instance of Leaf
+auto hierarchy(int const depth, std::string const& leaf,
+               std::string const& call) -> std::string {
+  std::string source{"class C0 { root() { return 1; } }\n"};
+  for (int i = 1; i < depth; ++i) {
+    source += "class C" + std::to_string(i) + " < C" + std::to_string(i - 1) +
+              " {}\n";
+  }
+  source += "class Leaf < C" + std::to_string(depth - 1) + " { " + leaf +
+            " }\n"
+            "var leaf = Leaf();\n"
+            "var total = 0;\n"
+            "for (var i = 0; i < " +
+            std::to_string(CALLS) + "; i = i + 1) total = total + " + call +
+            ";\n"
+            "print total;\n";
+  return source;
+}
+
+auto run(benchmark::State& state, std::string const& source) -> void {
+  std::vector<Statement> const statements{
+      Parser::parse(Scanner::scan_tokens(source))};
+  std::unordered_map<Token, std::size_t> const resolution{
+      Resolver::resolve(statements)};
+
+  for (auto _ : state) {
+    Output::MemorySink out{};
+    Interpreter::interpret(statements, resolution, out);
+    benchmark::DoNotOptimize(out.contents().data());
+  }
+  state.counters["per_call"] = benchmark::Counter(
+      static_cast<double>(state.iterations()) * CALLS,
+      benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+// Calls a method inherited from the top of the hierarchy
+auto BM_InheritedMethod(benchmark::State& state) -> void {
+  run(state, hierarchy(static_cast<int>(state.range(0)), "", "leaf.root()"));
+}
+
+// Calls a method of the class, which calls the top of the hierarchy through
+// super
+auto BM_SuperCall(benchmark::State& state) -> void {
+  run(state, hierarchy(static_cast<int>(state.range(0)),
+                       "up() { return super.root(); }", "leaf.up()"));
+}
+}  // namespace
+
+// The cost of a call should not depend on the depth
+BENCHMARK(BM_InheritedMethod)
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(16)
+    ->Arg(64)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SuperCall)
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(16)
+    ->Arg(64)
+    ->Unit(benchmark::kMillisecond);
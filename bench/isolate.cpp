@@ -0,0 +1,51 @@
+#include <benchmark/benchmark.h>
+
+#include <future>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <variant>
+#include <vector>
+
+#include "../src/core.hpp"
+#include "../src/isolate.hpp"
+#include "../src/output.hpp"
+
+namespace {
+constexpr std::size_t ISOLATES{64};
+
+// A small CPU-bound batch job that allocates as it goes
+std::string const source{
+    "fun fib(n) { if (n <= 1) return n; return fib(n - 2) + fib(n - 1); }\n"
+    "var results = List();\n"
+    "for (var i = 0; i < 12; i = i + 1) push(results, fib(i));\n"
+    "print results;\n"};
+
+// Runs a batch of isolates on state.range(0) threads. Throughput should grow
+// with the number of threads, up to the number of cores.
+auto BM_IsolateBatch(benchmark::State& state) -> void {
+  Core::Script const script{std::get<Core::Script>(Core::compile(source))};
+  Core::Pool pool{static_cast<std::size_t>(state.range(0))};
+
+  for (auto _ : state) {
+    std::vector<std::unique_ptr<Core::Isolate>> isolates{};
+    std::vector<std::future<std::optional<Core::Error>>> results{};
+    for (std::size_t i = 0; i < ISOLATES; ++i) {
+      isolates.push_back(std::make_unique<Core::Isolate>(
+          script, std::make_unique<Output::MemorySink>()));
+      results.push_back(pool.submit(*isolates.back()));
+    }
+    for (auto& result : results) {
+      benchmark::DoNotOptimize(result.get().has_value());
+    }
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          static_cast<std::int64_t>(ISOLATES));
+}
+}  // namespace
+
+BENCHMARK(BM_IsolateBatch)
+    ->RangeMultiplier(2)
+    ->Range(1, 2 * std::max(1U, std::thread::hardware_concurrency()))
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
@@ -0,0 +1,326 @@
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+#include "../src/core.hpp"
+#include "../src/memory.hpp"
+#include "../src/output.hpp"
+#include "../src/utils/reader.hpp"
+
+#ifndef LOX_VERSION
+#define LOX_VERSION "unknown"
+#endif
+
+#ifndef LOX_BENCH_CORPUS
+#define LOX_BENCH_CORPUS "bench/corpus"
+#endif
+
+/**
+ * Runs whole Lox programs, from the corpus and generated, and reports what
+ * each took as JSON, so that results can be compared across releases. Each
+ * program runs in a process of its own, so that its peak RSS is its own.
+ */
+namespace {
+struct Options {
+  std::size_t repetitions_{5};
+  std::string corpus_{LOX_BENCH_CORPUS};
+  // Only the workloads whose names contain it
+  std::string filter_;
+  // Empty for standard output
+  std::string output_;
+};
+
+struct Workload {
+  std::string name_;
+  std::string source_;
+};
+
+// What a workload measured, as the process running it reports it. Times are
+// medians over the repetitions; the allocations are those of one repetition.
+struct Measurement {
+  bool failed_;
+  std::uint64_t compile_ns_;
+  std::uint64_t execute_ns_;
+  std::uint64_t execute_min_ns_;
+  std::uint64_t allocations_;
+  std::uint64_t allocated_bytes_;
+};
+
+struct Result {
+  std::string name_;
+  Measurement measurement_;
+  std::uint64_t peak_rss_bytes_;
+};
+
+class Discard : public Output::Sink {
+ public:
+  ~Discard() override { flush(); }
+
+ protected:
+  auto emit(std::string_view) -> void override {}
+};
+
+// Declares many functions and classes and calls each once, so that the time
+// goes to the front end
+auto generated_program() -> Workload {
+  constexpr std::size_t FUNCTIONS{2000};
+  std::ostringstream source{};
+  for (std::size_t i = 0; i < FUNCTIONS; ++i) {
+    source << "fun f" << i << "(a, b) {\n"
+           << "  var x = a + b * " << i << ";\n"
+           << "  if (x > " << i << ") { x = x - 1; } else { x = x + 1; }\n"
+           << "  while (x > 100) x = x / 2;\n"
+           << "  return x;\n"
+           << "}\n"
+           << "class C" << i << " {\n"
+           << "  get(a) { return a + " << i << "; }\n"
+           << "}\n";
+  }
+  source << "var total = 0;\n";
+  for (std::size_t i = 0; i < FUNCTIONS; ++i) {
+    source << "total = total + f" << i << "(1, 2) + C" << i << "().get(1);\n";
+  }
+  source << "print total;\n";
+  return {"generated", source.str()};
+}
+
+auto workloads(Options const& options) -> std::vector<Workload> {
+  std::vector<Workload> workloads{};
+  for (auto const& entry :
+       std::filesystem::directory_iterator{options.corpus_}) {
+    if (entry.path().extension() == ".txt") {
+      workloads.push_back({entry.path().stem().string(),
+                           Reader::read_file(entry.path().string())});
+    }
+  }
+  workloads.push_back(generated_program());
+
+  std::erase_if(workloads, [&](Workload const& workload) {
+    return workload.name_.find(options.filter_) == std::string::npos;
+  });
+  std::sort(workloads.begin(), workloads.end(),
+            [](Workload const& a, Workload const& b) {
+              return a.name_ < b.name_;
+            });
+  return workloads;
+}
+
+auto median(std::vector<std::uint64_t> values) -> std::uint64_t {
+  std::sort(values.begin(), values.end());
+  return values[values.size() / 2];
+}
+
+auto since(std::chrono::steady_clock::time_point const start)
+    -> std::uint64_t {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+}
+
+// Compiles and executes the workload, the front end bypassing the cache
+auto measure(Workload const& workload, std::size_t const repetitions)
+    -> Measurement {
+  Measurement measurement{};
+  std::vector<std::uint64_t> compile_ns{};
+  std::vector<std::uint64_t> execute_ns{};
+  for (std::size_t i = 0; i < repetitions; ++i) {
+    std::uint64_t const allocations{Memory::allocations()};
+    std::uint64_t const allocated_bytes{Memory::allocated_bytes()};
+
+    auto const start{std::chrono::steady_clock::now()};
+    auto compiled{Core::compile(workload.source_)};
+    compile_ns.push_back(since(start));
+    auto const script{std::get_if<Core::Script>(&compiled)};
+    if (!script) {
+      measurement.failed_ = true;
+      return measurement;
+    }
+
+    Discard out{};
+    auto const executing{std::chrono::steady_clock::now()};
+    measurement.failed_ = Core::execute(*script, out).has_value();
+    execute_ns.push_back(since(executing));
+
+    measurement.allocations_ = Memory::allocations() - allocations;
+    measurement.allocated_bytes_ = Memory::allocated_bytes() - allocated_bytes;
+    if (measurement.failed_) {
+      return measurement;
+    }
+  }
+  measurement.compile_ns_ = median(compile_ns);
+  measurement.execute_ns_ = median(execute_ns);
+  measurement.execute_min_ns_ =
+      *std::min_element(execute_ns.begin(), execute_ns.end());
+  return measurement;
+}
+
+// Measures the workload in a child process, which hands the measurement
+// back through a pipe
+auto run(Workload const& workload, std::size_t const repetitions)
+    -> std::optional<Result> {
+  int fds[2];
+  if (pipe(fds) != 0) {
+    return std::nullopt;
+  }
+
+  pid_t const child{fork()};
+  if (child == 0) {
+    close(fds[0]);
+    Measurement const measurement{measure(workload, repetitions)};
+    bool const written{write(fds[1], &measurement, sizeof(measurement)) ==
+                       sizeof(measurement)};
+    // Skips the destructors of what the parent left behind
+    _exit(written ? 0 : 1);
+  }
+  close(fds[1]);
+  if (child < 0) {
+    close(fds[0]);
+    return std::nullopt;
+  }
+
+  Measurement measurement{};
+  bool const read_all{read(fds[0], &measurement, sizeof(measurement)) ==
+                      sizeof(measurement)};
+  close(fds[0]);
+
+  int status{0};
+  rusage usage{};
+  wait4(child, &status, 0, &usage);
+  if (!read_all || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    return std::nullopt;
+  }
+  // Reported in kilobytes on Linux
+  return Result{workload.name_, measurement,
+                static_cast<std::uint64_t>(usage.ru_maxrss) * 1024};
+}
+
+auto timestamp() -> std::string {
+  std::time_t const now{std::time(nullptr)};
+  std::tm utc{};
+  gmtime_r(&now, &utc);
+  char text[32];
+  std::strftime(text, sizeof(text), "%Y-%m-%dT%H:%M:%SZ", &utc);
+  return text;
+}
+
+// Names come from file names, which may hold anything
+auto quote(std::string_view const text) -> std::string {
+  std::string quoted{"\""};
+  for (char const c : text) {
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+      quoted += c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      quoted += escaped;
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + '"';
+}
+
+auto report(std::ostream& out, Options const& options,
+            std::vector<Result> const& results) -> void {
+  out << "{\n"
+      << "  \"context\": {\n"
+      << "    \"version\": " << quote(LOX_VERSION) << ",\n"
+      << "    \"date\": " << quote(timestamp()) << ",\n"
+      << "    \"repetitions\": " << options.repetitions_ << "\n"
+      << "  },\n"
+      << "  \"benchmarks\": [";
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    Result const& result{results[i]};
+    Measurement const& measurement{result.measurement_};
+    out << (i == 0 ? "\n" : ",\n") << "    {\n"
+        << "      \"name\": " << quote(result.name_) << ",\n"
+        << "      \"failed\": " << (measurement.failed_ ? "true" : "false")
+        << ",\n"
+        << "      \"compile_ns\": " << measurement.compile_ns_ << ",\n"
+        << "      \"execute_ns\": " << measurement.execute_ns_ << ",\n"
+        << "      \"execute_min_ns\": " << measurement.execute_min_ns_ << ",\n"
+        << "      \"peak_rss_bytes\": " << result.peak_rss_bytes_ << ",\n"
+        << "      \"allocations\": " << measurement.allocations_ << ",\n"
+        << "      \"allocated_bytes\": " << measurement.allocated_bytes_
+        << "\n"
+        << "    }";
+  }
+  out << "\n  ]\n}\n";
+}
+
+auto parse_options(int argc, char* argv[]) -> std::optional<Options> {
+  Options options{};
+  for (int i = 1; i < argc; ++i) {
+    std::string_view const arg{argv[i]};
+    if (arg == "--repetitions") {
+      if (++i == argc || std::atoi(argv[i]) <= 0) {
+        return std::nullopt;
+      }
+      options.repetitions_ = static_cast<std::size_t>(std::atoi(argv[i]));
+    } else if (arg == "--filter") {
+      if (++i == argc) {
+        return std::nullopt;
+      }
+      options.filter_ = argv[i];
+    } else if (arg == "--output") {
+      if (++i == argc) {
+        return std::nullopt;
+      }
+      options.output_ = argv[i];
+    } else if (arg.starts_with("--")) {
+      return std::nullopt;
+    } else {
+      options.corpus_ = arg;
+    }
+  }
+  return options;
+}
+}  // namespace
+
+auto main(int argc, char* argv[]) -> int {
+  std::optional<Options> const options{parse_options(argc, argv)};
+  if (!options) {
+    std::cout << "Wrong! Correct usage: lox_bench [--repetitions n] "
+                 "[--filter name] [--output file] [corpus]\n";
+    return 1;
+  }
+
+  std::vector<Result> results{};
+  bool failed{false};
+  for (Workload const& workload : workloads(*options)) {
+    std::cerr << "[bench] " << workload.name_ << '\n';
+    if (std::optional<Result> result{run(workload, options->repetitions_)}) {
+      failed = failed || result->measurement_.failed_;
+      results.push_back(std::move(*result));
+    } else {
+      std::cerr << "[bench] " << workload.name_ << " crashed\n";
+      failed = true;
+    }
+  }
+
+  if (options->output_.empty()) {
+    report(std::cout, *options, results);
+  } else {
+    std::ofstream file{options->output_};
+    report(file, *options, results);
+  }
+  return failed ? 1 : 0;
+}
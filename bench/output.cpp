@@ -0,0 +1,41 @@
+#include <benchmark/benchmark.h>
+
+#include <fstream>
+
+#include "../src/output.hpp"
+
+namespace {
+// The numbers a print-heavy script produces: counters, sums and ratios.
+auto number(std::int64_t const i) -> double {
+  return i % 4 == 0 ? static_cast<double>(i) / 8 : static_cast<double>(i * 37);
+}
+
+// How print formatted numbers before output sinks
+auto BM_OstreamNumbers(benchmark::State& state) -> void {
+  std::ofstream out{"/dev/null"};
+  for (auto _ : state) {
+    for (std::int64_t i = 0; i < state.range(0); ++i) {
+      out << number(i) << '\n';
+    }
+    out.flush();
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          state.range(0));
+}
+
+auto BM_SinkNumbers(benchmark::State& state) -> void {
+  Output::FileSink out{"/dev/null"};
+  for (auto _ : state) {
+    for (std::int64_t i = 0; i < state.range(0); ++i) {
+      out.write(number(i));
+      out.write('\n');
+    }
+    out.flush();
+  }
+  state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          state.range(0));
+}
+}  // namespace
+
+BENCHMARK(BM_OstreamNumbers)->Arg(10'000'000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SinkNumbers)->Arg(10'000'000)->Unit(benchmark::kMillisecond);
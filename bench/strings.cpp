@@ -0,0 +1,39 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../src/interpreter.hpp"
+#include "../src/output.hpp"
+#include "../src/parser/parser.hpp"
+#include "../src/resolver.hpp"
+#include "../src/scanner.hpp"
+
+namespace {
+// Builds a string of state.range(0) bytes out of ten-byte pieces, then
+// compares it, which needs all of its characters.
+auto BM_BuildString(benchmark::State& state) -> void {
+  std::string const source{
+      "var n = " + std::to_string(state.range(0) / 10) +
+      ";\n"
+      "var s = \"\";\n"
+      "for (var i = 0; i < n; i = i + 1) s = s + \"0123456789\";\n"
+      "print len(s);\n"
+      "print s == \"\";\n"};
+  std::vector<Statement> const statements{
+      Parser::parse(Scanner::scan_tokens(source))};
+  std::unordered_map<Token, std::size_t> const resolution{
+      Resolver::resolve(statements)};
+
+  for (auto _ : state) {
+    Output::MemorySink out{};
+    Interpreter::interpret(statements, resolution, out);
+    benchmark::DoNotOptimize(out.contents().data());
+  }
+  state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations()) *
+                          state.range(0));
+}
+}  // namespace
+
+BENCHMARK(BM_BuildString)->Arg(10'000'000)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,90 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <string_view>
+#include <variant>
+
+#include "../src/core.hpp"
+#include "../src/output.hpp"
+
+namespace {
+class Discard : public Output::Sink {
+ public:
+  ~Discard() override { flush(); }
+
+ protected:
+  auto emit(std::string_view const bytes) -> void override {
+    benchmark::DoNotOptimize(bytes.data());
+  }
+};
+
+// The same independent jobs, either called one after the other or spawned as
+// tasks. The ratio of the two is the speedup, which should approach the
+// number of cores.
+std::string const work{
+    "fun fib(n) { if (n <= 1) return n; return fib(n - 2) + fib(n - 1); }\n"
+    "var jobs = 64;\n"};
+
+std::string const sequential{work +
+                             "var total = 0;\n"
+                             "for (var i = 0; i < jobs; i = i + 1) {\n"
+                             "  total = total + fib(12);\n"
+                             "}\n"
+                             "print total;\n"};
+
+std::string const spawned{work +
+                          "var tasks = List();\n"
+                          "for (var i = 0; i < jobs; i = i + 1) {\n"
+                          "  push(tasks, spawn fib(12));\n"
+                          "}\n"
+                          "var total = 0;\n"
+                          "for (var i = 0; i < jobs; i = i + 1) {\n"
+                          "  total = total + join(tasks[i]);\n"
+                          "}\n"
+                          "print total;\n"};
+
+// Tasks handing values along a chain of channels
+std::string const pipeline{
+    "fun relay(from, to) {\n"
+    "  var v = receive(from);\n"
+    "  while (v != nil) { send(to, v + 1); v = receive(from); }\n"
+    "  send(to, nil);\n"
+    "}\n"
+    "var first = Channel(16);\n"
+    "var last = first;\n"
+    "for (var i = 0; i < 8; i = i + 1) {\n"
+    "  var next = Channel(16);\n"
+    "  spawn relay(last, next);\n"
+    "  last = next;\n"
+    "}\n"
+    "fun produce(to) {\n"
+    "  for (var i = 0; i < 1000; i = i + 1) send(to, i);\n"
+    "  send(to, nil);\n"
+    "}\n"
+    "spawn produce(first);\n"
+    "var count = 0;\n"
+    "while (receive(last) != nil) count = count + 1;\n"
+    "print count;\n"};
+
+auto run(benchmark::State& state, std::string const& source) -> void {
+  Core::Script const script{std::get<Core::Script>(Core::compile(source))};
+  Discard out{};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(Core::execute(script, out).has_value());
+  }
+}
+
+auto BM_JobsSequential(benchmark::State& state) -> void {
+  run(state, sequential);
+}
+
+auto BM_JobsSpawned(benchmark::State& state) -> void { run(state, spawned); }
+
+auto BM_ChannelPipeline(benchmark::State& state) -> void {
+  run(state, pipeline);
+}
+}  // namespace
+
+BENCHMARK(BM_JobsSequential)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_JobsSpawned)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ChannelPipeline)->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,28 @@
+#ifndef LOX_BUDGET
+#define LOX_BUDGET
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+/**
+ * Limits on what one execution of a script may use, so that an untrusted
+ * script can't run away with a core or the memory. Exceeding any of them
+ * stops the execution with a BudgetError.
+ *
+ * The counts are checked as loops go round and as functions are called,
+ * once every so many statements, so they may be overrun by a little. Time
+ * spent waiting, on a task or a channel, is not interrupted.
+ */
+struct Budget {
+  std::optional<std::uint64_t> statements_{};
+  // Allocated on the heap during the execution and not freed yet
+  std::optional<std::uint64_t> heap_bytes_{};
+  std::optional<std::chrono::nanoseconds> wall_time_{};
+  // Calls in progress on any one stack, which otherwise fails with "Stack
+  // overflow." millions of calls deep
+  std::optional<std::size_t> call_depth_{};
+};
+
+#endif
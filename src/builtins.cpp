@@ -1,28 +1,224 @@
 #include "./builtins.hpp"
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <variant>
 
-consteval auto Clock::arity() -> std::size_t { return 0; }
+#include "./io/loop.hpp"
+#include "./types/generator.hpp"
+#include "./types/list.hpp"
+#include "./types/map.hpp"
+#include "./types/object.hpp"
+#include "./types/rope.hpp"
+#include "./types/task.hpp"
+#include "./utils/error.hpp"
 
-consteval auto Clock::to_string() const -> std::string { return "Clock"; }
-/*
-auto Clock::operator()(Interpreter& interpreter, std::vector<Object>& args)
-    -> Object {
-  static_cast<void>(interpreter);
-  static_cast<void>(args);
+namespace {
+// Seconds on a monotonic clock, with sub-microsecond resolution. Only the
+// difference between two readings is meaningful.
+auto clock_seconds() -> double {
+  return std::chrono::duration<double>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+auto make_list() -> std::shared_ptr<LoxList> {
+  return std::make_shared<LoxList>();
+}
+
+auto make_map() -> std::shared_ptr<LoxMap> {
+  return std::make_shared<LoxMap>();
+}
+
+// The number of elements of a list or entries of a map, or the number of
+// bytes of a string.
+auto length(Object const& obj) -> double {
+  if (auto const list{std::get_if<std::shared_ptr<LoxList>>(&obj)}) {
+    return static_cast<double>((*list)->elements_.size());
+  }
+  if (auto const map{std::get_if<std::shared_ptr<LoxMap>>(&obj)}) {
+    return static_cast<double>((*map)->size());
+  }
+  if (auto const str{std::get_if<std::string>(&obj)}) {
+    return static_cast<double>(str->size());
+  }
+  if (auto const rope{std::get_if<std::shared_ptr<LoxRope>>(&obj)}) {
+    return static_cast<double>((*rope)->size());
+  }
+  throw NativeError{"Only lists, maps and strings have a length."};
+}
+
+auto push(std::shared_ptr<LoxList> const& list, Object const& value) -> void {
+  list->elements_.push_back(value);
+}
+
+auto pop(std::shared_ptr<LoxList> const& list) -> Object {
+  if (list->elements_.empty()) {
+    throw NativeError{"Can't pop from an empty list."};
+  }
+  Object value{std::move(list->elements_.back())};
+  list->elements_.pop_back();
+  return value;
+}
+
+auto keys(std::shared_ptr<LoxMap> const& map) -> std::shared_ptr<LoxList> {
+  auto const list{make_list()};
+  list->elements_.reserve(map->size());
+  map->for_each([&list](Object const& key, Object const&) {
+    list->elements_.push_back(key);
+  });
+  return list;
+}
+
+auto has(std::shared_ptr<LoxMap> const& map, Object const& key) -> bool {
+  return map->find(key) != nullptr;
+}
+
+auto remove_key(std::shared_ptr<LoxMap> const& map, Object const& key) -> bool {
+  return map->erase(key);
+}
+
+// Waits for a task and returns a copy of its result, or fails with its error
+auto join(std::shared_ptr<LoxTask> const& task) -> Object {
+  return task->join();
+}
 
-  return static_cast<double>(
-      std::chrono::duration_cast<std::chrono::seconds>(
-          std::chrono::system_clock::now().time_since_epoch())
-          .count());
+auto make_channel(double const capacity) -> std::shared_ptr<LoxChannel> {
+  if (capacity < 1 || capacity != std::floor(capacity)) {
+    throw NativeError{"Channel capacity must be a positive integer."};
+  }
+  // Beyond any buffer that fits in memory anyway
+  return std::make_shared<LoxChannel>(
+      static_cast<std::size_t>(std::min(capacity, 0x1p53)));
 }
-*/
-auto builtins() -> std::map<std::string, int> {
-  // TODO
-  return {};
+
+auto send(std::shared_ptr<LoxChannel> const& channel, Object const& value)
+    -> void {
+  channel->send(value);
+}
+
+auto receive(std::shared_ptr<LoxChannel> const& channel) -> Object {
+  return channel->receive();
+}
+
+// The I/O loop of a set of builtins. Started by the first operation, so that
+// scripts doing no I/O start no thread of their own.
+class LazyLoop {
+ public:
+  auto get() -> Io::Loop& {
+    std::call_once(started_, [this] {
+      loop_ = std::make_unique<Io::Loop>(Io::Loop::default_kind());
+    });
+    return *loop_;
+  }
+
+ private:
+  std::once_flag started_;
+  std::unique_ptr<Io::Loop> loop_;
+};
+
+// Finishes a task with the outcome of an I/O operation, once it completes
+template <typename T, typename F>
+auto complete(std::shared_ptr<LoxTask> task, F const convert)
+    -> Io::Callback<T> {
+  return [task = std::move(task), convert](Io::Result<T> result) {
+    if (auto const error{std::get_if<Io::Error>(&result)}) {
+      task->fail(std::make_exception_ptr(NativeError{error->message_}));
+    } else {
+      task->finish(convert(std::move(std::get<T>(result))));
+    }
+  };
+}
+
+// The I/O builtins start an operation and return a task at once. Joining it
+// gives the result.
+auto read_file(LazyLoop& io, std::string const& path)
+    -> std::shared_ptr<LoxTask> {
+  auto const task{std::make_shared<LoxTask>(true)};
+  io.get().read_file(
+      path, complete<std::string>(task, [](std::string contents) -> Object {
+        return contents;
+      }));
+  return task;
+}
+
+// Joins to the number of bytes written
+auto write_file(LazyLoop& io, std::string const& path,
+                std::string const& contents) -> std::shared_ptr<LoxTask> {
+  auto const task{std::make_shared<LoxTask>(true)};
+  io.get().write_file(
+      path, contents, complete<std::size_t>(task, [](std::size_t bytes) {
+        return Object{static_cast<double>(bytes)};
+      }));
+  return task;
+}
+
+// Joins to the next line of the standard input, or nil at its end
+auto read_line(LazyLoop& io) -> std::shared_ptr<LoxTask> {
+  auto const task{std::make_shared<LoxTask>(true)};
+  io.get().read_line(complete<std::optional<std::string>>(
+      task, [](std::optional<std::string> line) -> Object {
+        if (line) {
+          return std::move(*line);
+        }
+        return std::monostate{};
+      }));
+  return task;
+}
+
+// Joins to nil once the given number of seconds has passed
+auto timer(LazyLoop& io, double const seconds) -> std::shared_ptr<LoxTask> {
+  if (!(seconds >= 0)) {
+    throw NativeError{"Timer delay must be a non-negative number."};
+  }
+  auto const task{std::make_shared<LoxTask>(true)};
+  // Capped where nanoseconds would overflow, decades away
+  io.get().timer(
+      std::chrono::ceil<std::chrono::nanoseconds>(
+          std::chrono::duration<double>{std::min(seconds, 1e9)}),
+      [task] { task->finish(std::monostate{}); });
+  return task;
+}
+
+// Resumes a generator up to its next yield, and returns the value yielded
+auto next(std::shared_ptr<LoxGenerator> const& generator) -> Object {
+  return generator->next();
+}
+
+auto done(std::shared_ptr<LoxGenerator> const& generator) -> bool {
+  return generator->done();
 }
+}  // namespace
 
-auto global_env() -> std::map<std::string, int> {
-  // TODO
-  return {};
+auto builtins() -> std::map<std::string, Object> {
+  auto const io{std::make_shared<LazyLoop>()};
+  return {
+      {"clock", Native::function<clock_seconds>("clock")},
+      {"List", Native::function<make_list>("List")},
+      {"Map", Native::function<make_map>("Map")},
+      {"len", Native::function<length>("len")},
+      {"push", Native::function<push>("push")},
+      {"pop", Native::function<pop>("pop")},
+      {"keys", Native::function<keys>("keys")},
+      {"has", Native::function<has>("has")},
+      {"remove", Native::function<remove_key>("remove")},
+      {"join", Native::function<join>("join")},
+      {"Channel", Native::function<make_channel>("Channel")},
+      {"send", Native::function<send>("send")},
+      {"receive", Native::function<receive>("receive")},
+      {"next", Native::function<next>("next")},
+      {"done", Native::function<done>("done")},
+      {"readFile", Native::function<read_file>("readFile", io)},
+      {"writeFile", Native::function<write_file>("writeFile", io)},
+      {"readLine", Native::function<read_line>("readLine", io)},
+      {"timer", Native::function<timer>("timer", io)},
+  };
 }
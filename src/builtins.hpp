@@ -1,24 +1,157 @@
 #ifndef LOX_GLOBALS
 #define LOX_GLOBALS
 
-#include <time.h>
-
 #include <map>
+#include <memory>
 #include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
 #include <vector>
 
-// #include "./interpreter.hpp"
-// #include "./types/object.hpp"
+#include "./types/class.hpp"
+#include "./types/function.hpp"
+#include "./types/generator.hpp"
+#include "./types/list.hpp"
+#include "./types/map.hpp"
+#include "./types/native.hpp"
+#include "./types/object.hpp"
+#include "./types/rope.hpp"
+#include "./types/task.hpp"
+#include "./utils/error.hpp"
+
+namespace Native {
+template <typename T>
+auto type_name() -> std::string {
+  if constexpr (std::is_same_v<T, double>) {
+    return "number";
+  } else if constexpr (std::is_same_v<T, bool>) {
+    return "boolean";
+  } else if constexpr (std::is_same_v<T, std::string>) {
+    return "string";
+  } else if constexpr (std::is_same_v<T, std::shared_ptr<LoxList>>) {
+    return "list";
+  } else if constexpr (std::is_same_v<T, std::shared_ptr<LoxMap>>) {
+    return "map";
+  } else if constexpr (std::is_same_v<T, std::shared_ptr<LoxTask>>) {
+    return "task";
+  } else if constexpr (std::is_same_v<T, std::shared_ptr<LoxChannel>>) {
+    return "channel";
+  } else if constexpr (std::is_same_v<T, std::shared_ptr<LoxGenerator>>) {
+    return "generator";
+  } else {
+    return "value of another type";
+  }
+}
+
+/**
+ * Converts a Lox value to the type of a native parameter. Object parameters
+ * accept any value; every other parameter type must be an alternative of
+ * Object.
+ *
+ * @throws NativeError If the value holds a different alternative.
+ */
+template <typename T>
+auto unpack(Object const& arg, std::size_t const position) -> T const& {
+  if constexpr (std::is_same_v<T, Object>) {
+    return arg;
+  } else if constexpr (std::is_same_v<T, std::string>) {
+    // Ropes are strings too
+    if (std::string const* const str{as_string(arg)}) {
+      return *str;
+    }
+    throw NativeError{"Expected a " + type_name<T>() + " as argument " +
+                      std::to_string(position + 1) + "."};
+  } else {
+    if (auto const value{std::get_if<T>(&arg)}) {
+      return *value;
+    }
+    throw NativeError{"Expected a " + type_name<T>() + " as argument " +
+                      std::to_string(position + 1) + "."};
+  }
+}
 
-struct Clock {
-  consteval auto arity() -> std::size_t;
+// Calls f with the arguments converted to the types of Args, and converts
+// what it returns, if anything
+template <typename R, typename... Args, typename G>
+auto invoke(G const& f, std::vector<Object> const& args) -> Object {
+  return [&]<std::size_t... Is>(std::index_sequence<Is...>) -> Object {
+    if constexpr (std::is_void_v<R>) {
+      f(unpack<std::decay_t<Args>>(args[Is], Is)...);
+      return std::monostate{};
+    } else {
+      return Object{f(unpack<std::decay_t<Args>>(args[Is], Is)...)};
+    }
+  }(std::index_sequence_for<Args...>{});
+}
 
-  consteval auto to_string() const -> std::string;
+template <auto F, typename State = void>
+struct Adapter;
 
-  // auto operator()(Interpreter& interpreter, std::vector<Object>& args)
-  //     -> Object;
+/**
+ * Adapts a C++ function to NativeFunction::Signature. The arity and the
+ * conversions of the arguments and the result all follow from the type of the
+ * function, so calling it costs one indirect call plus the conversions.
+ */
+template <typename R, typename... Args, R (*F)(Args...)>
+struct Adapter<F> {
+  static constexpr std::size_t arity{sizeof...(Args)};
+
+  static auto call(void*, std::vector<Object> const& args) -> Object {
+    return invoke<R, Args...>(F, args);
+  }
 };
 
-auto builtins() -> std::map<std::string, int>;
+// As above, for a function taking the state of the native first
+template <typename State, typename R, typename... Args,
+          R (*F)(State&, Args...)>
+struct Adapter<F, State> {
+  static constexpr std::size_t arity{sizeof...(Args)};
+
+  static auto call(void* const state, std::vector<Object> const& args)
+      -> Object {
+    return invoke<R, Args...>(
+        [state](auto const&... unpacked) {
+          return F(*static_cast<State*>(state), unpacked...);
+        },
+        args);
+  }
+};
+
+/**
+ * Wraps a C++ function into a callable Lox value.
+ *
+ * @tparam F The function. Its parameters may be Object or any alternative of
+ * Object, taken by value or const reference. It may return void, Object or any
+ * alternative of Object.
+ * @param name The name the function is printed with.
+ */
+template <auto F>
+auto function(std::string name) -> Object {
+  return std::make_shared<NativeFunction>(
+      NativeFunction{std::move(name), Adapter<F>::arity, &Adapter<F>::call});
+}
+
+/**
+ * As above, for a function whose first parameter is a reference to the
+ * state, which the other parameters follow. The native keeps the state
+ * alive.
+ */
+template <auto F, typename State>
+auto function(std::string name, std::shared_ptr<State> state) -> Object {
+  return std::make_shared<NativeFunction>(
+      NativeFunction{std::move(name), Adapter<F, State>::arity,
+                     &Adapter<F, State>::call, std::move(state)});
+}
+}  // namespace Native
+
+/**
+ * Fresh instances of the native functions available to every script, by
+ * name. They are globals like any other, sharing the table of global slots,
+ * so a script that declares one of their names redefines it. Every set of
+ * globals gets its own, down to the I/O loop of the I/O builtins, so that
+ * nothing is shared between isolates.
+ */
+auto builtins() -> std::map<std::string, Object>;
 
 #endif
@@ -0,0 +1,128 @@
+#include "./cache.hpp"
+
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+#include "./serializer.hpp"
+#include "./types/program.hpp"
+
+#ifndef LOX_VERSION
+#define LOX_VERSION "unknown"
+#endif
+
+namespace {
+// 64-bit FNV-1a
+auto hash(std::string const& data, std::uint64_t seed = 0xcbf29ce484222325)
+    -> std::uint64_t {
+  for (char const c : data) {
+    seed ^= static_cast<unsigned char>(c);
+    seed *= 0x100000001b3;
+  }
+  return seed;
+}
+
+auto to_hex(std::uint64_t value) -> std::string {
+  constexpr char digits[]{"0123456789abcdef"};
+  std::string hex(16, '0');
+  for (auto it = hex.rbegin(); it != hex.rend(); ++it) {
+    *it = digits[value & 0xF];
+    value >>= 4;
+  }
+  return hex;
+}
+
+// The encoding and the source itself are stored in front of the encoded
+// program, so that neither a hash collision between sources nor an entry of
+// another encoding is ever mistaken for a hit.
+auto header(std::string const& source) -> std::string {
+  return Serializer::format_version() + '\n' + to_hex(source.size()) + source;
+}
+}  // namespace
+
+namespace Cache {
+Store::Store(std::filesystem::path directory)
+    : directory_{std::move(directory)}, stats_{0, 0} {}
+
+auto Store::load(std::string const& source) -> std::optional<Program> {
+  std::ifstream file(path_for(source), std::ios::binary);
+  if (file.is_open()) {
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string const contents{buffer.str()};
+
+    std::string const expected_header{header(source)};
+    if (contents.compare(0, expected_header.size(), expected_header) == 0) {
+      if (auto program{Serializer::deserialize(
+              contents.substr(expected_header.size()))}) {
+        ++stats_.hits_;
+        return program;
+      }
+    }
+  }
+
+  ++stats_.misses_;
+  return std::nullopt;
+}
+
+auto Store::store(std::string const& source, Program const& program) -> void {
+  std::error_code error;
+  std::filesystem::create_directories(directory_, error);
+  if (error) {
+    return;
+  }
+
+  // Write to a private file first and rename it into place, so that
+  // concurrent runs never observe a partially written entry.
+  std::filesystem::path const target{path_for(source)};
+  std::filesystem::path temporary{target};
+  temporary += ".tmp." + std::to_string(::getpid());
+
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+      return;
+    }
+    file << header(source) << Serializer::serialize(program);
+    if (!file.good()) {
+      file.close();
+      std::filesystem::remove(temporary, error);
+      return;
+    }
+  }
+
+  std::filesystem::rename(temporary, target, error);
+  if (error) {
+    std::filesystem::remove(temporary, error);
+  }
+}
+
+auto Store::stats() const -> Stats { return stats_; }
+
+auto Store::path_for(std::string const& source) const
+    -> std::filesystem::path {
+  std::uint64_t const version{
+      hash(Serializer::format_version(), hash(LOX_VERSION))};
+  return directory_ / (to_hex(hash(source, version)) + ".loxc");
+}
+
+auto default_directory() -> std::filesystem::path {
+  if (char const* const dir{std::getenv("LOX_CACHE_DIR")}; dir && *dir) {
+    return dir;
+  }
+  if (char const* const dir{std::getenv("XDG_CACHE_HOME")}; dir && *dir) {
+    return std::filesystem::path{dir} / "cpplox";
+  }
+  if (char const* const home{std::getenv("HOME")}; home && *home) {
+    return std::filesystem::path{home} / ".cache" / "cpplox";
+  }
+  return std::filesystem::temp_directory_path() / "cpplox";
+}
+}  // namespace Cache
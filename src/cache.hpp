@@ -0,0 +1,59 @@
+#ifndef LOX_CACHE
+#define LOX_CACHE
+
+#include <filesystem>
+#include <optional>
+#include <string>
+
+#include "./types/program.hpp"
+
+namespace Cache {
+struct Stats {
+  std::size_t hits_;
+  std::size_t misses_;
+};
+
+/**
+ * Stores parsed and resolved programs on disk, keyed by a hash of the source
+ * text, the interpreter version and the AST encoding. Failures to read or
+ * write the cache are never fatal; they are treated as misses.
+ */
+class Store {
+ public:
+  explicit Store(std::filesystem::path directory);
+
+  /**
+   * Looks up the program compiled from the given source.
+   *
+   * @param source The script contents.
+   *
+   * @return The cached program, or std::nullopt on a miss.
+   */
+  [[nodiscard]] auto load(std::string const& source) -> std::optional<Program>;
+
+  /**
+   * Records the program compiled from the given source.
+   *
+   * @param source The script contents.
+   * @param program The result of running the front end on the source.
+   */
+  auto store(std::string const& source, Program const& program) -> void;
+
+  [[nodiscard]] auto stats() const -> Stats;
+
+ private:
+  [[nodiscard]] auto path_for(std::string const& source) const
+      -> std::filesystem::path;
+
+  std::filesystem::path directory_;
+  Stats stats_;
+};
+
+/**
+ * The directory named by LOX_CACHE_DIR, falling back to $XDG_CACHE_HOME/cpplox
+ * and then to ~/.cache/cpplox.
+ */
+[[nodiscard]] auto default_directory() -> std::filesystem::path;
+}  // namespace Cache
+
+#endif
@@ -0,0 +1,143 @@
+#include "./core.hpp"
+
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "./cache.hpp"
+#include "./interpreter.hpp"
+#include "./output.hpp"
+#include "./parser/error.hpp"
+#include "./parser/parser.hpp"
+#include "./phases.hpp"
+#include "./resolver.hpp"
+#include "./scanner.hpp"
+#include "./types/program.hpp"
+#include "./utils/error.hpp"
+
+namespace {
+template <typename E>
+auto to_error(Core::Error::Phase const phase, E const& e) -> Core::Error {
+  std::ostringstream message{};
+  e.report(message);
+  std::string text{message.str()};
+  if (!text.empty() && text.back() == '\n') {
+    text.pop_back();
+  }
+  return Core::Error{phase, std::move(text)};
+}
+}  // namespace
+
+namespace Core {
+Script::Script(Program program)
+    : program_{std::make_shared<Program const>(std::move(program))} {}
+
+auto Script::program() const -> Program const& { return *program_; }
+
+auto compile(std::string const& source, std::vector<std::string> const& inputs,
+             Cache::Store* const cache, Phases::Report* const report)
+    -> std::variant<Script, std::vector<Error>> {
+  using Phases::Phase;
+  using Scope = Phases::Report::Scope;
+
+  bool const cacheable{cache && inputs.empty()};
+  if (cacheable) {
+    std::optional<Program> cached{};
+    {
+      Scope const scope{report, Phase::CACHE};
+      cached = cache->load(source);
+    }
+    if (cached) {
+      if (report) {
+        report->count(cached->statements_);
+        report->resolved_names_ = cached->resolution_.size();
+      }
+      return Script{std::move(*cached)};
+    }
+  }
+
+  try {
+    std::vector<Token> tokens{};
+    {
+      Scope const scope{report, Phase::SCAN};
+      tokens = Scanner::scan_tokens(source);
+    }
+
+    std::vector<Parser::Error> parse_errors{};
+    std::vector<Statement> statements{};
+    {
+      Scope const scope{report, Phase::PARSE};
+      statements = Parser::parse(tokens, parse_errors);
+    }
+    if (report) {
+      report->tokens_ = tokens.size();
+      report->count(statements);
+    }
+    if (!parse_errors.empty()) {
+      std::vector<Error> errors{};
+      for (Parser::Error const& e : parse_errors) {
+        errors.push_back(to_error(Error::Phase::COMPILE, e));
+      }
+      return errors;
+    }
+
+    std::unordered_map<std::string, bool> globals{};
+    for (std::string const& input : inputs) {
+      globals[input] = true;
+    }
+    std::unordered_map<Token, std::size_t> resolution{};
+    {
+      Scope const scope{report, Phase::RESOLVE};
+      NameResolver resolver{resolution, std::move(globals)};
+      resolver.resolve(statements);
+    }
+    if (report) {
+      report->resolved_names_ = resolution.size();
+    }
+
+    Program program{std::move(statements), std::move(resolution)};
+    if (cacheable) {
+      Scope const scope{report, Phase::CACHE};
+      cache->store(source, program);
+    }
+    return Script{std::move(program)};
+  } catch (CompileTimeError const& e) {
+    return std::vector<Error>{to_error(Error::Phase::COMPILE, e)};
+  }
+}
+
+Globals::Globals() : environment_{Interpreter::global_environment()} {}
+
+auto Globals::define(std::string const& name, Object const& value) -> void {
+  environment_->define(name, value);
+}
+
+auto execute(Script const& script, Globals& globals, Output::Sink& out,
+             Budget const& budget, Phases::Report* const report,
+             Counters::Profile* const counters) -> std::optional<Error> {
+  Program const& program{script.program()};
+  Phases::Report::Scope const scope{report, Phases::Phase::INTERPRET};
+  Interpreter::Context context{program.resolution_, out, budget};
+  context.program_ = script.program_;
+  context.counters_ = counters;
+  try {
+    Interpreter::interpret(program.statements_, context, globals.environment_);
+  } catch (BudgetError const& e) {
+    return to_error(Error::Phase::BUDGET, e);
+  } catch (RuntimeError const& e) {
+    return to_error(Error::Phase::RUNTIME, e);
+  }
+  return std::nullopt;
+}
+
+auto execute(Script const& script, Output::Sink& out, Budget const& budget,
+             Phases::Report* const report, Counters::Profile* const counters)
+    -> std::optional<Error> {
+  Globals globals{};
+  return execute(script, globals, out, budget, report, counters);
+}
+}  // namespace Core
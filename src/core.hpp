@@ -0,0 +1,117 @@
+#ifndef LOX_CORE
+#define LOX_CORE
+
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <variant>
+#include <vector>
+
+#include "./budget.hpp"
+#include "./cache.hpp"
+#include "./counters.hpp"
+#include "./environment.hpp"
+#include "./output.hpp"
+#include "./phases.hpp"
+#include "./types/class.hpp"
+#include "./types/function.hpp"
+#include "./types/object.hpp"
+#include "./types/program.hpp"
+
+/**
+ * The interface for embedding the interpreter: compile a source once, then
+ * execute it as often as needed. Nothing here prints to the standard streams
+ * or exits; errors are returned.
+ */
+namespace Core {
+struct Error {
+  // Exceeding the budget of an execution is a runtime error of its own
+  enum class Phase { COMPILE, RUNTIME, BUDGET };
+
+  Phase phase_;
+  // As the command line reports it, e.g. "[line 3] Undefined key."
+  std::string message_;
+
+  auto report(std::ostream& out) const -> void { out << message_ << '\n'; }
+};
+
+class Globals;
+
+/**
+ * A compiled program. Scripts are immutable, and copies share the program,
+ * so a script can be kept around and executed any number of times.
+ */
+class Script {
+ public:
+  explicit Script(Program program);
+
+  [[nodiscard]] auto program() const -> Program const&;
+
+ private:
+  // Functions the script declares share its program
+  friend auto execute(Script const& script, Globals& globals,
+                      Output::Sink& out, Budget const& budget,
+                      Phases::Report* report, Counters::Profile* counters)
+      -> std::optional<Error>;
+
+  std::shared_ptr<Program const> program_;
+};
+
+/**
+ * Runs the front end over a source.
+ *
+ * @param inputs Names of the globals the host defines before executing the
+ * script, so that the script may refer to them.
+ * @param cache Where to look up and store the front-end output. Only used
+ * without inputs, as the output depends on them.
+ * @param report Where to add measurements of the phases, if anywhere.
+ *
+ * @return The script, or all errors found in the source.
+ */
+auto compile(std::string const& source,
+             std::vector<std::string> const& inputs = {},
+             Cache::Store* cache = nullptr, Phases::Report* report = nullptr)
+    -> std::variant<Script, std::vector<Error>>;
+
+/**
+ * The global variables of executions. Executing scripts in the same globals
+ * lets them see each other's global declarations.
+ */
+class Globals {
+ public:
+  Globals();
+
+  auto define(std::string const& name, Object const& value) -> void;
+
+ private:
+  friend auto execute(Script const& script, Globals& globals,
+                      Output::Sink& out, Budget const& budget,
+                      Phases::Report* report, Counters::Profile* counters)
+      -> std::optional<Error>;
+
+  std::shared_ptr<GlobalEnvironment> environment_;
+};
+
+/**
+ * Executes a script in the given globals. The sink is not flushed.
+ *
+ * @param report Where to add a measurement of the execution, if anywhere.
+ * @param counters Where to count the nodes of the script executed, if
+ * anywhere. Made for the script.
+ *
+ * @return The runtime error that stopped the script, if any.
+ */
+auto execute(Script const& script, Globals& globals, Output::Sink& out,
+             Budget const& budget = {}, Phases::Report* report = nullptr,
+             Counters::Profile* counters = nullptr) -> std::optional<Error>;
+
+/**
+ * Executes a script in fresh globals.
+ */
+auto execute(Script const& script, Output::Sink& out,
+             Budget const& budget = {}, Phases::Report* report = nullptr,
+             Counters::Profile* counters = nullptr) -> std::optional<Error>;
+}  // namespace Core
+
+#endif
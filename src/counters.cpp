@@ -0,0 +1,283 @@
+#include "./counters.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "./types/expression.hpp"
+#include "./types/statement.hpp"
+#include "./utils/box.hpp"
+
+namespace {
+template <typename T, typename Variant>
+struct Holds;
+
+template <typename T, typename... Ts>
+struct Holds<T, std::variant<Ts...>>
+    : std::disjunction<std::is_same<T, Ts>...> {};
+
+// The node holding it, as the address of what it holds. An expression
+// statement has the address of its expression, so expressions are tagged.
+template <typename T>
+auto key(T const& held) -> std::uintptr_t {
+  auto const address{reinterpret_cast<std::uintptr_t>(&held)};
+  return Holds<T, Expression>::value ? address | 1 : address;
+}
+
+template <typename... Ts>
+auto key(std::variant<Ts...> const& node) -> std::uintptr_t {
+  return std::visit([](auto const& held) { return key(held); }, node);
+}
+
+/**
+ * Numbers the nodes of a tree in preorder. Nodes without a token of their
+ * own are on the first line of their children, or else on that of the node
+ * around them. Each call returns the line of the node it walked.
+ */
+struct Numbering {
+  std::unordered_map<std::uintptr_t, Counters::Node>& nodes_;
+  // The line of the node around the one walked
+  std::size_t enclosing_{0};
+
+  template <typename... Ts>
+  auto operator()(std::variant<Ts...> const& variant) -> std::size_t {
+    return std::visit(*this, variant);
+  }
+
+  template <typename T>
+  auto operator()(std::vector<T> const& elements) -> std::size_t {
+    std::size_t first{0};
+    for (T const& element : elements) {
+      std::size_t const line{(*this)(element)};
+      first = first == 0 ? line : first;
+    }
+    return first;
+  }
+
+  auto operator()(std::monostate) -> std::size_t { return 0; }
+
+  auto operator()(LiteralExpression const& expr) -> std::size_t {
+    return node(&expr, "literal", 0);
+  }
+
+  auto operator()(ThisExpression const& expr) -> std::size_t {
+    return node(&expr, "this", expr.keyword_.line_);
+  }
+
+  auto operator()(VariableExpression const& expr) -> std::size_t {
+    return node(&expr, "variable", expr.name_.line_);
+  }
+
+  auto operator()(Box<AssignmentExpression> const& expr) -> std::size_t {
+    return node(&expr, "assign", expr->name_.line_, expr->value_);
+  }
+
+  auto operator()(Box<BinaryExpression> const& expr) -> std::size_t {
+    return node(&expr, "binary", expr->op_.line_, expr->left_, expr->right_);
+  }
+
+  auto operator()(Box<CallExpression> const& expr) -> std::size_t {
+    return node(&expr, "call", expr->paren_.line_, expr->callee_,
+                expr->arguments_);
+  }
+
+  auto operator()(Box<GetExpression> const& expr) -> std::size_t {
+    return node(&expr, "get", expr->name_.line_, expr->object_);
+  }
+
+  auto operator()(Box<GroupingExpression> const& expr) -> std::size_t {
+    return node(&expr, "grouping", 0, expr->expression_);
+  }
+
+  auto operator()(Box<LogicalExpression> const& expr) -> std::size_t {
+    return node(&expr, "logical", expr->op_.line_, expr->left_,
+                expr->right_);
+  }
+
+  auto operator()(Box<SetExpression> const& expr) -> std::size_t {
+    return node(&expr, "set", expr->name_.line_, expr->object_,
+                expr->value_);
+  }
+
+  auto operator()(Box<UnaryExpression> const& expr) -> std::size_t {
+    return node(&expr, "unary", expr->op_.line_, expr->right_);
+  }
+
+  auto operator()(Box<ListExpression> const& expr) -> std::size_t {
+    return node(&expr, "list", expr->bracket_.line_, expr->elements_);
+  }
+
+  auto operator()(Box<IndexExpression> const& expr) -> std::size_t {
+    return node(&expr, "index", expr->bracket_.line_, expr->object_,
+                expr->index_);
+  }
+
+  auto operator()(Box<IndexSetExpression> const& expr) -> std::size_t {
+    return node(&expr, "index_set", expr->bracket_.line_, expr->object_,
+                expr->index_, expr->value_);
+  }
+
+  auto operator()(Box<SpawnExpression> const& expr) -> std::size_t {
+    return node(&expr, "spawn", expr->keyword_.line_, expr->call_);
+  }
+
+  auto operator()(Box<SuperExpression> const& expr) -> std::size_t {
+    return node(&expr, "super", expr->keyword_.line_);
+  }
+
+  auto operator()(ExpressionStatement const& stmt) -> std::size_t {
+    return node(&stmt, "expression", 0, stmt.expression_);
+  }
+
+  auto operator()(PrintStatement const& stmt) -> std::size_t {
+    return node(&stmt, "print", 0, stmt.expression_);
+  }
+
+  auto operator()(ReturnStatement const& stmt) -> std::size_t {
+    return node(&stmt, "return", stmt.keyword_.line_, stmt.value_);
+  }
+
+  auto operator()(YieldStatement const& stmt) -> std::size_t {
+    return node(&stmt, "yield", stmt.keyword_.line_, stmt.value_);
+  }
+
+  auto operator()(VariableStatement const& stmt) -> std::size_t {
+    return node(&stmt, "var", stmt.name_.line_, stmt.initializer_);
+  }
+
+  auto operator()(Box<BlockStatement> const& stmt) -> std::size_t {
+    return node(&stmt, "block", 0, stmt->statements_);
+  }
+
+  auto operator()(Box<FunctionStatement> const& stmt) -> std::size_t {
+    return node(&stmt, "fun", stmt->name_.line_, stmt->body_);
+  }
+
+  auto operator()(Box<ClassStatement> const& stmt) -> std::size_t {
+    // Methods are not statements of their own, only their bodies run
+    std::vector<std::vector<Statement> const*> bodies{};
+    for (Box<FunctionStatement> const& method : stmt->methods_) {
+      bodies.push_back(&method->body_);
+    }
+    return node(&stmt, "class", stmt->name_.line_, stmt->superclass_, bodies);
+  }
+
+  auto operator()(std::vector<Statement> const* const body) -> std::size_t {
+    return (*this)(*body);
+  }
+
+  auto operator()(Box<IfStatement> const& stmt) -> std::size_t {
+    return node(&stmt, "if", 0, stmt->condition_, stmt->then_branch_,
+                stmt->else_branch_);
+  }
+
+  auto operator()(Box<WhileStatement> const& stmt) -> std::size_t {
+    return node(&stmt, "while", stmt->keyword_.line_, stmt->condition_,
+                stmt->body_);
+  }
+
+  // Numbers the node, then its children in order
+  template <typename T, typename... Children>
+  auto node(T const* const held, char const* const kind,
+            std::size_t const line, Children const&... children)
+      -> std::size_t {
+    std::size_t const id{nodes_.size()};
+    Counters::Node& node{nodes_.try_emplace(key(*held)).first->second};
+    node.id_ = id;
+    node.kind_ = kind;
+
+    std::size_t const enclosing{
+        std::exchange(enclosing_, line != 0 ? line : enclosing_)};
+    std::size_t first{0};
+    (
+        [&] {
+          std::size_t const child{(*this)(children)};
+          first = first == 0 ? child : first;
+        }(),
+        ...);
+    enclosing_ = enclosing;
+
+    node.line_ = line != 0 ? line : first != 0 ? first : enclosing_;
+    return node.line_;
+  }
+};
+
+auto is_branch(Counters::Node const& node) -> bool {
+  return std::strcmp(node.kind_, "if") == 0 ||
+         std::strcmp(node.kind_, "while") == 0 ||
+         std::strcmp(node.kind_, "logical") == 0;
+}
+}  // namespace
+
+namespace Counters {
+Profile::Profile(std::vector<Statement> const& statements) {
+  Numbering{nodes_}(statements);
+}
+
+auto Profile::executed(Statement const& stmt) -> void {
+  count(key(stmt), &Node::executed_);
+}
+
+auto Profile::executed(Expression const& expr) -> void {
+  count(key(expr), &Node::executed_);
+}
+
+auto Profile::branch(Box<IfStatement> const& stmt, bool const taken) -> void {
+  count(key(stmt), taken ? &Node::taken_ : &Node::not_taken_);
+}
+
+auto Profile::branch(Box<WhileStatement> const& stmt, bool const taken)
+    -> void {
+  count(key(stmt), taken ? &Node::taken_ : &Node::not_taken_);
+}
+
+auto Profile::branch(Box<LogicalExpression> const& expr, bool const taken)
+    -> void {
+  count(key(expr), taken ? &Node::taken_ : &Node::not_taken_);
+}
+
+auto Profile::count(std::uintptr_t const key,
+                    std::atomic<std::uint64_t> Node::*const counter) -> void {
+  if (auto const node{nodes_.find(key)}; node != nodes_.end()) {
+    (node->second.*counter).fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+auto Profile::write_json(std::ostream& out) const -> void {
+  std::vector<Node const*> sorted{};
+  sorted.reserve(nodes_.size());
+  for (auto const& [key, node] : nodes_) {
+    sorted.push_back(&node);
+  }
+  std::sort(sorted.begin(), sorted.end(), [](Node const* a, Node const* b) {
+    return a->line_ != b->line_ ? a->line_ < b->line_ : a->id_ < b->id_;
+  });
+
+  out << "{\"lines\": {";
+  for (std::size_t i = 0; i < sorted.size(); ++i) {
+    Node const& node{*sorted[i]};
+    bool const new_line{i == 0 || sorted[i - 1]->line_ != node.line_};
+    if (new_line) {
+      out << (i == 0 ? "" : "}, ") << '"' << node.line_ << "\": {";
+    } else {
+      out << ", ";
+    }
+    out << '"' << node.id_ << "\": {\"kind\": \"" << node.kind_
+        << "\", \"executed\": " << node.executed_.load();
+    if (is_branch(node)) {
+      out << ", \"taken\": " << node.taken_.load()
+          << ", \"not_taken\": " << node.not_taken_.load();
+    }
+    out << '}';
+  }
+  out << (sorted.empty() ? "" : "}") << "}}\n";
+}
+}  // namespace Counters
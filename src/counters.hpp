@@ -0,0 +1,67 @@
+#ifndef LOX_COUNTERS
+#define LOX_COUNTERS
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+#include "./types/expression.hpp"
+#include "./types/statement.hpp"
+#include "./utils/box.hpp"
+
+/**
+ * How often each statement and expression of a program executed, and which
+ * way its branches went, for tuning scripts and the interpreter. Only counted
+ * when asked for: without counters, a node costs a null check.
+ */
+namespace Counters {
+struct Node {
+  // In the order of a walk of the tree from the first statement, from 0
+  std::size_t id_;
+  // 0 if no token of the node tells
+  std::size_t line_;
+  char const* kind_;
+  // Tasks on other threads count too
+  std::atomic<std::uint64_t> executed_{0};
+  // For if and while statements: how often the condition held, and not. For
+  // and and or: how often the left operand decided the result, and not.
+  std::atomic<std::uint64_t> taken_{0};
+  std::atomic<std::uint64_t> not_taken_{0};
+};
+
+class Profile {
+ public:
+  // Numbers the nodes of the program, which must outlive the profile
+  explicit Profile(std::vector<Statement> const& statements);
+
+  Profile(Profile const&) = delete;
+  auto operator=(Profile const&) -> Profile& = delete;
+
+  auto executed(Statement const& stmt) -> void;
+
+  auto executed(Expression const& expr) -> void;
+
+  auto branch(Box<IfStatement> const& stmt, bool taken) -> void;
+
+  auto branch(Box<WhileStatement> const& stmt, bool taken) -> void;
+
+  auto branch(Box<LogicalExpression> const& expr, bool taken) -> void;
+
+  // Nodes by line and by id: {"lines": {"3": {"7": {"kind": ...}}}}
+  auto write_json(std::ostream& out) const -> void;
+
+ private:
+  auto count(std::uintptr_t key, std::atomic<std::uint64_t> Node::*counter)
+      -> void;
+
+  // Keyed by the address of what the statement or the expression holds.
+  // Functions declared at runtime refer to the program, so their bodies are
+  // found here too.
+  std::unordered_map<std::uintptr_t, Node> nodes_;
+};
+}  // namespace Counters
+
+#endif
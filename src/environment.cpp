@@ -0,0 +1,56 @@
+#include "./environment.hpp"
+
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "./types/class.hpp"
+#include "./types/function.hpp"
+#include "./types/program.hpp"
+
+namespace {
+// Every name numbered so far, by name and by slot. Programs are compiled on
+// any thread, isolates each on their own.
+struct Slots {
+  std::mutex mutex_;
+  std::unordered_map<std::string, std::size_t> slots_;
+  std::deque<std::string> names_;
+};
+
+auto slots() -> Slots& {
+  static Slots slots{};
+  return slots;
+}
+}  // namespace
+
+auto global_slot(std::string const& name) -> std::size_t {
+  Slots& numbered{slots()};
+  std::lock_guard const lock{numbered.mutex_};
+  auto const [found, added]{
+      numbered.slots_.try_emplace(name, numbered.names_.size())};
+  if (added) {
+    numbered.names_.push_back(name);
+  }
+  return found->second;
+}
+
+auto global_name(std::size_t const slot) -> std::string {
+  Slots& numbered{slots()};
+  std::lock_guard const lock{numbered.mutex_};
+  return numbered.names_.at(slot);
+}
+
+auto GlobalEnvironment::define(std::size_t const slot, Object const& value)
+    -> void {
+  if (slot >= slots_.size()) {
+    slots_.resize(slot + 1, Slot{std::monostate{}, false});
+  }
+  slots_[slot] = Slot{value, true};
+}
+
+auto GlobalEnvironment::define(std::string const& name, Object const& value)
+    -> void {
+  define(global_slot(name), value);
+}
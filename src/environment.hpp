@@ -4,12 +4,43 @@
 #include <cassert>
 #include <map>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "./pool.hpp"
 #include "./types/object.hpp"
 #include "./types/token.hpp"
 #include "./utils/error.hpp"
 
-namespace {
+/**
+ * A variable as the closures that use it share it: in the environment that
+ * declares it for as long as that lives, and held here from then on.
+ */
+template <typename Value>
+class upvalue {
+ public:
+  explicit upvalue(Value* const location) : location_{location} {}
+
+  // Closed from the start
+  upvalue() : location_{&closed_} {}
+
+  upvalue(upvalue const&) = delete;
+  auto operator=(upvalue const&) -> upvalue& = delete;
+
+  auto get() -> Value& { return *location_; }
+
+  auto close() -> void {
+    closed_ = std::move(*location_);
+    location_ = &closed_;
+  }
+
+ private:
+  Value* location_;
+  Value closed_{};
+};
+
 template <typename Key, typename Value>
 class env {
  public:
@@ -17,6 +48,16 @@ class env {
 
   env() : enclosing_(nullptr) {}
 
+  env(env const&) = delete;
+  auto operator=(env const&) -> env& = delete;
+
+  // Closures keep the variables they captured, not the environment
+  ~env() {
+    for (auto const& [name, captured] : upvalues_) {
+      captured->close();
+    }
+  }
+
   auto define(Key const& name, Value const& value) -> void {
     map_[name] = value;
   }
@@ -27,6 +68,18 @@ class env {
 
   auto get(Key const& name) -> Value { return get_at(name, 0); }
 
+  // As get_at, without copying the value
+  auto at(Key const& name, std::size_t distance) -> Value& {
+    return ancestor(distance)->map_.at(name);
+  }
+
+  // The variable of this environment alone, if it has one. It stays where it
+  // is as others are defined.
+  auto find(Key const& name) -> Value* {
+    auto const found{map_.find(name)};
+    return found != map_.end() ? &found->second : nullptr;
+  }
+
   auto assign_at(Key const& name, Value const& value, std::size_t distance)
       -> void {
     ancestor(distance)->map_[name] = value;
@@ -36,6 +89,32 @@ class env {
     assign_at(name, value, 0);
   }
 
+  // The variable as closures share it, the same for every closure
+  auto capture(Key const& name, std::size_t distance)
+      -> std::shared_ptr<upvalue<Value>> {
+    env* const declaring{ancestor(distance)};
+    for (auto const& [captured_name, captured] : declaring->upvalues_) {
+      if (captured_name == name) {
+        return captured;
+      }
+    }
+    auto captured{std::make_shared<upvalue<Value>>(&declaring->map_.at(name))};
+    declaring->upvalues_.emplace_back(name, captured);
+    return captured;
+  }
+
+  [[nodiscard]] auto enclosing() const -> std::shared_ptr<env> const& {
+    return enclosing_;
+  }
+
+  // Calls f(name, value) for each variable of this environment alone
+  template <typename F>
+  auto for_each(F const& f) const -> void {
+    for (auto const& [name, value] : map_) {
+      f(name, value);
+    }
+  }
+
  private:
   auto ancestor(std::size_t distance) -> env* {
     auto current{this};
@@ -49,10 +128,62 @@ class env {
 
   std::shared_ptr<env> enclosing_;
 
-  std::unordered_map<Key, Value> map_;
+  // Variables and their table come from the pool, as the environments of
+  // calls come and go all the time
+  std::unordered_map<Key, Value, std::hash<Key>, std::equal_to<Key>,
+                     Pool::Allocator<std::pair<Key const, Value>>>
+      map_;
+  // Those of its variables that closures captured, closed over as it goes
+  std::vector<std::pair<Key, std::shared_ptr<upvalue<Value>>>> upvalues_;
 };
-}  // namespace
 
 using Environment = env<std::string, Object>;
+using Upvalue = upvalue<Object>;
+
+/**
+ * The globals of executions, each in the slot its name is numbered with. A
+ * slot stays undefined until its global is declared, which uses bound late
+ * check for.
+ */
+class GlobalEnvironment {
+ public:
+  auto define(std::size_t slot, Object const& value) -> void;
+
+  auto define(std::string const& name, Object const& value) -> void;
+
+  // The global in the slot, if it is defined by now. It stays where it is
+  // until a global of a slot past the last one is defined.
+  auto find(std::size_t const slot) -> Object* {
+    return slot < slots_.size() && slots_[slot].defined_
+               ? &slots_[slot].value_
+               : nullptr;
+  }
+
+  // Calls f(slot, value) for each global defined
+  template <typename F>
+  auto for_each(F const& f) const -> void {
+    for (std::size_t slot = 0; slot < slots_.size(); ++slot) {
+      if (slots_[slot].defined_) {
+        f(slot, slots_[slot].value_);
+      }
+    }
+  }
+
+ private:
+  struct Slot {
+    Object value_;
+    bool defined_;
+  };
+
+  std::vector<Slot> slots_;
+};
+
+// Allocated from the pool, together with its control block
+inline auto make_environment(
+    std::shared_ptr<Environment> const& enclosing = nullptr)
+    -> std::shared_ptr<Environment> {
+  return std::allocate_shared<Environment>(Pool::Allocator<Environment>{},
+                                           enclosing);
+}
 
 #endif
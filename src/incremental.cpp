@@ -0,0 +1,497 @@
+#include "./incremental.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "./parser/cursor.hpp"
+#include "./parser/error.hpp"
+#include "./parser/statements.hpp"
+#include "./resolver.hpp"
+#include "./scanner.hpp"
+#include "./types/expression.hpp"
+#include "./types/statement.hpp"
+#include "./types/token.hpp"
+#include "./utils/box.hpp"
+
+namespace {
+/**
+ * Moves the line numbers of every token in a statement by a fixed amount, for
+ * statements that were reused below an edit that added or removed lines.
+ */
+struct LineShift {
+  std::ptrdiff_t delta_;
+
+  auto operator()(Token& token) const -> void {
+    token.line_ =
+        static_cast<std::size_t>(static_cast<std::ptrdiff_t>(token.line_) +
+                                 delta_);
+  }
+
+  // Syntax errors kept with the statement move along with it
+  auto operator()(Parser::Error& error) const -> void {
+    error.line_ =
+        static_cast<std::size_t>(static_cast<std::ptrdiff_t>(error.line_) +
+                                 delta_);
+  }
+
+  template <typename... Ts>
+  auto operator()(std::variant<Ts...>& variant) const -> void {
+    std::visit(*this, variant);
+  }
+
+  template <typename T>
+  auto operator()(Box<T>& box) const -> void {
+    (*this)(*box);
+  }
+
+  template <typename T>
+  auto operator()(std::vector<T>& elements) const -> void {
+    for (T& element : elements) {
+      (*this)(element);
+    }
+  }
+
+  auto operator()(std::monostate) const -> void {}
+
+  auto operator()(LiteralExpression&) const -> void {}
+
+  auto operator()(ThisExpression& expr) const -> void {
+    (*this)(expr.keyword_);
+  }
+
+  auto operator()(VariableExpression& expr) const -> void {
+    (*this)(expr.name_);
+  }
+
+  auto operator()(AssignmentExpression& expr) const -> void {
+    (*this)(expr.name_);
+    (*this)(expr.value_);
+  }
+
+  auto operator()(BinaryExpression& expr) const -> void {
+    (*this)(expr.left_);
+    (*this)(expr.op_);
+    (*this)(expr.right_);
+  }
+
+  auto operator()(CallExpression& expr) const -> void {
+    (*this)(expr.callee_);
+    (*this)(expr.paren_);
+    (*this)(expr.arguments_);
+  }
+
+  auto operator()(GetExpression& expr) const -> void {
+    (*this)(expr.name_);
+    (*this)(expr.object_);
+  }
+
+  auto operator()(GroupingExpression& expr) const -> void {
+    (*this)(expr.expression_);
+  }
+
+  auto operator()(LogicalExpression& expr) const -> void {
+    (*this)(expr.left_);
+    (*this)(expr.op_);
+    (*this)(expr.right_);
+  }
+
+  auto operator()(SetExpression& expr) const -> void {
+    (*this)(expr.name_);
+    (*this)(expr.object_);
+    (*this)(expr.value_);
+  }
+
+  auto operator()(UnaryExpression& expr) const -> void {
+    (*this)(expr.op_);
+    (*this)(expr.right_);
+  }
+
+  auto operator()(ListExpression& expr) const -> void {
+    (*this)(expr.bracket_);
+    (*this)(expr.elements_);
+  }
+
+  auto operator()(IndexExpression& expr) const -> void {
+    (*this)(expr.object_);
+    (*this)(expr.bracket_);
+    (*this)(expr.index_);
+  }
+
+  auto operator()(IndexSetExpression& expr) const -> void {
+    (*this)(expr.object_);
+    (*this)(expr.bracket_);
+    (*this)(expr.index_);
+    (*this)(expr.value_);
+  }
+
+  auto operator()(SpawnExpression& expr) const -> void {
+    (*this)(expr.keyword_);
+    (*this)(expr.call_);
+  }
+
+  auto operator()(SuperExpression& expr) const -> void {
+    (*this)(expr.keyword_);
+    (*this)(expr.method_);
+  }
+
+  auto operator()(ExpressionStatement& stmt) const -> void {
+    (*this)(stmt.expression_);
+  }
+
+  auto operator()(PrintStatement& stmt) const -> void {
+    (*this)(stmt.expression_);
+  }
+
+  auto operator()(ReturnStatement& stmt) const -> void {
+    (*this)(stmt.keyword_);
+    (*this)(stmt.value_);
+  }
+
+  auto operator()(YieldStatement& stmt) const -> void {
+    (*this)(stmt.keyword_);
+    (*this)(stmt.value_);
+  }
+
+  auto operator()(VariableStatement& stmt) const -> void {
+    (*this)(stmt.name_);
+    (*this)(stmt.initializer_);
+  }
+
+  auto operator()(BlockStatement& stmt) const -> void {
+    (*this)(stmt.statements_);
+  }
+
+  auto operator()(FunctionStatement& stmt) const -> void {
+    (*this)(stmt.name_);
+    (*this)(stmt.params_);
+    (*this)(stmt.body_);
+  }
+
+  auto operator()(ClassStatement& stmt) const -> void {
+    (*this)(stmt.name_);
+    (*this)(stmt.superclass_);
+    (*this)(stmt.methods_);
+  }
+
+  auto operator()(IfStatement& stmt) const -> void {
+    (*this)(stmt.condition_);
+    (*this)(stmt.then_branch_);
+    (*this)(stmt.else_branch_);
+  }
+
+  auto operator()(WhileStatement& stmt) const -> void {
+    (*this)(stmt.keyword_);
+    (*this)(stmt.condition_);
+    (*this)(stmt.body_);
+  }
+};
+
+// Replaces the elements in [from, to) with the given ones, shifting the
+// elements after them at most once.
+template <typename T>
+auto splice(std::vector<T>& into, std::size_t const from, std::size_t const to,
+            std::vector<T>&& with) -> void {
+  std::size_t const common{std::min(to - from, with.size())};
+  std::move(with.begin(), with.begin() + common, into.begin() + from);
+  if (with.size() > common) {
+    into.insert(into.begin() + from + common,
+                std::make_move_iterator(with.begin() + common),
+                std::make_move_iterator(with.end()));
+  } else {
+    into.erase(into.begin() + from + common, into.begin() + to);
+  }
+}
+
+// Tokens carry the line they end on; string literals may span lines.
+auto first_line(Token const& token) -> std::size_t {
+  return token.line_ -
+         std::count(token.lexeme_.begin(), token.lexeme_.end(), '\n');
+}
+
+auto start_of(Token const& token) -> std::size_t {
+  return token.token_id_ - token.lexeme_.size();
+}
+
+// The global a top-level statement declares, if any
+auto declared_global(Statement const& stmt) -> std::optional<std::string> {
+  if (auto const var{std::get_if<VariableStatement>(&stmt)}) {
+    return var->name_.lexeme_;
+  }
+  if (auto const fun{std::get_if<Box<FunctionStatement>>(&stmt)}) {
+    return (*fun)->name_.lexeme_;
+  }
+  if (auto const klass{std::get_if<Box<ClassStatement>>(&stmt)}) {
+    return (*klass)->name_.lexeme_;
+  }
+  return std::nullopt;
+}
+
+// The errors the cursor recorded from the given count on
+auto errors_since(Parser::Cursor const& cursor, std::size_t const count)
+    -> std::vector<Parser::Error> {
+  return {cursor.errors().begin() + static_cast<std::ptrdiff_t>(count),
+          cursor.errors().end()};
+}
+
+template <typename It>
+auto declared_globals(It const begin, It const end)
+    -> std::vector<std::string> {
+  std::vector<std::string> names{};
+  for (It it = begin; it != end; ++it) {
+    if (std::optional<std::string> name{declared_global(*it)}) {
+      names.push_back(std::move(*name));
+    }
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+}  // namespace
+
+namespace Incremental {
+Document::Document(std::string source)
+    : source_{std::move(source)},
+      next_token_id_{0},
+      valid_{false},
+      stats_{0, 0, 0} {
+  rebuild();
+}
+
+auto Document::apply(Edit const& edit) -> void {
+  if (edit.offset_ > source_.size() ||
+      edit.removed_ > source_.size() - edit.offset_) {
+    throw std::out_of_range{"Edit does not lie within the source"};
+  }
+
+  source_.replace(edit.offset_, edit.removed_, edit.inserted_);
+
+  if (!valid_) {
+    rebuild();
+    return;
+  }
+
+  try {
+    update(edit);
+  } catch (...) {
+    valid_ = false;
+    throw;
+  }
+}
+
+auto Document::source() const -> std::string const& { return source_; }
+
+auto Document::tokens() const -> std::vector<Token> const& { return tokens_; }
+
+auto Document::statements() const -> std::vector<Statement> const& {
+  return statements_;
+}
+
+auto Document::resolution() const
+    -> std::unordered_map<Token, std::size_t> const& {
+  return resolution_;
+}
+
+auto Document::diagnostics() const -> std::vector<Parser::Error> {
+  std::vector<Parser::Error> diagnostics{};
+  for (std::vector<Parser::Error> const& errors : errors_) {
+    diagnostics.insert(diagnostics.end(), errors.begin(), errors.end());
+  }
+  return diagnostics;
+}
+
+auto Document::stats() const -> Stats { return stats_; }
+
+auto Document::rebuild() -> void {
+  valid_ = false;
+
+  tokens_ = Scanner::scan_tokens(source_);
+  starts_.clear();
+  starts_.reserve(tokens_.size());
+  for (Token const& token : tokens_) {
+    starts_.push_back(start_of(token));
+  }
+  // A full scan numbers tokens by their end offset.
+  next_token_id_ = source_.size() + 1;
+
+  statements_.clear();
+  boundaries_.clear();
+  errors_.clear();
+  Parser::Cursor cursor{tokens_};
+  while (!cursor.is_at_end()) {
+    boundaries_.push_back(cursor.position());
+    std::size_t const reported{cursor.error_count()};
+    statements_.push_back(Parser::Statements::declaration(cursor));
+    errors_.push_back(errors_since(cursor, reported));
+  }
+
+  resolve();
+  stats_ = {tokens_.size(), statements_.size(), 0};
+  valid_ = true;
+}
+
+auto Document::resolve() -> void {
+  resolution_.clear();
+  NameResolver{resolution_}.resolve(statements_);
+}
+
+auto Document::update(Edit const& edit) -> void {
+  std::size_t const old_end{edit.offset_ + edit.removed_};
+  std::size_t const new_end{edit.offset_ + edit.inserted_.size()};
+  auto const shifted = [&edit](std::size_t const old_offset) {
+    return old_offset - edit.removed_ + edit.inserted_.size();
+  };
+  auto const start_of_statement = [this](std::size_t const index) {
+    return starts_[boundaries_[index]];
+  };
+
+  // Start over from the statement before the one the edit begins in: its
+  // parse may have looked one token ahead into the edited statement (an `if`
+  // looking for `else`, or error recovery looking for a `;`).
+  auto const after{std::partition_point(
+      boundaries_.begin(), boundaries_.end(),
+      [&](std::size_t const boundary) {
+        return starts_[boundary] < edit.offset_;
+      })};
+  std::size_t const touched(std::distance(boundaries_.begin(), after));
+  std::size_t const first{touched >= 2 ? touched - 2 : 0};
+
+  std::size_t const first_token{boundaries_.empty() ? 0 : boundaries_[first]};
+  std::size_t const begin{first_token == 0 ? 0 : starts_[first_token]};
+  std::size_t line{first_token == 0 ? 1 : first_line(tokens_[first_token])};
+
+  // Re-scan until reaching the start of an old statement lying entirely
+  // after the edit: from there on the text, and so the tokens, are unchanged.
+  std::size_t candidate{touched};
+  auto const stop = [&](std::size_t const offset) {
+    if (offset < new_end) {
+      return false;
+    }
+    while (candidate < boundaries_.size() &&
+           (start_of_statement(candidate) < old_end ||
+            shifted(start_of_statement(candidate)) < offset)) {
+      ++candidate;
+    }
+    return candidate < boundaries_.size() &&
+           shifted(start_of_statement(candidate)) == offset;
+  };
+  std::vector<Token> scanned{Scanner::scan_tokens(source_, begin, line, stop)};
+  bool const resynchronized{scanned.empty() ||
+                            scanned.back().type_ != TokenType::EOFF};
+
+  std::vector<std::size_t> scanned_starts{};
+  scanned_starts.reserve(scanned.size());
+  for (Token& token : scanned) {
+    scanned_starts.push_back(start_of(token));
+    token.token_id_ = next_token_id_++;
+  }
+
+  std::size_t const last_token{resynchronized ? boundaries_[candidate]
+                                              : tokens_.size()};
+  auto const token_delta{static_cast<std::ptrdiff_t>(scanned.size()) -
+                         static_cast<std::ptrdiff_t>(last_token - first_token)};
+  auto const line_delta{resynchronized
+                            ? static_cast<std::ptrdiff_t>(line) -
+                                  static_cast<std::ptrdiff_t>(
+                                      first_line(tokens_[last_token]))
+                            : 0};
+
+  stats_ = {scanned.size(), 0, 0};
+
+  std::vector<std::size_t> stale_ids{};
+  for (std::size_t i = first_token; i < last_token; ++i) {
+    stale_ids.push_back(tokens_[i].token_id_);
+  }
+
+  std::size_t const kept_token{first_token + scanned.size()};
+  splice(tokens_, first_token, last_token, std::move(scanned));
+  splice(starts_, first_token, last_token, std::move(scanned_starts));
+  for (std::size_t i = kept_token; i < tokens_.size(); ++i) {
+    starts_[i] = shifted(starts_[i]);
+    if (line_delta != 0) {
+      LineShift{line_delta}(tokens_[i]);
+    }
+  }
+
+  // Re-parse until landing exactly on the first token of an old statement
+  // whose tokens were all kept; parsing on from there would reproduce it.
+  std::size_t reused{boundaries_.size()};
+  std::size_t next_stop{resynchronized ? candidate : boundaries_.size()};
+  std::vector<Statement> parsed{};
+  std::vector<std::size_t> parsed_boundaries{};
+  std::vector<std::vector<Parser::Error>> parsed_errors{};
+  Parser::Cursor cursor{tokens_, first_token};
+  while (!cursor.is_at_end()) {
+    std::size_t const position{cursor.position()};
+    while (next_stop < boundaries_.size() &&
+           boundaries_[next_stop] + token_delta < position) {
+      ++next_stop;
+    }
+    if (next_stop < boundaries_.size() &&
+        boundaries_[next_stop] + token_delta == position) {
+      reused = next_stop;
+      break;
+    }
+    parsed_boundaries.push_back(position);
+    std::size_t const reported{cursor.error_count()};
+    parsed.push_back(Parser::Statements::declaration(cursor));
+    parsed_errors.push_back(errors_since(cursor, reported));
+  }
+
+  stats_.declarations_parsed_ = parsed.size();
+  stats_.declarations_reused_ = first + (boundaries_.size() - reused);
+
+  // Kept tokens that belonged to re-parsed statements
+  std::size_t const reparsed_end{reused < boundaries_.size()
+                                     ? boundaries_[reused] + token_delta
+                                     : tokens_.size()};
+  for (std::size_t i = kept_token; i < reparsed_end; ++i) {
+    stale_ids.push_back(tokens_[i].token_id_);
+  }
+
+  // Statements after the edit resolve the same way as long as the re-parsed
+  // statements declare the same globals as the ones they replace.
+  bool const same_globals{
+      declared_globals(statements_.begin() + first,
+                       statements_.begin() + reused) ==
+      declared_globals(parsed.begin(), parsed.end())};
+
+  std::size_t const kept_statement{first + parsed.size()};
+  splice(statements_, first, reused, std::move(parsed));
+  splice(boundaries_, first, reused, std::move(parsed_boundaries));
+  splice(errors_, first, reused, std::move(parsed_errors));
+  for (std::size_t i = kept_statement; i < statements_.size(); ++i) {
+    boundaries_[i] += token_delta;
+    if (line_delta != 0) {
+      LineShift{line_delta}(statements_[i]);
+      LineShift{line_delta}(errors_[i]);
+    }
+  }
+
+  if (!same_globals) {
+    resolve();
+    return;
+  }
+
+  for (std::size_t const id : stale_ids) {
+    resolution_.erase(
+        Token{TokenType::IDENTIFIER, "", std::monostate{}, 0, id});
+  }
+
+  std::unordered_map<std::string, bool> globals{};
+  for (std::size_t i = 0; i < first; ++i) {
+    if (std::optional<std::string> name{declared_global(statements_[i])}) {
+      globals[std::move(*name)] = true;
+    }
+  }
+  NameResolver resolver{resolution_, std::move(globals)};
+  for (std::size_t i = first; i < kept_statement; ++i) {
+    std::visit(resolver, statements_[i]);
+  }
+}
+}  // namespace Incremental
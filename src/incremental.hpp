@@ -0,0 +1,100 @@
+#ifndef LOX_INCREMENTAL
+#define LOX_INCREMENTAL
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "./parser/error.hpp"
+#include "./types/statement.hpp"
+#include "./types/token.hpp"
+
+namespace Incremental {
+/**
+ * Replaces removed_ bytes at offset_ with inserted_.
+ */
+struct Edit {
+  std::size_t offset_;
+  std::size_t removed_;
+  std::string inserted_;
+};
+
+/**
+ * How much of the previous front-end output an edit could reuse.
+ */
+struct Stats {
+  std::size_t tokens_scanned_;
+  std::size_t declarations_parsed_;
+  std::size_t declarations_reused_;
+};
+
+/**
+ * A source text together with its tokens, top-level declarations and
+ * resolution, kept up to date across edits.
+ *
+ * An edit re-scans from the start of the top-level declaration before the one
+ * it touches, until the scanner lines up with the start of an unchanged
+ * declaration again. Only the declarations in between are re-parsed; the
+ * tokens and statements after them are kept, with their offsets and lines
+ * shifted. Token ids stay stable for kept tokens and are fresh for re-scanned
+ * ones, so ids remain unique but are no longer source offsets.
+ */
+class Document {
+ public:
+  /**
+   * Runs the full front end over the source. Syntax errors the parser
+   * recovers from are kept as diagnostics instead.
+   *
+   * @throws CompileTimeError If scanning or resolving fails.
+   */
+  explicit Document(std::string source);
+
+  /**
+   * Applies an edit and brings the front-end output up to date, along with
+   * the diagnostics.
+   *
+   * @throws std::out_of_range If the edit does not lie within the source.
+   * @throws CompileTimeError If scanning or resolving the edited source fails.
+   * The edit is still applied, and the next edit rebuilds from scratch.
+   */
+  auto apply(Edit const& edit) -> void;
+
+  [[nodiscard]] auto source() const -> std::string const&;
+
+  [[nodiscard]] auto tokens() const -> std::vector<Token> const&;
+
+  [[nodiscard]] auto statements() const -> std::vector<Statement> const&;
+
+  [[nodiscard]] auto resolution() const
+      -> std::unordered_map<Token, std::size_t> const&;
+
+  // The syntax errors of the source as it stands, in source order.
+  [[nodiscard]] auto diagnostics() const -> std::vector<Parser::Error>;
+
+  // What the last call to apply() had to redo.
+  [[nodiscard]] auto stats() const -> Stats;
+
+ private:
+  auto rebuild() -> void;
+
+  auto resolve() -> void;
+
+  auto update(Edit const& edit) -> void;
+
+  std::string source_;
+  std::vector<Token> tokens_;
+  // Offset of the first character of each token
+  std::vector<std::size_t> starts_;
+  std::vector<Statement> statements_;
+  // Index of the first token of each top-level statement
+  std::vector<std::size_t> boundaries_;
+  // The syntax errors of each top-level statement, kept with it
+  std::vector<std::vector<Parser::Error>> errors_;
+  std::unordered_map<Token, std::size_t> resolution_;
+  std::size_t next_token_id_;
+  bool valid_;
+  Stats stats_;
+};
+}  // namespace Incremental
+
+#endif
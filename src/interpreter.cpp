@@ -1,23 +1,61 @@
 #include "./interpreter.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <utility>
 #include <variant>
+#include <vector>
 
+#include "./budget.hpp"
 #include "./builtins.hpp"
+#include "./memory.hpp"
+#include "./output.hpp"
+#include "./profiler.hpp"
+#include "./tasks/scheduler.hpp"
+#include "./tasks/transfer.hpp"
+#include "./trace.hpp"
 #include "./types/class.hpp"
 #include "./types/expression.hpp"
 #include "./types/function.hpp"
+#include "./types/generator.hpp"
+#include "./types/hash.hpp"
+#include "./types/list.hpp"
+#include "./types/map.hpp"
+#include "./types/native.hpp"
 #include "./types/object.hpp"
+#include "./types/program.hpp"
+#include "./types/rope.hpp"
 #include "./types/statement.hpp"
+#include "./types/task.hpp"
 #include "./types/token.hpp"
 #include "./utils/box.hpp"
 #include "./utils/error.hpp"
 
 namespace {
-struct Return {
-  Object value_;
-};
+// Statements between checks of the budget, when there is one
+constexpr std::uint64_t CHECK_INTERVAL{1024};
+
+// How deep calls may nest without a budget saying otherwise. A call of a Lox
+// function takes no native stack, and under a kilobyte of heap with its scope,
+// so runaway recursion stops short of a gigabyte.
+constexpr std::size_t MAX_CALL_DEPTH{std::size_t{1} << 20};
+
+// The live bytes of the calling thread when it last added to the heap usage
+// of an execution
+thread_local std::int64_t heap_mark{0};
 
 template <typename... Objects>
 auto check_number_operand(Token const& token, Objects... operands) -> void {
@@ -31,63 +69,86 @@ auto check_number_operand(Token const& token, Objects... operands) -> void {
   }
 }
 
-struct Equality {
-  auto operator()(std::monostate, std::monostate) -> bool { return true; }
-  auto operator()(bool left, bool right) -> bool { return left == right; }
-  auto operator()(double left, double right) -> bool { return left == right; }
-  auto operator()(std::string const& left, std::string const& right) -> bool {
-    return left == right;
+auto list_index(LoxList const& list, Object const& index, Token const& bracket)
+    -> std::size_t {
+  auto const number{std::get_if<double>(&index)};
+  if (!number || *number != std::floor(*number)) {
+    throw RuntimeError{bracket.line_, "List index must be an integer."};
   }
-  auto operator()(Box<LoxFunction> const& left, LoxFunction const& right)
-      -> bool {
-    // TODO
-    return false;
+  if (*number < 0 || *number >= static_cast<double>(list.elements_.size())) {
+    throw RuntimeError{bracket.line_, "List index out of range."};
   }
+  return static_cast<std::size_t>(*number);
+}
+
+struct Put {
+  auto operator()(std::string const& str) -> void { out_.write(str); }
 
-  template <typename T, typename U>
-  auto operator()(T const& left, U const& right) -> bool {
-    return false;
+  auto operator()(std::shared_ptr<LoxRope> const& rope) -> void {
+    out_.write(rope->str());
   }
-};
 
-auto is_equal(Object const& left, Object const& right) -> bool {
-  return std::visit(Equality{}, left, right);
-}
+  auto operator()(double const number) -> void { out_.write(number); }
 
-template <typename OStream>
-struct Put {
-  Put(OStream& out) : out_{out} {}
+  auto operator()(bool const b) -> void { out_.write(b ? "true" : "false"); }
 
-  auto operator()(std::string const& str) -> OStream& { return put(str); }
+  auto operator()(Box<LoxFunction> const& func) -> void {
+    out_.write("<fn " + func->declaration_->name_.lexeme_ + ">");
+  }
 
-  auto operator()(double const number) -> OStream& { return put(number); }
+  auto operator()(Box<LoxClass> const& klass) -> void {
+    out_.write("<class " + klass->name_ + ">");
+  }
 
-  auto operator()(bool const b) -> OStream& {
-    return b ? put("true") : put("false");
+  auto operator()(std::shared_ptr<LoxInstance> const& instance) -> void {
+    out_.write("<instance of " + instance->class_.name_ + ">");
   }
 
-  auto operator()(Box<LoxFunction> const& func) -> OStream& {
-    return put("<fn " + func->declaration_.name_.lexeme_ + ">");
+  auto operator()(std::shared_ptr<NativeFunction> const& func) -> void {
+    out_.write("<native fn " + func->name_ + ">");
   }
 
-  auto operator()(Box<LoxClass> const& klass) -> OStream& {
-    return put("<class " + klass->name_ + ">");
+  auto operator()(std::shared_ptr<LoxList> const& list) -> void {
+    out_.write('[');
+    for (std::size_t i = 0; i < list->elements_.size(); ++i) {
+      if (i > 0) {
+        out_.write(", ");
+      }
+      std::visit(*this, list->elements_[i]);
+    }
+    out_.write(']');
   }
 
-  auto operator()(std::shared_ptr<LoxInstance> const& instance) -> OStream& {
-    return put("<instance of " + instance->class_.name_ + ">");
+  auto operator()(std::shared_ptr<LoxMap> const& map) -> void {
+    out_.write('{');
+    bool first{true};
+    map->for_each([this, &first](Object const& key, Object const& value) {
+      if (!first) {
+        out_.write(", ");
+      }
+      first = false;
+      std::visit(*this, key);
+      out_.write(": ");
+      std::visit(*this, value);
+    });
+    out_.write('}');
   }
 
-  auto operator()(std::monostate) -> OStream& { return put("nil"); }
+  auto operator()(std::shared_ptr<LoxTask> const&) -> void {
+    out_.write("<task>");
+  }
 
- private:
-  template <typename T>
-  auto put(T const& obj) -> OStream& {
-    out_ << obj << '\n';
-    return out_;
+  auto operator()(std::shared_ptr<LoxChannel> const&) -> void {
+    out_.write("<channel>");
   }
 
-  OStream& out_;
+  auto operator()(std::shared_ptr<LoxGenerator> const&) -> void {
+    out_.write("<generator>");
+  }
+
+  auto operator()(std::monostate) -> void { out_.write("nil"); }
+
+  Output::Sink& out_;
 };
 
 struct Truth {
@@ -106,321 +167,1522 @@ auto is_truthy(Object const& obj) -> bool { return std::visit(Truth{}, obj); }
 struct UncallableError : public std::exception {};
 struct Arity {
   auto operator()(Box<LoxFunction> const& func) -> std::size_t {
-    return func->declaration_.params_.size();
+    return func->declaration_->params_.size();
   }
 
   auto operator()(Box<LoxClass> const&) -> std::size_t { return 0; }
 
+  auto operator()(std::shared_ptr<NativeFunction> const& func) -> std::size_t {
+    return func->arity_;
+  }
+
   template <typename T>
   auto operator()(T const& t) -> std::size_t {
     throw UncallableError{};
   }
 };
 
-struct Call {
-  [[nodiscard]] auto operator()(Box<LoxFunction>& func) -> Object {
-    auto const env{std::make_shared<Environment>(func->closure_)};
+auto check_count(std::size_t const arity, std::size_t const count,
+                 Token const& paren) -> void {
+  if (count != arity) {
+    throw RuntimeError{paren.line_, "Expected " + std::to_string(arity) +
+                                        " arguments but got " +
+                                        std::to_string(count) + "."};
+  }
+}
+
+auto check_arity(Object const& callee, std::size_t const count,
+                 Token const& paren) -> void {
+  std::size_t arity{0};
+  try {
+    arity = std::visit(Arity{}, callee);
+  } catch (UncallableError const&) {
+    throw RuntimeError{paren.line_, "Can only call functions and classes."};
+  }
+  check_count(arity, count, paren);
+}
 
-    std::size_t const arity{std::visit(Arity{}, Object{func})};
+auto binary(Token const& op, Object const& left, Object const& right)
+    -> Object {
+  TokenType const& op_type{op.type_};
 
-    for (std::size_t i = 0; i < arity; ++i) {
-      env->define(func->declaration_.params_.at(i).lexeme_, args_.at(i));
+  if (op_type == TokenType::MINUS) {
+    check_number_operand(op, left, right);
+    return std::get<double>(left) - std::get<double>(right);
+  }
+  if (op_type == TokenType::SLASH) {
+    check_number_operand(op, left, right);
+    return std::get<double>(left) / std::get<double>(right);
+  }
+  if (op_type == TokenType::STAR) {
+    check_number_operand(op, left, right);
+    return std::get<double>(left) * std::get<double>(right);
+  }
+  if (op_type == TokenType::PLUS) {
+    if (std::holds_alternative<double>(left) &&
+        std::holds_alternative<double>(right)) {
+      return std::get<double>(left) + std::get<double>(right);
     }
-
-    try {
-      Interpreter::interpret(func->declaration_.body_, resolution_, env);
-    } catch (Return const& ret) {
-      return ret.value_;
+    if (is_string(left) && is_string(right)) {
+      Memory::Site const site{Memory::Category::STRING, op.line_};
+      return concatenate(left, right);
     }
+    throw RuntimeError{op.line_,
+                       "Operands must be two numbers or two strings."};
+  }
+  if (op_type == TokenType::GREATER) {
+    check_number_operand(op, left, right);
+    return std::get<double>(left) > std::get<double>(right);
+  }
+  if (op_type == TokenType::GREATER_EQUAL) {
+    check_number_operand(op, left, right);
+    return std::get<double>(left) >= std::get<double>(right);
+  }
+  if (op_type == TokenType::LESS) {
+    check_number_operand(op, left, right);
+    return std::get<double>(left) < std::get<double>(right);
+  }
+  if (op_type == TokenType::LESS_EQUAL) {
+    check_number_operand(op, left, right);
+    return std::get<double>(left) <= std::get<double>(right);
+  }
+  if (op_type == TokenType::BANG_EQUAL) {
+    return !is_equal(left, right);
+  }
+  if (op_type == TokenType::EQUAL_EQUAL) {
+    return is_equal(left, right);
+  }
+  // Unreachable
+  return std::monostate{};
+}
 
-    return std::monostate{};
+auto unary(Token const& op, Object const& right) -> Object {
+  if (op.type_ == TokenType::MINUS) {
+    check_number_operand(op, right);
+    return -std::get<double>(right);
   }
 
-  [[nodiscard]] auto operator()(Box<LoxClass> const& klass) -> Object {
-    return std::make_shared<LoxInstance>(LoxInstance{*klass, {}});
+  if (op.type_ == TokenType::BANG) {
+    return !is_truthy(right);
+  }
+
+  return std::monostate{};
+}
+
+/**
+ * What is left to do of the code running on a stack, as steps done last
+ * pushed first. A step that takes values finds them on top of the stack of
+ * values, where the steps before it left them, and leaves its own there.
+ */
+namespace Then {
+struct Evaluate {
+  Expression const* expr_;
+};
+
+// The expressions from the next one on
+struct Values {
+  std::vector<Expression> const* exprs_;
+  std::size_t next_;
+};
+
+// The statements from the next one on
+struct Execute {
+  std::vector<Statement> const* statements_;
+  std::size_t next_;
+};
+
+// Leaves the scope of a block
+struct Close {};
+
+// Returns nil from a call whose body ran to its end
+struct Leave {};
+
+struct Discard {};
+
+struct Print {};
+
+struct Return {};
+
+struct Yield {};
+
+struct Define {
+  VariableStatement const* stmt_;
+};
+
+// Declares the class once its superclass is evaluated
+struct Inherit {
+  ClassStatement const* stmt_;
+};
+
+struct Branch {
+  Box<IfStatement> const* stmt_;
+};
+
+// Runs the body of the loop if its condition holds
+struct Loop {
+  Box<WhileStatement> const* stmt_;
+};
+
+// Checks the condition of the loop again once its body has run
+struct Repeat {
+  Box<WhileStatement> const* stmt_;
+};
+
+struct Assign {
+  AssignmentExpression const* expr_;
+};
+
+struct Binary {
+  BinaryExpression const* expr_;
+};
+
+struct Unary {
+  UnaryExpression const* expr_;
+};
+
+struct Logical {
+  Box<LogicalExpression> const* expr_;
+};
+
+struct Get {
+  GetExpression const* expr_;
+};
+
+// Evaluates the value once the object turns out to be an instance
+struct SetOn {
+  SetExpression const* expr_;
+};
+
+struct Set {
+  SetExpression const* expr_;
+};
+
+struct Index {
+  IndexExpression const* expr_;
+};
+
+struct IndexSet {
+  IndexSetExpression const* expr_;
+};
+
+struct List {
+  ListExpression const* expr_;
+};
+
+// Calls the callee under the arguments
+struct Invoke {
+  CallExpression const* expr_;
+};
+
+// Looks up the method called once the object it is called on is evaluated
+struct Method {
+  CallExpression const* expr_;
+};
+
+// Calls the method on the instance under the arguments
+struct InvokeMethod {
+  CallExpression const* expr_;
+  LoxFunction const* method_;
+};
+
+struct Spawn {
+  SpawnExpression const* expr_;
+};
+}  // namespace Then
+
+using Step =
+    std::variant<Then::Evaluate, Then::Values, Then::Execute, Then::Close,
+                 Then::Leave, Then::Discard, Then::Print, Then::Return,
+                 Then::Yield, Then::Define, Then::Inherit, Then::Branch,
+                 Then::Loop, Then::Repeat, Then::Assign, Then::Binary,
+                 Then::Unary, Then::Logical, Then::Get, Then::SetOn,
+                 Then::Set, Then::Index, Then::IndexSet, Then::List,
+                 Then::Invoke, Then::Method, Then::InvokeMethod, Then::Spawn>;
+
+/**
+ * The code running on one stack: that of the main program, of a task, or of
+ * the body of a generator. Evaluating doesn't recurse into calls. A call of a
+ * Lox function is a frame on the heap, and what is left to do of its callers
+ * is steps on a stack of their own, so recursion only takes memory, not
+ * native stack, and is only limited by the maximum depth. Code that calls
+ * nothing runs right away, nesting natively only as deep as it is written.
+ *
+ * Also counts the statements executed on the stack, so that the budget of
+ * the execution is only checked every so often, and keeps the shadow of the
+ * stack that the profiler samples.
+ */
+class CallStack {
+ public:
+  // Whoever resumes a generator suspended at a yield runs on their own stack
+  class Suspension {
+   public:
+    explicit Suspension(CallStack& calls) : calls_{calls} {
+      Profiler::activate(calls_.shadow_.parent_);
+    }
+
+    Suspension(Suspension const&) = delete;
+    auto operator=(Suspension const&) -> Suspension& = delete;
+
+    ~Suspension() {
+      calls_.shadow_.parent_ = Profiler::activate(&calls_.shadow_);
+    }
+
+   private:
+    CallStack& calls_;
+  };
+
+  CallStack(Interpreter::Context& context, char const* const root,
+            std::shared_ptr<GlobalEnvironment> globals)
+      : context_{context},
+        globals_{std::move(globals)},
+        shadow_{root, 0, nullptr, nullptr},
+        depth_{0},
+        max_depth_{context.budget_.call_depth_.value_or(MAX_CALL_DEPTH)},
+        statements_{0},
+        checked_{0},
+        next_check_{limited(context.budget_)
+                        ? 0
+                        : std::numeric_limits<std::uint64_t>::max()} {
+    shadow_.parent_ = Profiler::activate(&shadow_);
   }
 
+  CallStack(CallStack const&) = delete;
+  auto operator=(CallStack const&) -> CallStack& = delete;
+
+  ~CallStack() { Profiler::activate(shadow_.parent_); }
+
+  /**
+   * Runs the statements in the environment until they end or return: those
+   * of the program, or the body of a generator.
+   */
+  auto run(std::vector<Statement> const& statements,
+           std::shared_ptr<Environment> env,
+           LoxFunction::Upvalues const* upvalues = nullptr,
+           LoxGenerator* generator = nullptr) -> void;
+
+  // Calls the callee with as many arguments as it takes
+  auto call(Object callee, std::vector<Object> args, std::size_t line)
+      -> Object;
+
+ private:
+  // A call in progress. That of a Lox function also keeps where its caller
+  // continues once it returns.
+  struct Frame {
+    Profiler::Frame shadow_{};
+    // Of the call
+    std::size_t line_{0};
+    // Unset unless tracing
+    Trace::Clock::time_point start_{};
+    std::shared_ptr<Environment> environment_{};
+    LoxFunction::Upvalues const* upvalues_{nullptr};
+    // How many steps and values the caller had, up to the callee
+    std::size_t steps_{0};
+    std::size_t values_{0};
+  };
+
+  // A call that is over before the stack goes on: that of a native function,
+  // of a class, or of a function that yields
+  class Immediate {
+   public:
+    Immediate(CallStack& calls, std::size_t const line,
+              std::string_view const name)
+        : calls_{calls} {
+      calls_.enter(frame_, line, name);
+    }
+
+    Immediate(Immediate const&) = delete;
+    auto operator=(Immediate const&) -> Immediate& = delete;
+
+    ~Immediate() { calls_.leave(frame_); }
+
+   private:
+    CallStack& calls_;
+    Frame frame_{};
+  };
+
+  struct ExpressionEvaluator;
+  struct StatementExecutor;
+  struct Continuation;
+  struct Call;
+
+  // Frames are allocated by the block, and kept for the calls to come
+  static constexpr std::size_t FRAMES_PER_BLOCK{256};
+
+  // Starts evaluating the expression, whose value ends up on top of the
+  // stack of values
+  auto evaluate(Expression const& expr) -> void;
+
+  auto execute(Statement const& stmt) -> void;
+
+  // Does the steps left, until there are none
+  auto resume() -> void;
+
+  auto then(Step const step) -> void { steps_.push_back(step); }
+
   template <typename T>
-  [[nodiscard]] auto operator()(T const& t) -> Object {
-    throw UncallableError{};
+  auto push(T&& value) -> void {
+    values_.emplace_back(std::forward<T>(value));
   }
 
-  std::shared_ptr<Environment> environment_;
-  std::unordered_map<Token, std::size_t> const& resolution_;
-  std::vector<Object> const& args_;
-};
+  auto pop() -> Object {
+    Object value{std::move(values_.back())};
+    values_.pop_back();
+    return value;
+  }
 
-struct ExpressionEvaluator {
-  std::shared_ptr<Environment> environment_;
-  std::unordered_map<Token, std::size_t> const& resolution_;
+  // Drops the values from the index on
+  auto drop(std::size_t const from) -> void {
+    values_.erase(values_.begin() + static_cast<std::ptrdiff_t>(from),
+                  values_.end());
+  }
 
-  [[nodiscard]] auto operator()(std::monostate) -> Object {
-    return std::monostate{};
+  /**
+   * Whether the expression was evaluated right away, rather than leaving
+   * steps, such as those of a call it started
+   */
+  auto evaluated(Expression const& expr) -> bool {
+    std::size_t const mark{steps_.size()};
+    evaluate(expr);
+    return steps_.size() == mark;
   }
 
-  [[nodiscard]] auto operator()(LiteralExpression const& expr) -> Object {
-    return std::visit([](auto const& value) -> Object { return value; },
-                      expr.value_);
+  // The expressions from the index on, in order, until one leaves steps. The
+  // rest is left to do after those.
+  auto evaluate(std::vector<Expression> const& exprs, std::size_t from)
+      -> void;
+
+  auto execute(std::vector<Statement> const& statements, std::size_t from)
+      -> void;
+
+  /**
+   * Does the step right away if nothing since the mark left steps, or else
+   * once those are done. Only what waits on a call, a block, or a return
+   * goes through the stack of steps.
+   */
+  template <typename T>
+  auto then(std::size_t mark, T step) -> void;
+
+  /**
+   * Leaves the steps, in the order they are to be done, for after those left
+   * since the mark. A call started since then returns to them.
+   */
+  auto later(std::size_t const mark, std::initializer_list<Step> const steps)
+      -> void {
+    steps_.insert(steps_.begin() + static_cast<std::ptrdiff_t>(mark),
+                  std::rbegin(steps), std::rend(steps));
+    if (frames_ > 0 && innermost().steps_ >= mark) {
+      innermost().steps_ += steps.size();
+    }
   }
 
-  [[nodiscard]] auto operator()(ThisExpression const& expr) -> Object {
-    return (*this)(VariableExpression{expr.keyword_});
+  // Evaluates the arguments of the call in order, then does the step
+  template <typename T>
+  auto arguments(CallExpression const& expr, T const step) -> void {
+    std::size_t const mark{steps_.size()};
+    evaluate(expr.arguments_, 0);
+    then(mark, step);
   }
 
-  [[nodiscard]] auto operator()(VariableExpression const& expr) -> Object {
-    if (auto const found{resolution_.find(expr.name_)};
-        found != resolution_.end()) {
-      std::size_t const distance = found->second;
-      return environment_->get_at(expr.name_.lexeme_, distance);
-    } else {
-      throw RuntimeError{expr.name_.line_,
-                         expr.name_.lexeme_ + " is not defined"};
+  /**
+   * Calls the callee under as many arguments on the stack of values, which
+   * it leaves what it returns in place of once it has.
+   */
+  auto invoke(std::size_t count, std::size_t line) -> void;
+
+  /**
+   * Starts on the body of the function, with this bound to the instance if
+   * any. What is on the stack of values under the arguments stays there
+   * until the call returns, so that what the function refers to lives as
+   * long: the callee, or the instance a method is called on.
+   */
+  auto start(LoxFunction const& func,
+             std::shared_ptr<LoxInstance> const& instance,
+             std::size_t const arguments, std::size_t const line,
+             std::string_view const name) -> void {
+    Frame& frame{next_frame()};
+    enter(frame, line, name);
+    ++frames_;
+    frame.environment_ =
+        std::exchange(environment_, scope(func, instance, arguments, line));
+    frame.upvalues_ = std::exchange(upvalues_, func.upvalues_.get());
+    frame.steps_ = steps_.size();
+    frame.values_ = arguments - 1;
+
+    std::vector<Statement> const& body{func.declaration_->body_};
+    drop(arguments);
+    then(Then::Leave{});
+    if (!body.empty()) {
+      then(Then::Execute{&body, 0});
     }
   }
 
-  [[nodiscard]] auto operator()(Box<AssignmentExpression> const& expr)
-      -> Object {
-    Object const value{std::visit(*this, expr->value_)};
-    if (auto const found{resolution_.find(expr->name_)};
-        found != resolution_.end()) {
-      std::size_t const distance = found->second;
-      environment_->assign_at(expr->name_.lexeme_, value, distance);
-    } else {
-      throw RuntimeError{expr->name_.line_,
-                         expr->name_.lexeme_ + " is not defined"};
+  /**
+   * Returns the value on top of the stack of values from the innermost call
+   * of a Lox function. Outside of any, ends what the stack runs instead.
+   */
+  auto finish() -> void {
+    if (frames_ == 0) {
+      steps_.clear();
+      return;
     }
+    Frame& frame{innermost()};
+    steps_.erase(steps_.begin() + static_cast<std::ptrdiff_t>(frame.steps_),
+                 steps_.end());
+    environment_ = std::move(frame.environment_);
+    upvalues_ = frame.upvalues_;
+    values_[frame.values_] = std::move(values_.back());
+    drop(frame.values_ + 1);
+    leave(frame);
+    --frames_;
+  }
 
-    return value;
+  // The parameters of the function, bound to the arguments from the index on
+  [[nodiscard]] auto scope(LoxFunction const& func,
+                           std::shared_ptr<LoxInstance> const& instance,
+                           std::size_t const arguments,
+                           std::size_t const line) const
+      -> std::shared_ptr<Environment> {
+    Memory::Site const site{Memory::Category::ENVIRONMENT, line};
+    auto env{make_environment()};
+    if (instance) {
+      env->define("this", instance);
+    }
+
+    std::size_t const arity{func.declaration_->params_.size()};
+
+    for (std::size_t i = 0; i < arity; ++i) {
+      env->define(func.declaration_->params_[i].lexeme_,
+                  values_[arguments + i]);
+    }
+    return env;
   }
 
-  [[nodiscard]] auto operator()(Box<BinaryExpression> const& expr) -> Object {
-    Object const left{std::visit(*this, expr->left_)};
-    Object const right{std::visit(*this, expr->right_)};
+  // The body only starts running once the generator is first resumed
+  [[nodiscard]] auto generator(Box<LoxFunction> const& func,
+                               std::shared_ptr<Environment> const& env)
+      -> Object {
+    return std::make_shared<LoxGenerator>(
+        [func, env, &context = context_](LoxGenerator& generator) {
+          // The body runs on a stack of its own
+          CallStack calls{context, "<generator>", func->globals_};
+          calls.run(func->declaration_->body_, env, func->upvalues_.get(),
+                    &generator);
+        },
+        context_.alive_);
+  }
 
-    Token const& op{expr->op_};
-    TokenType const& op_type{op.type_};
+  // Before each statement
+  auto count() -> void { ++statements_; }
 
-    if (op_type == TokenType::MINUS) {
-      check_number_operand(op, left, right);
-      return std::get<double>(left) - std::get<double>(right);
+  // As loops go round and functions are called
+  auto checkpoint(std::size_t const line) -> void {
+    (shadow_.top_ ? shadow_.top_->line_ : shadow_.line_) = line;
+    if (statements_ >= next_check_) [[unlikely]] {
+      check(line);
     }
-    if (op_type == TokenType::SLASH) {
-      check_number_operand(op, left, right);
-      return std::get<double>(left) / std::get<double>(right);
+  }
+
+  auto enter(Frame& frame, std::size_t const line,
+             std::string_view const name) -> void {
+    if (++depth_ > max_depth_) [[unlikely]] {
+      --depth_;
+      overflow(line);
     }
-    if (op_type == TokenType::STAR) {
-      check_number_operand(op, left, right);
-      return std::get<double>(left) * std::get<double>(right);
+    checkpoint(line);
+    frame.shadow_ = {name, 0, shadow_.top_};
+    frame.line_ = line;
+    frame.start_ = Trace::active.load(std::memory_order_relaxed)
+                       ? Trace::Clock::now()
+                       : Trace::Clock::time_point{};
+    // A sample may interrupt the call anywhere, but must find it whole
+    std::atomic_signal_fence(std::memory_order_release);
+    shadow_.top_ = &frame.shadow_;
+  }
+
+  auto leave(Frame const& frame) -> void {
+    shadow_.top_ = frame.shadow_.caller_;
+    --depth_;
+    if (frame.start_ != Trace::Clock::time_point{}) {
+      Trace::call(frame.shadow_.name_, frame.line_, frame.start_,
+                  Trace::Clock::now());
     }
-    if (op_type == TokenType::PLUS) {
-      if (std::holds_alternative<double>(left) &&
-          std::holds_alternative<double>(right)) {
-        return std::get<double>(left) + std::get<double>(right);
-      }
-      if (std::holds_alternative<std::string>(left) &&
-          std::holds_alternative<std::string>(right)) {
-        return std::get<std::string>(left) + std::get<std::string>(right);
-      }
-      throw RuntimeError{op.line_,
-                         "Operands must be two numbers or two strings."};
+  }
+
+  // Where the frame of the next call of a Lox function goes. Frames don't
+  // move, for the profiler to follow the links between them.
+  auto next_frame() -> Frame& {
+    if (frames_ == blocks_.size() * FRAMES_PER_BLOCK) [[unlikely]] {
+      Memory::Site const site{Memory::Category::ENVIRONMENT, line()};
+      blocks_.push_back(std::make_unique<Frame[]>(FRAMES_PER_BLOCK));
     }
-    if (op_type == TokenType::GREATER) {
-      check_number_operand(op, left, right);
-      return std::get<double>(left) > std::get<double>(right);
+    return blocks_[frames_ / FRAMES_PER_BLOCK][frames_ % FRAMES_PER_BLOCK];
+  }
+
+  auto innermost() -> Frame& {
+    return blocks_[(frames_ - 1) / FRAMES_PER_BLOCK]
+                  [(frames_ - 1) % FRAMES_PER_BLOCK];
+  }
+
+  // Where the innermost call is at, as of its last checkpoint
+  [[nodiscard]] auto line() const -> std::size_t {
+    return shadow_.top_ ? shadow_.top_->line_ : shadow_.line_;
+  }
+
+  // The global in the slot, unless it is not defined yet
+  auto global(std::size_t const slot, Token const& name) -> Object& {
+    if (Object* const value{globals_ ? globals_->find(slot) : nullptr})
+        [[likely]] {
+      return *value;
     }
-    if (op_type == TokenType::GREATER_EQUAL) {
-      check_number_operand(op, left, right);
-      return std::get<double>(left) >= std::get<double>(right);
+    undefined(name);
+  }
+
+  // Declarations at the top level define globals, in the slot their name
+  // resolved to. Others define variables of the scope they are in.
+  auto define(Token const& name, Object const& value) -> void {
+    if (environment_) {
+      environment_->define(name.lexeme_, value);
+      return;
     }
-    if (op_type == TokenType::LESS) {
-      check_number_operand(op, left, right);
-      return std::get<double>(left) < std::get<double>(right);
+    globals_->define(context_.resolution_.at(name) - GLOBAL, value);
+  }
+
+  // The variable the name resolves to: a global, one the function captured,
+  // or a local
+  [[nodiscard]] auto variable(Token const& name) -> Object& {
+    return variable(name, name.lexeme_);
+  }
+
+  // As above, for a token resolving to a variable of another name
+  [[nodiscard]] auto variable(Token const& token, std::string const& name)
+      -> Object& {
+    auto const found{context_.resolution_.find(token)};
+    if (found == context_.resolution_.end()) {
+      throw RuntimeError{token.line_, name + " is not defined"};
     }
-    if (op_type == TokenType::LESS_EQUAL) {
-      check_number_operand(op, left, right);
-      return std::get<double>(left) <= std::get<double>(right);
+    std::size_t const distance = found->second;
+    if (distance >= GLOBAL) {
+      return global(distance - GLOBAL, token);
     }
-    if (op_type == TokenType::BANG_EQUAL) {
-      return !is_equal(left, right);
+    if (distance >= UPVALUE) {
+      return (*upvalues_)[distance - UPVALUE]->get();
     }
-    if (op_type == TokenType::EQUAL_EQUAL) {
-      return is_equal(left, right);
+    return environment_->at(name, distance);
+  }
+
+  // The method of the superclass. Inherited methods are in the table of the
+  // superclass, so finding it takes a single lookup.
+  [[nodiscard]] auto super_method(SuperExpression const& expr)
+      -> LoxFunction const& {
+    auto const& superclass{std::get<Box<LoxClass>>(variable(expr.keyword_))};
+    LoxFunction const* const method{
+        find_method(*superclass, expr.method_.lexeme_)};
+    if (!method) {
+      throw RuntimeError{expr.method_.line_, "Undefined property '" +
+                                                 expr.method_.lexeme_ + "'."};
     }
-    // Unreachable
-    return std::monostate{};
+    return *method;
   }
 
-  [[nodiscard]] auto operator()(Box<CallExpression> const& expr) -> Object {
-    Object callee{std::visit(*this, expr->callee_)};
+  // The instance the method of the superclass is called on. The name of the
+  // method resolves to this.
+  [[nodiscard]] auto super_this(SuperExpression const& expr)
+      -> std::shared_ptr<LoxInstance> const& {
+    return std::get<std::shared_ptr<LoxInstance>>(
+        variable(expr.method_, std::string{"this"}));
+  }
 
-    std::vector<Object> args{};
-    for (auto const& arg : expr->arguments_) {
-      args.push_back(std::visit(*this, arg));
+  // Functions refer to their declaration where the program is shared
+  [[nodiscard]] auto declaration(Box<FunctionStatement> const& stmt) const
+      -> std::shared_ptr<FunctionStatement const> {
+    if (context_.program_) {
+      return {context_.program_, &*stmt};
     }
+    return std::make_shared<FunctionStatement const>(*stmt);
+  }
 
-    try {
-      std::size_t const arity{std::visit(Arity{}, callee)};
-      if (args.size() != arity) {
-        throw RuntimeError{expr->paren_.line_,
-                           "Expected " + std::to_string(arity) +
-                               " arguments but got " +
-                               std::to_string(args.size()) + "."};
+  // The function as declared in the environment, with the variables it
+  // captures from around it
+  [[nodiscard]] auto closure(Box<FunctionStatement> const& stmt,
+                             std::shared_ptr<Environment> const& env) const
+      -> LoxFunction {
+    std::shared_ptr<LoxFunction::Upvalues> upvalues{};
+    if (!stmt->captures_.empty()) {
+      upvalues = std::make_shared<LoxFunction::Upvalues>();
+      upvalues->reserve(stmt->captures_.size());
+      for (Capture const& capture : stmt->captures_) {
+        upvalues->push_back(
+            capture.from_ >= UPVALUE
+                ? (*upvalues_)[capture.from_ - UPVALUE]
+                : env->capture(capture.name_, capture.from_));
       }
-      return std::visit(Call{environment_, resolution_, args}, callee);
-    } catch (UncallableError const& e) {
-      throw RuntimeError{expr->paren_.line_,
-                         "Can only call functions and classes."};
     }
+    return LoxFunction{declaration(stmt), std::move(upvalues), globals_,
+                       nullptr};
   }
 
-  [[nodiscard]] auto operator()(Box<GetExpression> const& expr) -> Object {
-    Object const obj{std::visit(*this, expr->object_)};
+  // Inherited methods come first, for those of the class to override
+  auto declare(ClassStatement const& stmt, Object* const superclass) -> void {
+    Memory::Site const site{Memory::Category::FUNCTION, stmt.name_.line_};
+    auto methods{std::make_shared<LoxClass::Methods>()};
+    auto env{environment_};
+    if (superclass) {
+      auto const klass{std::get_if<Box<LoxClass>>(superclass)};
+      if (!klass) {
+        throw RuntimeError{
+            std::get<VariableExpression>(stmt.superclass_).name_.line_,
+            "Superclass must be a class."};
+      }
+      *methods = *(*klass)->methods_;
+      env = make_environment(environment_);
+      env->define("super", std::move(*superclass));
+    }
 
-    if (auto const instance{std::get_if<std::shared_ptr<LoxInstance>>(&obj)}) {
-      return get(*instance, expr->name_);
+    define(stmt.name_, std::monostate{});
+    for (Box<FunctionStatement> const& method : stmt.methods_) {
+      (*methods)[method->name_.lexeme_] = closure(method, env);
     }
 
-    throw RuntimeError{expr->name_.line_, "Only instances have properties."};
+    define(stmt.name_, LoxClass{stmt.name_.lexeme_, std::move(methods)});
   }
 
-  [[nodiscard]] auto operator()(Box<GroupingExpression> const& expr) -> Object {
-    return std::visit(*this, expr->expression_);
+  // Counts which way the branch of a node went, if counting
+  template <typename T>
+  auto branch(Box<T> const& node, bool const taken) -> bool {
+    if (context_.counters_) [[unlikely]] {
+      context_.counters_->branch(node, taken);
+    }
+    return taken;
   }
 
-  [[nodiscard]] auto operator()(Box<LogicalExpression> const& expr) -> Object {
-    Object const left{std::visit(*this, expr->left_)};
+  [[noreturn, gnu::noinline]] auto overflow(std::size_t const line) -> void {
+    // Only an error of the budget if the budget set the depth
+    if (context_.budget_.call_depth_) {
+      throw BudgetError{line, "Stack overflow."};
+    }
+    throw RuntimeError{line, "Stack overflow."};
+  }
 
-    if (expr->op_.type_ == TokenType::OR) {
-      if (is_truthy(left)) {
-        return left;
-      }
-    } else {
-      if (!is_truthy(left)) {
-        return left;
-      }
+  // Uses of globals are bound late, and fail only once they run
+  [[noreturn, gnu::noinline]] static auto undefined(Token const& name)
+      -> void {
+    throw RuntimeError{name.line_, name.lexeme_ + " is not defined"};
+  }
+
+  static auto limited(Budget const& budget) -> bool {
+    return budget.statements_ || budget.heap_bytes_ || budget.wall_time_;
+  }
+
+  [[gnu::noinline]] auto check(std::size_t const line) -> void {
+    Budget const& budget{context_.budget_};
+
+    std::uint64_t const executed{statements_ - checked_};
+    checked_ = statements_;
+    std::uint64_t const statements{
+        context_.statements_.fetch_add(executed, std::memory_order_relaxed) +
+        executed};
+    if (budget.statements_ && statements > *budget.statements_) {
+      throw BudgetError{line, "Exceeded the statement budget."};
     }
-    return std::visit(*this, expr->right_);
+
+    std::int64_t const grown{Memory::live_bytes() - heap_mark};
+    heap_mark += grown;
+    std::int64_t const heap_bytes{
+        context_.heap_bytes_.fetch_add(grown, std::memory_order_relaxed) +
+        grown};
+    if (budget.heap_bytes_ &&
+        heap_bytes > static_cast<std::int64_t>(*budget.heap_bytes_)) {
+      throw BudgetError{line, "Exceeded the heap budget."};
+    }
+
+    if (budget.wall_time_ && std::chrono::steady_clock::now() -
+                                     context_.started_ >
+                                 *budget.wall_time_) {
+      throw BudgetError{line, "Exceeded the time budget."};
+    }
+
+    // Exactly when the statements run out, if that is sooner
+    next_check_ = statements_ + (budget.statements_
+                                     ? std::min(CHECK_INTERVAL,
+                                                *budget.statements_ -
+                                                    statements + 1)
+                                     : CHECK_INTERVAL);
   }
 
-  [[nodiscard]] auto operator()(Box<SetExpression> const& expr) -> Object {
-    Object obj{std::visit(*this, expr->object_)};
+  Interpreter::Context& context_;
+  // Where the code on the stack finds its globals
+  std::shared_ptr<GlobalEnvironment> globals_;
+  // What the code running now sees: the scope it is in, none at the top
+  // level, and the variables its function captured
+  std::shared_ptr<Environment> environment_{};
+  LoxFunction::Upvalues const* upvalues_{nullptr};
+  // The generator whose body runs on the stack, if any
+  LoxGenerator* generator_{nullptr};
+  std::vector<Step> steps_{};
+  std::vector<Object> values_{};
+  // The frames of the calls of Lox functions in progress, of which there
+  // are frames_
+  std::vector<std::unique_ptr<Frame[]>> blocks_{};
+  std::size_t frames_{0};
+  Profiler::Stack shadow_;
+  std::size_t depth_;
+  std::size_t max_depth_;
+  std::uint64_t statements_;
+  // Statements already added to the count of the execution
+  std::uint64_t checked_;
+  std::uint64_t next_check_;
+};
+
+// Leaves the value of each kind of expression on the stack of values, or the
+// steps that will
+struct CallStack::ExpressionEvaluator {
+  CallStack& calls_;
 
-    if (auto const instance{std::get_if<std::shared_ptr<LoxInstance>>(&obj)}) {
-      Object const value{std::visit(*this, expr->value_)};
-      set(*instance, expr->name_, value);
+  auto operator()(std::monostate) -> void { calls_.push(std::monostate{}); }
+
+  auto operator()(LiteralExpression const& expr) -> void {
+    calls_.push(std::visit([](auto const& value) -> Object { return value; },
+                           expr.value_));
+  }
+
+  auto operator()(ThisExpression const& expr) -> void {
+    Object& value{calls_.variable(expr.keyword_)};
+    Memory::Site const site{Memory::Category::COPY, expr.keyword_.line_};
+    calls_.push(value);
+  }
+
+  auto operator()(VariableExpression const& expr) -> void {
+    Object& value{calls_.variable(expr.name_)};
+    Memory::Site const site{Memory::Category::COPY, expr.name_.line_};
+    calls_.push(value);
+  }
+
+  auto operator()(Box<AssignmentExpression> const& expr) -> void {
+    std::size_t const mark{calls_.steps_.size()};
+    calls_.evaluate(expr->value_);
+    calls_.then(mark, Then::Assign{&*expr});
+  }
+
+  auto operator()(Box<BinaryExpression> const& expr) -> void {
+    std::size_t const mark{calls_.steps_.size()};
+    if (!calls_.evaluated(expr->left_)) {
+      calls_.later(mark,
+                   {Then::Evaluate{&expr->right_}, Then::Binary{&*expr}});
+      return;
+    }
+    calls_.evaluate(expr->right_);
+    calls_.then(mark, Then::Binary{&*expr});
+  }
+
+  auto operator()(Box<CallExpression> const& expr) -> void {
+    auto const property{std::get_if<Box<GetExpression>>(&expr->callee_)};
+    auto const super{std::get_if<Box<SuperExpression>>(&expr->callee_)};
+    if (!property && !super) {
+      std::size_t const mark{calls_.steps_.size()};
+      if (!calls_.evaluated(expr->callee_)) {
+        calls_.later(mark, {Then::Values{&expr->arguments_, 0},
+                            Then::Invoke{&*expr}});
+        return;
+      }
+      calls_.arguments(*expr, Then::Invoke{&*expr});
+      return;
+    }
+
+    // Methods called on the spot run without being bound first
+    if (calls_.context_.counters_) [[unlikely]] {
+      calls_.context_.counters_->executed(expr->callee_);
+    }
+    if (property) {
+      std::size_t const mark{calls_.steps_.size()};
+      calls_.evaluate((*property)->object_);
+      calls_.then(mark, Then::Method{&*expr});
+      return;
+    }
+
+    LoxFunction const& method{calls_.super_method(**super)};
+    std::shared_ptr<LoxInstance> const& instance{calls_.super_this(**super)};
+    if (method.declaration_->generator_) {
+      Memory::Site const site{Memory::Category::COPY,
+                              (*super)->method_.line_};
+      calls_.push(LoxFunction{method.declaration_, method.upvalues_,
+                              method.globals_, instance});
+      calls_.arguments(*expr, Then::Invoke{&*expr});
+      return;
+    }
+    calls_.push(instance);
+    calls_.arguments(*expr, Then::InvokeMethod{&*expr, &method});
+  }
 
-      return value;
+  auto operator()(Box<SpawnExpression> const& expr) -> void {
+    auto const& call{std::get<Box<CallExpression>>(expr->call_)};
+    std::size_t const mark{calls_.steps_.size()};
+    if (!calls_.evaluated(call->callee_)) {
+      calls_.later(mark, {Then::Values{&call->arguments_, 0},
+                          Then::Spawn{&*expr}});
+      return;
     }
+    calls_.arguments(*call, Then::Spawn{&*expr});
+  }
 
-    throw RuntimeError{expr->name_.line_, "Only instances have properties."};
+  auto operator()(Box<GetExpression> const& expr) -> void {
+    std::size_t const mark{calls_.steps_.size()};
+    calls_.evaluate(expr->object_);
+    calls_.then(mark, Then::Get{&*expr});
   }
-  [[nodiscard]] auto operator()(Box<UnaryExpression> const& expr) -> Object {
-    Object const right{std::visit(*this, expr->right_)};
 
-    Token const& op{expr->op_};
-    TokenType const& op_type{op.type_};
+  auto operator()(Box<ListExpression> const& expr) -> void {
+    std::size_t const mark{calls_.steps_.size()};
+    calls_.evaluate(expr->elements_, 0);
+    calls_.then(mark, Then::List{&*expr});
+  }
 
-    if (op_type == TokenType::MINUS) {
-      check_number_operand(op, right);
-      return -std::get<double>(right);
+  auto operator()(Box<IndexExpression> const& expr) -> void {
+    std::size_t const mark{calls_.steps_.size()};
+    if (!calls_.evaluated(expr->object_)) {
+      calls_.later(mark, {Then::Evaluate{&expr->index_}, Then::Index{&*expr}});
+      return;
     }
+    calls_.evaluate(expr->index_);
+    calls_.then(mark, Then::Index{&*expr});
+  }
 
-    if (op_type == TokenType::BANG) {
-      return !is_truthy(right);
+  auto operator()(Box<IndexSetExpression> const& expr) -> void {
+    std::size_t const mark{calls_.steps_.size()};
+    if (!calls_.evaluated(expr->object_)) {
+      calls_.later(mark,
+                   {Then::Evaluate{&expr->index_},
+                    Then::Evaluate{&expr->value_}, Then::IndexSet{&*expr}});
+      return;
+    }
+    if (!calls_.evaluated(expr->index_)) {
+      calls_.later(mark,
+                   {Then::Evaluate{&expr->value_}, Then::IndexSet{&*expr}});
+      return;
     }
+    calls_.evaluate(expr->value_);
+    calls_.then(mark, Then::IndexSet{&*expr});
+  }
+
+  auto operator()(Box<GroupingExpression> const& expr) -> void {
+    calls_.evaluate(expr->expression_);
+  }
 
-    return std::monostate{};
+  auto operator()(Box<LogicalExpression> const& expr) -> void {
+    std::size_t const mark{calls_.steps_.size()};
+    calls_.evaluate(expr->left_);
+    calls_.then(mark, Then::Logical{&expr});
+  }
+
+  auto operator()(Box<SetExpression> const& expr) -> void {
+    std::size_t const mark{calls_.steps_.size()};
+    calls_.evaluate(expr->object_);
+    calls_.then(mark, Then::SetOn{&*expr});
+  }
+
+  auto operator()(Box<UnaryExpression> const& expr) -> void {
+    std::size_t const mark{calls_.steps_.size()};
+    calls_.evaluate(expr->right_);
+    calls_.then(mark, Then::Unary{&*expr});
+  }
+
+  auto operator()(Box<SuperExpression> const& expr) -> void {
+    LoxFunction const& method{calls_.super_method(*expr)};
+    std::shared_ptr<LoxInstance> const& instance{calls_.super_this(*expr)};
+    Memory::Site const site{Memory::Category::COPY, expr->method_.line_};
+    calls_.push(LoxFunction{method.declaration_, method.upvalues_,
+                            method.globals_, instance});
   }
 };
 
-struct StatementExecutor {
-  std::shared_ptr<Environment> environment_;
-  std::unordered_map<Token, std::size_t> const& resolution_;
+// Executes each kind of statement, or leaves the steps that will
+struct CallStack::StatementExecutor {
+  CallStack& calls_;
 
   auto operator()(std::monostate) -> void {}
 
   auto operator()(ExpressionStatement const& stmt) -> void {
-    static_cast<void>(std::visit(ExpressionEvaluator{environment_, resolution_},
-                                 stmt.expression_));
+    std::size_t const mark{calls_.steps_.size()};
+    calls_.evaluate(stmt.expression_);
+    calls_.then(mark, Then::Discard{});
   }
 
   auto operator()(PrintStatement const& stmt) -> void {
-    Object const value{std::visit(
-        ExpressionEvaluator{environment_, resolution_}, stmt.expression_)};
-    std::visit(Put{std::cout}, value);
+    std::size_t const mark{calls_.steps_.size()};
+    calls_.evaluate(stmt.expression_);
+    calls_.then(mark, Then::Print{});
   }
 
+  // Always a step, for what encloses the statement to stop there
   auto operator()(ReturnStatement const& stmt) -> void {
-    Object const value{std::visit(
-        ExpressionEvaluator{environment_, resolution_}, stmt.value_)};
+    std::size_t const mark{calls_.steps_.size()};
+    calls_.evaluate(stmt.value_);
+    calls_.later(mark, {Then::Return{}});
+  }
 
-    throw Return{value};
+  auto operator()(YieldStatement const& stmt) -> void {
+    std::size_t const mark{calls_.steps_.size()};
+    calls_.evaluate(stmt.value_);
+    calls_.then(mark, Then::Yield{});
   }
 
   auto operator()(VariableStatement const& stmt) -> void {
-    Object const value{std::visit(
-        ExpressionEvaluator{environment_, resolution_}, stmt.initializer_)};
-
-    environment_->define(stmt.name_.lexeme_, value);
+    std::size_t const mark{calls_.steps_.size()};
+    calls_.evaluate(stmt.initializer_);
+    calls_.then(mark, Then::Define{&stmt});
   }
 
   auto operator()(Box<BlockStatement> const& stmt) -> void {
     // Create new environment with the current environment as its
     // enclosing environment
-    auto const env{std::make_shared<Environment>(environment_)};
+    calls_.environment_ = [&]() {
+      Memory::Site const site{Memory::Category::ENVIRONMENT, calls_.line()};
+      return make_environment(calls_.environment_);
+    }();
 
     // Execute statements in the block with the new environment
-    for (Statement const& statement : stmt->statements_) {
-      std::visit(StatementExecutor{env, resolution_}, statement);
-    }
+    std::size_t const mark{calls_.steps_.size()};
+    calls_.execute(stmt->statements_, 0);
+    calls_.then(mark, Then::Close{});
   }
 
   auto operator()(Box<FunctionStatement> const& stmt) -> void {
-    environment_->define(stmt->name_.lexeme_, LoxFunction{*stmt, environment_});
+    Memory::Site const site{Memory::Category::FUNCTION, stmt->name_.line_};
+    // Defined first, for the function to capture itself
+    calls_.define(stmt->name_, std::monostate{});
+    calls_.define(stmt->name_, calls_.closure(stmt, calls_.environment_));
   }
 
   auto operator()(Box<ClassStatement> const& stmt) -> void {
-    environment_->define(stmt->name_.lexeme_, std::monostate{});
+    if (std::holds_alternative<std::monostate>(stmt->superclass_)) {
+      calls_.declare(*stmt, nullptr);
+      return;
+    }
+    std::size_t const mark{calls_.steps_.size()};
+    calls_.evaluate(stmt->superclass_);
+    calls_.then(mark, Then::Inherit{&*stmt});
+  }
+
+  auto operator()(Box<IfStatement> const& stmt) -> void {
+    std::size_t const mark{calls_.steps_.size()};
+    calls_.evaluate(stmt->condition_);
+    calls_.then(mark, Then::Branch{&stmt});
+  }
 
-    std::unordered_map<std::string, LoxFunction> class_methods;
-    for (Box<FunctionStatement> const& method : stmt->methods_) {
-      class_methods[method->name_.lexeme_] = LoxFunction{*method, environment_};
+  auto operator()(Box<WhileStatement> const& stmt) -> void {
+    std::size_t const mark{calls_.steps_.size()};
+    calls_.evaluate(stmt->condition_);
+    calls_.then(mark, Then::Loop{&stmt});
+  }
+};
+
+// Does each kind of step
+struct CallStack::Continuation {
+  CallStack& calls_;
+
+  auto operator()(Then::Evaluate const& step) -> void {
+    calls_.evaluate(*step.expr_);
+  }
+
+  auto operator()(Then::Values const& step) -> void {
+    calls_.evaluate(*step.exprs_, step.next_);
+  }
+
+  auto operator()(Then::Execute const& step) -> void {
+    calls_.execute(*step.statements_, step.next_);
+  }
+
+  auto operator()(Then::Close) -> void {
+    calls_.environment_ = calls_.environment_->enclosing();
+  }
+
+  auto operator()(Then::Leave) -> void {
+    calls_.push(std::monostate{});
+    calls_.finish();
+  }
+
+  auto operator()(Then::Discard) -> void { calls_.values_.pop_back(); }
+
+  auto operator()(Then::Print) -> void {
+    Interpreter::Context& context{calls_.context_};
+    // Lines printed by different tasks must not interleave
+    std::unique_lock lock{context.out_mutex_, std::defer_lock};
+    if (context.scheduler_) {
+      lock.lock();
     }
+    std::visit(Put{context.out_}, calls_.values_.back());
+    context.out_.write('\n');
+    calls_.values_.pop_back();
+  }
+
+  auto operator()(Then::Return) -> void { calls_.finish(); }
 
-    environment_->assign(stmt->name_.lexeme_,
-                         LoxClass{stmt->name_.lexeme_, class_methods});
+  auto operator()(Then::Yield) -> void {
+    Object value{calls_.pop()};
+
+    CallStack::Suspension const suspension{calls_};
+    calls_.generator_->yield(std::move(value));
   }
 
-  auto operator()(Box<IfStatement> const& stmt) -> void {
-    if (is_truthy(std::visit(ExpressionEvaluator{environment_, resolution_},
-                             stmt->condition_))) {
-      std::visit(*this, stmt->then_branch_);
+  auto operator()(Then::Define const& step) -> void {
+    Memory::Site const site{Memory::Category::ENVIRONMENT,
+                            step.stmt_->name_.line_};
+    calls_.define(step.stmt_->name_, calls_.values_.back());
+    calls_.values_.pop_back();
+  }
+
+  auto operator()(Then::Inherit const& step) -> void {
+    Object superclass{calls_.pop()};
+    calls_.declare(*step.stmt_, &superclass);
+  }
+
+  auto operator()(Then::Branch const& step) -> void {
+    Box<IfStatement> const& stmt{*step.stmt_};
+    bool const condition{is_truthy(calls_.values_.back())};
+    calls_.values_.pop_back();
+    if (calls_.branch(stmt, condition)) {
+      calls_.execute(stmt->then_branch_);
     } else {
-      std::visit(*this, stmt->else_branch_);
+      calls_.execute(stmt->else_branch_);
     }
   }
 
-  auto operator()(Box<WhileStatement> const& stmt) -> void {
-    while (is_truthy(std::visit(ExpressionEvaluator{environment_, resolution_},
-                                stmt->condition_))) {
-      std::visit(*this, stmt->body_);
+  auto operator()(Then::Loop const& step) -> void {
+    Box<WhileStatement> const& stmt{*step.stmt_};
+    bool condition{is_truthy(calls_.values_.back())};
+    calls_.values_.pop_back();
+    // Goes round right away for as long as nothing in the loop leaves steps
+    while (calls_.branch(stmt, condition)) {
+      std::size_t const mark{calls_.steps_.size()};
+      calls_.execute(stmt->body_);
+      if (calls_.steps_.size() != mark) {
+        calls_.later(mark, {Then::Repeat{step.stmt_}});
+        return;
+      }
+      calls_.checkpoint(stmt->keyword_.line_);
+      if (!calls_.evaluated(stmt->condition_)) {
+        calls_.later(mark, {Then::Loop{step.stmt_}});
+        return;
+      }
+      condition = is_truthy(calls_.values_.back());
+      calls_.values_.pop_back();
     }
   }
+
+  auto operator()(Then::Repeat const& step) -> void {
+    Box<WhileStatement> const& stmt{*step.stmt_};
+    calls_.checkpoint(stmt->keyword_.line_);
+    std::size_t const mark{calls_.steps_.size()};
+    calls_.evaluate(stmt->condition_);
+    calls_.then(mark, Then::Loop{step.stmt_});
+  }
+
+  auto operator()(Then::Assign const& step) -> void {
+    Token const& name{step.expr_->name_};
+    Object& variable{calls_.variable(name)};
+    Memory::Site const site{Memory::Category::COPY, name.line_};
+    variable = calls_.values_.back();
+  }
+
+  auto operator()(Then::Binary const& step) -> void {
+    std::vector<Object>& values{calls_.values_};
+    Object result{
+        binary(step.expr_->op_, values[values.size() - 2], values.back())};
+    values.pop_back();
+    values.back() = std::move(result);
+  }
+
+  auto operator()(Then::Unary const& step) -> void {
+    Object result{unary(step.expr_->op_, calls_.values_.back())};
+    calls_.values_.back() = std::move(result);
+  }
+
+  auto operator()(Then::Logical const& step) -> void {
+    Box<LogicalExpression> const& expr{*step.expr_};
+    Object const& left{calls_.values_.back()};
+
+    bool const decided{expr->op_.type_ == TokenType::OR ? is_truthy(left)
+                                                        : !is_truthy(left)};
+    if (!calls_.branch(expr, decided)) {
+      calls_.values_.pop_back();
+      calls_.evaluate(expr->right_);
+    }
+  }
+
+  auto operator()(Then::Get const& step) -> void {
+    GetExpression const& expr{*step.expr_};
+    Object& obj{calls_.values_.back()};
+
+    if (auto const instance{std::get_if<std::shared_ptr<LoxInstance>>(&obj)}) {
+      Memory::Site const site{Memory::Category::COPY, expr.name_.line_};
+      obj = get(*instance, expr.name_);
+      return;
+    }
+
+    throw RuntimeError{expr.name_.line_, "Only instances have properties."};
+  }
+
+  auto operator()(Then::SetOn const& step) -> void {
+    SetExpression const& expr{*step.expr_};
+    if (!std::holds_alternative<std::shared_ptr<LoxInstance>>(
+            calls_.values_.back())) {
+      throw RuntimeError{expr.name_.line_, "Only instances have properties."};
+    }
+    std::size_t const mark{calls_.steps_.size()};
+    calls_.evaluate(expr.value_);
+    calls_.then(mark, Then::Set{&expr});
+  }
+
+  auto operator()(Then::Set const& step) -> void {
+    SetExpression const& expr{*step.expr_};
+    Object value{calls_.pop()};
+    Object& obj{calls_.values_.back()};
+
+    Memory::Site const site{Memory::Category::INSTANCE, expr.name_.line_};
+    set(std::get<std::shared_ptr<LoxInstance>>(obj), expr.name_, value);
+    obj = std::move(value);
+  }
+
+  auto operator()(Then::Index const& step) -> void {
+    IndexExpression const& expr{*step.expr_};
+    Object const index{calls_.pop()};
+    Object& obj{calls_.values_.back()};
+
+    Memory::Site const site{Memory::Category::COPY, expr.bracket_.line_};
+    if (auto const list{std::get_if<std::shared_ptr<LoxList>>(&obj)}) {
+      Object element{
+          (*list)->elements_[list_index(**list, index, expr.bracket_)]};
+      obj = std::move(element);
+      return;
+    }
+    if (auto const map{std::get_if<std::shared_ptr<LoxMap>>(&obj)}) {
+      if (Object const* const value{(*map)->find(index)}) {
+        Object element{*value};
+        obj = std::move(element);
+        return;
+      }
+      throw RuntimeError{expr.bracket_.line_, "Undefined key."};
+    }
+
+    throw RuntimeError{expr.bracket_.line_,
+                       "Only lists and maps can be indexed."};
+  }
+
+  auto operator()(Then::IndexSet const& step) -> void {
+    IndexSetExpression const& expr{*step.expr_};
+    Object value{calls_.pop()};
+    Object const index{calls_.pop()};
+    Object& obj{calls_.values_.back()};
+
+    Memory::Site const site{Memory::Category::COLLECTION,
+                            expr.bracket_.line_};
+    if (auto const list{std::get_if<std::shared_ptr<LoxList>>(&obj)}) {
+      (*list)->elements_[list_index(**list, index, expr.bracket_)] = value;
+      obj = std::move(value);
+      return;
+    }
+    if (auto const map{std::get_if<std::shared_ptr<LoxMap>>(&obj)}) {
+      (*map)->insert_or_assign(index, value);
+      obj = std::move(value);
+      return;
+    }
+
+    throw RuntimeError{expr.bracket_.line_,
+                       "Only lists and maps can be indexed."};
+  }
+
+  auto operator()(Then::List const& step) -> void {
+    ListExpression const& expr{*step.expr_};
+    std::vector<Object>& values{calls_.values_};
+    std::size_t const first{values.size() - expr.elements_.size()};
+
+    auto const list{[&]() {
+      Memory::Site const site{Memory::Category::COLLECTION,
+                              expr.bracket_.line_};
+      auto list{std::make_shared<LoxList>()};
+      list->elements_.reserve(expr.elements_.size());
+      return list;
+    }()};
+    std::move(values.begin() + static_cast<std::ptrdiff_t>(first),
+              values.end(), std::back_inserter(list->elements_));
+    calls_.drop(first);
+    calls_.push(list);
+  }
+
+  auto operator()(Then::Invoke const& step) -> void {
+    CallExpression const& expr{*step.expr_};
+    std::size_t const count{expr.arguments_.size()};
+    check_arity(calls_.values_[calls_.values_.size() - count - 1], count,
+                expr.paren_);
+    calls_.invoke(count, expr.paren_.line_);
+  }
+
+  auto operator()(Then::Method const& step) -> void {
+    CallExpression const& expr{*step.expr_};
+    GetExpression const& property{
+        *std::get<Box<GetExpression>>(expr.callee_)};
+    Object& obj{calls_.values_.back()};
+
+    auto const instance{std::get_if<std::shared_ptr<LoxInstance>>(&obj)};
+    if (!instance) {
+      throw RuntimeError{property.name_.line_,
+                         "Only instances have properties."};
+    }
+    LoxFunction const* const method{
+        find_method(**instance, property.name_.lexeme_)};
+    if (!method || method->declaration_->generator_) {
+      Memory::Site const site{Memory::Category::COPY, property.name_.line_};
+      obj = get(*instance, property.name_);
+      calls_.arguments(expr, Then::Invoke{&expr});
+      return;
+    }
+    calls_.arguments(expr, Then::InvokeMethod{&expr, method});
+  }
+
+  auto operator()(Then::InvokeMethod const& step) -> void {
+    CallExpression const& expr{*step.expr_};
+    LoxFunction const& method{*step.method_};
+    std::size_t const count{expr.arguments_.size()};
+    check_count(method.declaration_->params_.size(), count, expr.paren_);
+
+    std::size_t const arguments{calls_.values_.size() - count};
+    calls_.start(
+        method,
+        std::get<std::shared_ptr<LoxInstance>>(calls_.values_[arguments - 1]),
+        arguments, expr.paren_.line_,
+        std::string_view{method.declaration_->name_.lexeme_});
+  }
+
+  auto operator()(Then::Spawn const& step) -> void {
+    auto const& call{std::get<Box<CallExpression>>(step.expr_->call_)};
+    std::vector<Object>& values{calls_.values_};
+    std::size_t const count{call->arguments_.size()};
+    std::size_t const callee{values.size() - count - 1};
+    check_arity(values[callee], count, call->paren_);
+
+    // The task gets a copy of everything the call reaches, so that it shares
+    // nothing mutable with this one
+    std::vector<Object> args{
+        std::make_move_iterator(values.begin() +
+                                static_cast<std::ptrdiff_t>(callee)),
+        std::make_move_iterator(values.end())};
+    calls_.drop(callee);
+    args = Tasks::transfer(args);
+    Object task_callee{std::move(args.front())};
+    args.erase(args.begin());
+
+    Interpreter::Context& context{calls_.context_};
+    if (!context.scheduler_) {
+      context.scheduler_ = std::make_unique<Tasks::Scheduler>();
+    }
+    auto const task{std::make_shared<LoxTask>()};
+    context.scheduler_->spawn(
+        [task, callee = std::move(task_callee), args = std::move(args),
+         &context, line = call->paren_.line_]() mutable {
+          try {
+            auto const func{std::get_if<Box<LoxFunction>>(&callee)};
+            CallStack calls{context, "<task>",
+                            func ? (*func)->globals_ : nullptr};
+            Object const result{
+                calls.call(std::move(callee), std::move(args), line)};
+            task->finish(Tasks::transfer(result));
+          } catch (RuntimeError const& e) {
+            task->fail(std::current_exception());
+          } catch (NativeError const& e) {
+            task->fail(std::make_exception_ptr(RuntimeError{line, e.message_}));
+          }
+        });
+    calls_.push(task);
+  }
 };
+
+// Calls what returns before the stack goes on, with the arguments from the
+// index on
+struct CallStack::Call {
+  [[nodiscard]] auto operator()(Box<LoxFunction> const& func) -> Object {
+    return calls_.generator(
+        func, calls_.scope(*func, func->this_, arguments_, line_));
+  }
+
+  [[nodiscard]] auto operator()(Box<LoxClass> const& klass) -> Object {
+    Memory::Site const site{Memory::Category::INSTANCE, line_};
+    return std::make_shared<LoxInstance>(LoxInstance{*klass, {}});
+  }
+
+  [[nodiscard]] auto operator()(std::shared_ptr<NativeFunction> const& func)
+      -> Object {
+    std::vector<Object>& values{calls_.values_};
+    std::vector<Object> args{};
+    {
+      Memory::Site const site{Memory::Category::ARGUMENTS, line_};
+      args.reserve(values.size() - arguments_);
+    }
+    std::move(values.begin() + static_cast<std::ptrdiff_t>(arguments_),
+              values.end(), std::back_inserter(args));
+    try {
+      return func->function_(func->state_.get(), args);
+    } catch (NativeError const& e) {
+      throw RuntimeError{line_, e.message_};
+    }
+  }
+
+  template <typename T>
+  [[nodiscard]] auto operator()(T const& t) -> Object {
+    throw UncallableError{};
+  }
+
+  CallStack& calls_;
+  std::size_t arguments_;
+  // Of the call
+  std::size_t line_;
+};
+
+auto CallStack::evaluate(Expression const& expr) -> void {
+  if (context_.counters_) [[unlikely]] {
+    context_.counters_->executed(expr);
+  }
+  std::visit(ExpressionEvaluator{*this}, expr);
+}
+
+auto CallStack::execute(Statement const& stmt) -> void {
+  count();
+  if (context_.counters_) [[unlikely]] {
+    context_.counters_->executed(stmt);
+  }
+  std::visit(StatementExecutor{*this}, stmt);
+}
+
+auto CallStack::evaluate(std::vector<Expression> const& exprs,
+                         std::size_t const from) -> void {
+  for (std::size_t i{from}; i < exprs.size(); ++i) {
+    std::size_t const mark{steps_.size()};
+    evaluate(exprs[i]);
+    if (steps_.size() != mark) {
+      if (i + 1 < exprs.size()) {
+        later(mark, {Then::Values{&exprs, i + 1}});
+      }
+      return;
+    }
+  }
+}
+
+auto CallStack::execute(std::vector<Statement> const& statements,
+                        std::size_t const from) -> void {
+  for (std::size_t i{from}; i < statements.size(); ++i) {
+    std::size_t const mark{steps_.size()};
+    execute(statements[i]);
+    if (steps_.size() != mark) {
+      if (i + 1 < statements.size()) {
+        later(mark, {Then::Execute{&statements, i + 1}});
+      }
+      return;
+    }
+  }
+}
+
+template <typename T>
+auto CallStack::then(std::size_t const mark, T const step) -> void {
+  if (steps_.size() == mark) {
+    Continuation{*this}(step);
+    return;
+  }
+  later(mark, {step});
+}
+
+auto CallStack::resume() -> void {
+  try {
+    while (!steps_.empty()) {
+      Step const step{steps_.back()};
+      steps_.pop_back();
+      std::visit(Continuation{*this}, step);
+    }
+  } catch (...) {
+    // The calls in progress end here, as far as the profiler and the trace
+    // can tell. What they hold goes with the stack.
+    while (frames_ > 0) {
+      leave(innermost());
+      --frames_;
+    }
+    throw;
+  }
+}
+
+auto CallStack::invoke(std::size_t const count, std::size_t const line)
+    -> void {
+  std::size_t const callee{values_.size() - count - 1};
+  if (auto const func{std::get_if<Box<LoxFunction>>(&values_[callee])};
+      func && !(*func)->declaration_->generator_) {
+    start(**func, (*func)->this_, callee + 1, line,
+          Profiler::name(values_[callee]));
+    return;
+  }
+
+  Object result{};
+  {
+    Immediate const immediate{*this, line, Profiler::name(values_[callee])};
+    result = std::visit(Call{*this, callee + 1, line}, values_[callee]);
+  }
+  drop(callee);
+  push(std::move(result));
+}
+
+auto CallStack::run(std::vector<Statement> const& statements,
+                    std::shared_ptr<Environment> env,
+                    LoxFunction::Upvalues const* const upvalues,
+                    LoxGenerator* const generator) -> void {
+  environment_ = std::move(env);
+  upvalues_ = upvalues;
+  generator_ = generator;
+  if (!statements.empty()) {
+    then(Then::Execute{&statements, 0});
+  }
+  resume();
+}
+
+auto CallStack::call(Object callee, std::vector<Object> args,
+                     std::size_t const line) -> Object {
+  std::size_t const count{args.size()};
+  push(std::move(callee));
+  for (Object& arg : args) {
+    push(std::move(arg));
+  }
+  invoke(count, line);
+  resume();
+  return pop();
+}
 }  // namespace
 
+auto Interpreter::global_environment()
+    -> std::shared_ptr<GlobalEnvironment> {
+  // The builtins are globals like any other, so that they have slots of their
+  // own, and scripts redefine them rather than shadow them.
+  auto const env{std::make_shared<GlobalEnvironment>()};
+  for (auto const& [name, value] : builtins()) {
+    env->define(name, value);
+  }
+  return env;
+}
+
+auto Interpreter::interpret(std::vector<Statement> const& statements,
+                            Context& context,
+                            std::shared_ptr<GlobalEnvironment> const& globals)
+    -> void {
+  // Allocations before the execution don't count against its budget
+  heap_mark = Memory::live_bytes();
+  CallStack calls{context, "<script>", globals};
+  calls.run(statements, nullptr);
+}
+
 auto Interpreter::interpret(
     std::vector<Statement> const& statements,
     std::unordered_map<Token, std::size_t> const& resolution,
-    std::shared_ptr<Environment> const& environment) -> void {
-  for (auto const& stmt : statements) {
-    std::visit(StatementExecutor{environment, resolution}, stmt);
-  }
+    Output::Sink& out) -> void {
+  Context context{resolution, out};
+  interpret(statements, context, global_environment());
 }
 
 auto Interpreter::interpret(
     std::vector<Statement> const& statements,
     std::unordered_map<Token, std::size_t> const& resolution) -> void {
-  auto const env{std::make_shared<Environment>()};
-  interpret(statements, resolution, env);
+  Output::StdoutSink out{};
+  interpret(statements, resolution, out);
 }
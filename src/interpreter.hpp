@@ -1,22 +1,73 @@
 #ifndef LOX_INTERPRETER
 #define LOX_INTERPRETER
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
+#include "./budget.hpp"
+#include "./counters.hpp"
 #include "./environment.hpp"
+#include "./output.hpp"
+#include "./tasks/scheduler.hpp"
+#include "./types/class.hpp"
+#include "./types/function.hpp"
 #include "./types/object.hpp"
 #include "./types/statement.hpp"
 #include "./types/token.hpp"
 
 namespace Interpreter {
+/**
+ * What a running program needs besides its environment.
+ */
+struct Context {
+  std::unordered_map<Token, std::size_t> const& resolution_;
+  Output::Sink& out_;
+  Budget budget_{};
+  // What the execution has used so far, over all of its tasks. Tasks add to
+  // the counts as they check the budget.
+  std::chrono::steady_clock::time_point started_{
+      std::chrono::steady_clock::now()};
+  std::atomic<std::uint64_t> statements_{0};
+  std::atomic<std::int64_t> heap_bytes_{0};
+  // Held while printing once there are tasks, which share the sink
+  std::mutex out_mutex_{};
+  // Expires with the context. Generators check it before resuming, as their
+  // bodies refer to the context.
+  std::shared_ptr<bool> alive_{std::make_shared<bool>(true)};
+  // What owns the statements, if anything does. Functions declared by them
+  // share it rather than copy their declarations.
+  std::shared_ptr<void const> program_{};
+  // Where to count the nodes executed, if anywhere
+  Counters::Profile* counters_{nullptr};
+  // Created by the first spawn. Declared last so that it is destroyed first,
+  // waiting for the tasks that still use the rest of the context.
+  std::unique_ptr<Tasks::Scheduler> scheduler_{};
+};
 
+/**
+ * A fresh environment for the globals of a program, holding the builtins.
+ */
+auto global_environment() -> std::shared_ptr<GlobalEnvironment>;
+
+auto interpret(std::vector<Statement> const& statements, Context& context,
+               std::shared_ptr<GlobalEnvironment> const& globals) -> void;
+
+/**
+ * Runs a program, printing to the given sink. The sink is not flushed.
+ */
 auto interpret(std::vector<Statement> const& statements,
                std::unordered_map<Token, std::size_t> const& resolution,
-               std::shared_ptr<Environment> const& env) -> void;
+               Output::Sink& out) -> void;
 
+/**
+ * Runs a program, printing to standard output.
+ */
 auto interpret(std::vector<Statement> const& statements,
                std::unordered_map<Token, std::size_t> const& resolution)
     -> void;
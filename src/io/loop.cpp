@@ -0,0 +1,687 @@
+#include "./loop.hpp"
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define LOX_IO_URING
+#endif
+
+namespace Io {
+namespace {
+constexpr std::size_t CHUNK_SIZE{std::size_t{64} << 10};
+// Larger transfers are split, as a single read or write can't be larger
+constexpr std::size_t MAX_TRANSFER{std::size_t{1} << 30};
+
+auto describe(int const error) -> std::string {
+  return std::generic_category().message(error);
+}
+}  // namespace
+
+// A read or write to perform once the file is ready for it
+struct Request {
+  int fd_;
+  // Where in the file, or -1 for the current position of a stream
+  std::int64_t offset_;
+  char* data_;
+  std::size_t size_;
+  bool write_;
+  // Called with the number of bytes transferred, or a negated errno
+  std::function<void(long)> done_;
+};
+
+/**
+ * Performs requests. Only the thread of the loop uses a backend, except for
+ * waking it.
+ */
+class Backend {
+ public:
+  // The waker blocks, as io_uring fails reads of non-blocking descriptors
+  // instead of waiting for them. Reads only follow a wake anyway.
+  Backend() : waker_{eventfd(0, EFD_CLOEXEC)} {
+    if (waker_ < 0) {
+      throw std::system_error{errno, std::generic_category(), "eventfd"};
+    }
+  }
+
+  Backend(Backend const&) = delete;
+  auto operator=(Backend const&) -> Backend& = delete;
+
+  virtual ~Backend() { close(waker_); }
+
+  [[nodiscard]] virtual auto kind() const -> Loop::Kind = 0;
+
+  // Flags to open the files the backend is to transfer with
+  [[nodiscard]] virtual auto open_flags() const -> int = 0;
+
+  virtual auto submit(std::unique_ptr<Request> request) -> void = 0;
+
+  /**
+   * Waits until some requests complete, the backend is woken or the deadline
+   * passes, then calls back the requests that completed.
+   */
+  virtual auto wait(
+      std::optional<std::chrono::steady_clock::time_point> deadline)
+      -> void = 0;
+
+  // Makes a wait in progress, or the next one, return. Any thread may wake.
+  auto wake() -> void {
+    std::uint64_t const one{1};
+    static_cast<void>(write(waker_, &one, sizeof(one)));
+  }
+
+ protected:
+  int waker_;
+};
+
+namespace {
+auto perform(Request const& request) -> long {
+  ssize_t result{0};
+  if (request.write_) {
+    result = request.offset_ < 0
+                 ? write(request.fd_, request.data_, request.size_)
+                 : pwrite(request.fd_, request.data_, request.size_,
+                          request.offset_);
+  } else {
+    result = request.offset_ < 0
+                 ? read(request.fd_, request.data_, request.size_)
+                 : pread(request.fd_, request.data_, request.size_,
+                         request.offset_);
+  }
+  return result < 0 ? -errno : result;
+}
+
+class EpollBackend final : public Backend {
+ public:
+  EpollBackend() : epoll_{epoll_create1(EPOLL_CLOEXEC)} {
+    if (epoll_ < 0) {
+      throw std::system_error{errno, std::generic_category(), "epoll_create1"};
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = waker_;
+    epoll_ctl(epoll_, EPOLL_CTL_ADD, waker_, &event);
+  }
+
+  ~EpollBackend() override { close(epoll_); }
+
+  [[nodiscard]] auto kind() const -> Loop::Kind override {
+    return Loop::Kind::EPOLL;
+  }
+
+  // Transfers on a descriptor that has been polled ready must not block
+  [[nodiscard]] auto open_flags() const -> int override { return O_NONBLOCK; }
+
+  auto submit(std::unique_ptr<Request> request) -> void override {
+    int const fd{request->fd_};
+    std::deque<std::unique_ptr<Request>>& waiting{waiting_[fd]};
+    waiting.push_back(std::move(request));
+    if (waiting.size() == 1 && !arm(fd, *waiting.front())) {
+      // Regular files can't be polled, and are always ready
+      ready_.push_back(std::move(waiting.front()));
+      waiting_.erase(fd);
+    }
+  }
+
+  auto wait(std::optional<std::chrono::steady_clock::time_point> deadline)
+      -> void override {
+    int timeout{-1};
+    if (!ready_.empty()) {
+      timeout = 0;
+    } else if (deadline) {
+      auto const left{std::chrono::ceil<std::chrono::milliseconds>(
+          *deadline - std::chrono::steady_clock::now())};
+      timeout = static_cast<int>(
+          std::clamp<std::chrono::milliseconds::rep>(left.count(), 0, 1 << 30));
+    }
+
+    std::array<epoll_event, 64> events{};
+    int const count{epoll_wait(epoll_, events.data(),
+                               static_cast<int>(events.size()), timeout)};
+    for (int i = 0; i < count; ++i) {
+      int const fd{events[i].data.fd};
+      if (fd == waker_) {
+        std::uint64_t value{0};
+        static_cast<void>(read(waker_, &value, sizeof(value)));
+      } else {
+        ready(fd);
+      }
+    }
+
+    std::deque<std::unique_ptr<Request>> ready{};
+    ready.swap(ready_);
+    for (std::unique_ptr<Request>& request : ready) {
+      long const result{perform(*request)};
+      request->done_(result);
+    }
+  }
+
+ private:
+  // Asks for one notification once the descriptor is ready for the request
+  auto arm(int const fd, Request const& request) -> bool {
+    epoll_event event{};
+    event.events = (request.write_ ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT;
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &event) == 0) {
+      return true;
+    }
+    return errno == EEXIST && epoll_ctl(epoll_, EPOLL_CTL_MOD, fd, &event) == 0;
+  }
+
+  auto ready(int const fd) -> void {
+    auto const found{waiting_.find(fd)};
+    if (found == waiting_.end()) {
+      return;
+    }
+    std::deque<std::unique_ptr<Request>>& waiting{found->second};
+    std::unique_ptr<Request> request{std::move(waiting.front())};
+    long const result{perform(*request)};
+    if (result == -EAGAIN) {
+      waiting.front() = std::move(request);
+      arm(fd, *waiting.front());
+      return;
+    }
+    waiting.pop_front();
+    if (waiting.empty()) {
+      waiting_.erase(found);
+    } else {
+      arm(fd, *waiting.front());
+    }
+    // Last, as the callback may well submit to the same descriptor
+    request->done_(result);
+  }
+
+  int epoll_;
+  // Requests in the order they were submitted, by descriptor. Only the first
+  // one of each descriptor is polled for.
+  std::unordered_map<int, std::deque<std::unique_ptr<Request>>> waiting_;
+  std::deque<std::unique_ptr<Request>> ready_;
+};
+
+#ifdef LOX_IO_URING
+/**
+ * Submits requests to the kernel through the rings io_uring shares with the
+ * process, so that many are in flight at once and a single system call both
+ * submits and waits. Regular files are read and written asynchronously too.
+ */
+class UringBackend final : public Backend {
+ public:
+  // Nothing if the kernel lacks io_uring, or forbids it
+  static auto create() -> std::unique_ptr<UringBackend> {
+    io_uring_params params{};
+    int const fd{
+        static_cast<int>(syscall(__NR_io_uring_setup, ENTRIES, &params))};
+    if (fd < 0) {
+      return nullptr;
+    }
+    // Waiting with a timeout takes the extended arguments of Linux 5.11
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) ||
+        !(params.features & IORING_FEAT_EXT_ARG)) {
+      close(fd);
+      return nullptr;
+    }
+    std::size_t const rings_size{std::max(
+        params.sq_off.array + params.sq_entries * sizeof(std::uint32_t),
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe))};
+    void* const rings{mmap(nullptr, rings_size, PROT_READ | PROT_WRITE,
+                           MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING)};
+    if (rings == MAP_FAILED) {
+      close(fd);
+      return nullptr;
+    }
+    std::size_t const sqes_size{params.sq_entries * sizeof(io_uring_sqe)};
+    void* const sqes{mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES)};
+    if (sqes == MAP_FAILED) {
+      munmap(rings, rings_size);
+      close(fd);
+      return nullptr;
+    }
+    return std::unique_ptr<UringBackend>{
+        new UringBackend{fd, params, rings, rings_size, sqes, sqes_size}};
+  }
+
+  ~UringBackend() override {
+    // Closing the ring cancels what is still in flight
+    munmap(sqes_, sqes_size_);
+    munmap(rings_, rings_size_);
+    close(ring_);
+  }
+
+  [[nodiscard]] auto kind() const -> Loop::Kind override {
+    return Loop::Kind::IO_URING;
+  }
+
+  [[nodiscard]] auto open_flags() const -> int override { return 0; }
+
+  auto submit(std::unique_ptr<Request> request) -> void override {
+    io_uring_sqe& sqe{next_entry()};
+    sqe.opcode = request->write_ ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe.fd = request->fd_;
+    sqe.off = static_cast<std::uint64_t>(request->offset_);
+    sqe.addr = reinterpret_cast<std::uint64_t>(request->data_);
+    sqe.len = static_cast<std::uint32_t>(request->size_);
+    sqe.user_data = reinterpret_cast<std::uint64_t>(request.get());
+    in_flight_.emplace(request.get(), std::move(request));
+  }
+
+  auto wait(std::optional<std::chrono::steady_clock::time_point> deadline)
+      -> void override {
+    if (!waker_armed_) {
+      io_uring_sqe& sqe{next_entry()};
+      sqe.opcode = IORING_OP_READ;
+      sqe.fd = waker_;
+      sqe.addr = reinterpret_cast<std::uint64_t>(&waker_value_);
+      sqe.len = sizeof(waker_value_);
+      sqe.user_data = WAKER;
+      waker_armed_ = true;
+    }
+
+    __kernel_timespec timeout{};
+    io_uring_getevents_arg argument{};
+    std::uint32_t const flags{IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG};
+    if (deadline) {
+      auto const left{std::max(
+          std::chrono::nanoseconds{0},
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              *deadline - std::chrono::steady_clock::now()))};
+      timeout.tv_sec = left.count() / 1'000'000'000;
+      timeout.tv_nsec = left.count() % 1'000'000'000;
+      argument.ts = reinterpret_cast<std::uint64_t>(&timeout);
+    }
+    // Errors, a timeout or a signal all just end the wait
+    static_cast<void>(syscall(__NR_io_uring_enter, ring_, unsubmitted_, 1,
+                              flags, &argument, sizeof(argument)));
+    unsubmitted_ = 0;
+
+    reap();
+  }
+
+ private:
+  static constexpr unsigned ENTRIES{256};
+  // Requests are heap addresses, which are never this small
+  static constexpr std::uint64_t WAKER{1};
+
+  UringBackend(int const ring, io_uring_params const& params, void* const rings,
+               std::size_t const rings_size, void* const sqes,
+               std::size_t const sqes_size)
+      : ring_{ring},
+        rings_{rings},
+        rings_size_{rings_size},
+        sqes_{static_cast<io_uring_sqe*>(sqes)},
+        sqes_size_{sqes_size},
+        sq_head_{field(params.sq_off.head)},
+        sq_tail_{field(params.sq_off.tail)},
+        sq_mask_{*field(params.sq_off.ring_mask)},
+        sq_entries_{params.sq_entries},
+        sq_array_{field(params.sq_off.array)},
+        cq_head_{field(params.cq_off.head)},
+        cq_tail_{field(params.cq_off.tail)},
+        cq_mask_{*field(params.cq_off.ring_mask)},
+        cqes_{reinterpret_cast<io_uring_cqe*>(static_cast<char*>(rings) +
+                                              params.cq_off.cqes)},
+        unsubmitted_{0},
+        waker_armed_{false},
+        waker_value_{0} {}
+
+  auto field(std::uint32_t const offset) const -> std::uint32_t* {
+    return reinterpret_cast<std::uint32_t*>(static_cast<char*>(rings_) +
+                                            offset);
+  }
+
+  // A cleared submission queue entry, submitted by the next system call
+  auto next_entry() -> io_uring_sqe& {
+    std::uint32_t const tail{*sq_tail_};
+    if (tail - std::atomic_ref{*sq_head_}.load(std::memory_order_acquire) ==
+        sq_entries_) {
+      // Full: hand what is queued to the kernel first
+      static_cast<void>(
+          syscall(__NR_io_uring_enter, ring_, unsubmitted_, 0, 0, nullptr, 0));
+      unsubmitted_ = 0;
+    }
+    std::uint32_t const index{tail & sq_mask_};
+    io_uring_sqe& sqe{sqes_[index]};
+    sqe = io_uring_sqe{};
+    sq_array_[index] = index;
+    std::atomic_ref{*sq_tail_}.store(tail + 1, std::memory_order_release);
+    ++unsubmitted_;
+    return sqe;
+  }
+
+  auto reap() -> void {
+    std::uint32_t head{*cq_head_};
+    std::uint32_t const tail{
+        std::atomic_ref{*cq_tail_}.load(std::memory_order_acquire)};
+    std::vector<std::pair<Request*, long>> completed{};
+    for (; head != tail; ++head) {
+      io_uring_cqe const& cqe{cqes_[head & cq_mask_]};
+      if (cqe.user_data == WAKER) {
+        waker_armed_ = false;
+      } else {
+        completed.emplace_back(reinterpret_cast<Request*>(cqe.user_data),
+                               cqe.res);
+      }
+    }
+    std::atomic_ref{*cq_head_}.store(head, std::memory_order_release);
+
+    // Only now, as callbacks submit more
+    for (auto const& [address, result] : completed) {
+      auto const found{in_flight_.find(address)};
+      std::unique_ptr<Request> const request{std::move(found->second)};
+      in_flight_.erase(found);
+      request->done_(result);
+    }
+  }
+
+  int ring_;
+  void* rings_;
+  std::size_t rings_size_;
+  io_uring_sqe* sqes_;
+  std::size_t sqes_size_;
+
+  std::uint32_t* sq_head_;
+  std::uint32_t* sq_tail_;
+  std::uint32_t sq_mask_;
+  std::uint32_t sq_entries_;
+  std::uint32_t* sq_array_;
+  std::uint32_t* cq_head_;
+  std::uint32_t* cq_tail_;
+  std::uint32_t cq_mask_;
+  io_uring_cqe* cqes_;
+
+  std::uint32_t unsubmitted_;
+  // The kernel writes to their buffers until they complete
+  std::unordered_map<Request*, std::unique_ptr<Request>> in_flight_;
+  bool waker_armed_;
+  std::uint64_t waker_value_;
+};
+#endif
+
+auto make_backend(Loop::Kind const kind) -> std::unique_ptr<Backend> {
+#ifdef LOX_IO_URING
+  if (kind == Loop::Kind::IO_URING) {
+    if (std::unique_ptr<UringBackend> uring{UringBackend::create()}) {
+      return uring;
+    }
+  }
+#endif
+  return std::make_unique<EpollBackend>();
+}
+
+// A whole file being read, a chunk at a time
+struct Reading {
+  int fd_;
+  std::string path_;
+  // Where the next chunk is in the file, or -1 for a stream
+  std::int64_t offset_;
+  std::size_t chunk_;
+  std::string contents_;
+  Callback<std::string> done_;
+};
+
+auto read_chunks(Backend& backend, std::shared_ptr<Reading> const& reading)
+    -> void {
+  std::size_t const size{reading->contents_.size()};
+  reading->contents_.resize(size + reading->chunk_);
+  backend.submit(std::make_unique<Request>(Request{
+      reading->fd_, reading->offset_, reading->contents_.data() + size,
+      reading->chunk_, false, [&backend, reading, size](long const result) {
+        reading->contents_.resize(size + static_cast<std::size_t>(
+                                             std::max(result, 0L)));
+        if (result > 0) {
+          if (reading->offset_ >= 0) {
+            reading->offset_ += result;
+          }
+          reading->chunk_ = CHUNK_SIZE;
+          read_chunks(backend, reading);
+          return;
+        }
+        close(reading->fd_);
+        if (result < 0) {
+          reading->done_(Error{"Can't read '" + reading->path_ +
+                               "': " + describe(static_cast<int>(-result))});
+        } else {
+          reading->done_(std::move(reading->contents_));
+        }
+      }}));
+}
+
+struct Writing {
+  int fd_;
+  std::string path_;
+  std::int64_t offset_;
+  std::string contents_;
+  std::size_t written_;
+  Callback<std::size_t> done_;
+};
+
+auto write_chunks(Backend& backend, std::shared_ptr<Writing> const& writing)
+    -> void {
+  std::size_t const left{writing->contents_.size() - writing->written_};
+  if (left == 0) {
+    close(writing->fd_);
+    writing->done_(writing->written_);
+    return;
+  }
+  backend.submit(std::make_unique<Request>(Request{
+      writing->fd_, writing->offset_,
+      writing->contents_.data() + writing->written_,
+      std::min(left, MAX_TRANSFER), true,
+      [&backend, writing](long const result) {
+        if (result <= 0) {
+          close(writing->fd_);
+          writing->done_(
+              Error{"Can't write '" + writing->path_ + "': " +
+                    describe(result < 0 ? static_cast<int>(-result) : EIO)});
+          return;
+        }
+        writing->written_ += static_cast<std::size_t>(result);
+        if (writing->offset_ >= 0) {
+          writing->offset_ += result;
+        }
+        write_chunks(backend, writing);
+      }}));
+}
+
+// Regular files are read and written at offsets, anything else as a stream
+auto regular_size(int const fd) -> std::optional<std::size_t> {
+  struct stat status {};
+  if (fstat(fd, &status) == 0 && S_ISREG(status.st_mode)) {
+    return static_cast<std::size_t>(status.st_size);
+  }
+  return std::nullopt;
+}
+}  // namespace
+
+auto Loop::default_kind() -> Kind {
+  char const* const backend{std::getenv("LOX_IO_BACKEND")};
+  return backend && std::string_view{backend} == "epoll" ? Kind::EPOLL
+                                                        : Kind::IO_URING;
+}
+
+Loop::Loop(Kind const kind)
+    : backend_{make_backend(kind)},
+      stopping_{false},
+      files_{0},
+      stdin_reading_{false},
+      stdin_ended_{false},
+      thread_{[this] { run(); }} {}
+
+Loop::~Loop() {
+  {
+    std::lock_guard const lock{mutex_};
+    stopping_ = true;
+  }
+  backend_->wake();
+  thread_.join();
+}
+
+auto Loop::kind() const -> Kind { return backend_->kind(); }
+
+auto Loop::read_file(std::string path, Callback<std::string> done) -> void {
+  post([this, path = std::move(path), done = std::move(done)]() mutable {
+    int const fd{open(path.c_str(),
+                      O_RDONLY | O_CLOEXEC | backend_->open_flags())};
+    if (fd < 0) {
+      done(Error{"Can't open '" + path + "': " + describe(errno)});
+      return;
+    }
+    ++files_;
+    std::optional<std::size_t> const size{regular_size(fd)};
+    // One more byte than a regular file has, so that the first read gets all
+    // of it. Files under /proc claim to be empty, so read a chunk at least.
+    std::size_t const chunk{
+        size ? std::clamp(*size + 1, CHUNK_SIZE, MAX_TRANSFER) : CHUNK_SIZE};
+    auto const reading{std::make_shared<Reading>(
+        Reading{fd, std::move(path), size ? 0 : -1, chunk, {},
+                [this, done = std::move(done)](Result<std::string> result) {
+                  --files_;
+                  done(std::move(result));
+                }})};
+    // Room for the read that finds the end too
+    reading->contents_.reserve(chunk + CHUNK_SIZE);
+    read_chunks(*backend_, reading);
+  });
+}
+
+auto Loop::write_file(std::string path, std::string contents,
+                      Callback<std::size_t> done) -> void {
+  post([this, path = std::move(path), contents = std::move(contents),
+        done = std::move(done)]() mutable {
+    int const fd{open(path.c_str(),
+                      O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC |
+                          backend_->open_flags(),
+                      0666)};
+    if (fd < 0) {
+      done(Error{"Can't open '" + path + "': " + describe(errno)});
+      return;
+    }
+    ++files_;
+    std::int64_t const offset{regular_size(fd) ? 0 : -1};
+    write_chunks(*backend_,
+                 std::make_shared<Writing>(Writing{
+                     fd, std::move(path), offset, std::move(contents), 0,
+                     [this, done = std::move(done)](Result<std::size_t> r) {
+                       --files_;
+                       done(std::move(r));
+                     }}));
+  });
+}
+
+auto Loop::read_line(Callback<std::optional<std::string>> done) -> void {
+  post([this, done = std::move(done)]() mutable {
+    line_readers_.push(std::move(done));
+    hand_out_lines();
+  });
+}
+
+auto Loop::timer(std::chrono::nanoseconds const delay,
+                 std::function<void()> done) -> void {
+  auto const deadline{std::chrono::steady_clock::now() + delay};
+  post([this, deadline, done = std::move(done)]() mutable {
+    timers_.push(Timer{deadline, std::move(done)});
+  });
+}
+
+auto Loop::post(std::function<void()> work) -> void {
+  {
+    std::lock_guard const lock{mutex_};
+    posted_.push_back(std::move(work));
+  }
+  backend_->wake();
+}
+
+auto Loop::run() -> void {
+  while (true) {
+    std::vector<std::function<void()>> posted{};
+    {
+      std::lock_guard const lock{mutex_};
+      if (stopping_ && posted_.empty() && files_ == 0) {
+        return;
+      }
+      posted.swap(posted_);
+    }
+    for (std::function<void()>& work : posted) {
+      work();
+    }
+
+    auto const now{std::chrono::steady_clock::now()};
+    while (!timers_.empty() && timers_.top().deadline_ <= now) {
+      std::function<void()> const done{timers_.top().done_};
+      timers_.pop();
+      done();
+    }
+
+    backend_->wait(timers_.empty() ? std::nullopt
+                                   : std::optional{timers_.top().deadline_});
+  }
+}
+
+auto Loop::read_stdin() -> void {
+  stdin_reading_ = true;
+  // Not into the buffer itself, which lines are taken from meanwhile
+  stdin_chunk_.resize(CHUNK_SIZE);
+  backend_->submit(std::make_unique<Request>(
+      Request{STDIN_FILENO, -1, stdin_chunk_.data(), CHUNK_SIZE, false,
+              [this](long const result) {
+                stdin_reading_ = false;
+                // Errors end the input as well
+                stdin_buffer_.append(
+                    stdin_chunk_, 0,
+                    static_cast<std::size_t>(std::max(result, 0L)));
+                stdin_ended_ = result <= 0;
+                hand_out_lines();
+              }}));
+}
+
+auto Loop::hand_out_lines() -> void {
+  while (!line_readers_.empty()) {
+    std::size_t const end{stdin_buffer_.find('\n')};
+    if (end == std::string::npos && !stdin_ended_) {
+      if (!stdin_reading_) {
+        read_stdin();
+      }
+      return;
+    }
+
+    std::optional<std::string> line{};
+    if (end != std::string::npos) {
+      line = stdin_buffer_.substr(0, end);
+      stdin_buffer_.erase(0, end + 1);
+    } else if (!stdin_buffer_.empty()) {
+      // The last line need not end with a line break
+      line = std::move(stdin_buffer_);
+      stdin_buffer_.clear();
+    }
+    Callback<std::optional<std::string>> const reader{
+        std::move(line_readers_.front())};
+    line_readers_.pop();
+    reader(std::move(line));
+  }
+}
+}  // namespace Io
@@ -0,0 +1,123 @@
+#ifndef LOX_IO_LOOP
+#define LOX_IO_LOOP
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+namespace Io {
+class Backend;
+
+struct Error {
+  std::string message_;
+};
+
+template <typename T>
+using Result = std::variant<T, Error>;
+
+// Called on the thread of the loop once an operation completes
+template <typename T>
+using Callback = std::function<void(Result<T>)>;
+
+/**
+ * Performs I/O operations on a thread of its own, so that issuing one never
+ * waits for it. The thread waits for the completions of every operation in
+ * flight at once: through io_uring where the kernel allows it, and through
+ * epoll otherwise. Regular files can't be polled, so under epoll they are
+ * read and written by the thread of the loop directly.
+ *
+ * Operations may be issued from any thread.
+ */
+class Loop {
+ public:
+  enum class Kind { EPOLL, IO_URING };
+
+  /**
+   * io_uring, unless the LOX_IO_BACKEND environment variable says "epoll".
+   */
+  static auto default_kind() -> Kind;
+
+  /**
+   * @param kind Falls back to epoll if io_uring is not available.
+   */
+  explicit Loop(Kind kind);
+
+  Loop(Loop const&) = delete;
+  auto operator=(Loop const&) -> Loop& = delete;
+
+  /**
+   * Waits for file operations still in flight, so that no write is lost.
+   * Timers and reads of the standard input are abandoned.
+   */
+  ~Loop();
+
+  [[nodiscard]] auto kind() const -> Kind;
+
+  // Reads the whole of a file, or of a pipe until its writers close it
+  auto read_file(std::string path, Callback<std::string> done) -> void;
+
+  // Replaces the contents of a file. Completes with the number of bytes.
+  auto write_file(std::string path, std::string contents,
+                  Callback<std::size_t> done) -> void;
+
+  /**
+   * Reads the next line of the standard input, without its line break.
+   * Completes with nothing at the end of the input. Lines are handed out in
+   * the order they are asked for.
+   */
+  auto read_line(Callback<std::optional<std::string>> done) -> void;
+
+  auto timer(std::chrono::nanoseconds delay, std::function<void()> done)
+      -> void;
+
+ private:
+  struct Timer {
+    std::chrono::steady_clock::time_point deadline_;
+    std::function<void()> done_;
+
+    // Orders the priority queue by the earliest deadline
+    auto operator<(Timer const& other) const -> bool {
+      return deadline_ > other.deadline_;
+    }
+  };
+
+  // Hands work to the thread of the loop
+  auto post(std::function<void()> work) -> void;
+
+  auto run() -> void;
+
+  // The rest only runs on the thread of the loop
+  auto read_stdin() -> void;
+
+  auto hand_out_lines() -> void;
+
+  std::unique_ptr<Backend> backend_;
+
+  std::mutex mutex_;
+  std::vector<std::function<void()>> posted_;
+  bool stopping_;
+
+  // File operations in flight
+  std::size_t files_;
+  std::priority_queue<Timer> timers_;
+
+  // What has been read of the standard input but not handed out
+  std::string stdin_buffer_;
+  std::string stdin_chunk_;
+  bool stdin_reading_;
+  bool stdin_ended_;
+  std::queue<Callback<std::optional<std::string>>> line_readers_;
+
+  std::thread thread_;
+};
+}  // namespace Io
+
+#endif
@@ -0,0 +1,77 @@
+#include "./isolate.hpp"
+
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+
+#include "./core.hpp"
+#include "./output.hpp"
+
+namespace Core {
+Isolate::Isolate(Script script, std::unique_ptr<Output::Sink> out,
+                 Budget budget)
+    : script_{std::move(script)},
+      globals_{},
+      out_{std::move(out)},
+      budget_{budget} {}
+
+auto Isolate::globals() -> Globals& { return globals_; }
+
+auto Isolate::out() -> Output::Sink& { return *out_; }
+
+auto Isolate::run() -> std::optional<Error> {
+  std::optional<Error> error{execute(script_, globals_, *out_, budget_)};
+  out_->flush();
+  return error;
+}
+
+Pool::Pool(std::size_t const threads) : stopping_{false} {
+  threads_.reserve(threads);
+  for (std::size_t i = 0; i < threads; ++i) {
+    threads_.emplace_back([this] { work(); });
+  }
+}
+
+Pool::~Pool() {
+  {
+    std::lock_guard const lock{mutex_};
+    stopping_ = true;
+  }
+  available_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+auto Pool::submit(Isolate& isolate) -> std::future<std::optional<Error>> {
+  std::packaged_task<std::optional<Error>()> task{
+      [&isolate] { return isolate.run(); }};
+  std::future<std::optional<Error>> result{task.get_future()};
+  {
+    std::lock_guard const lock{mutex_};
+    queue_.push_back(std::move(task));
+  }
+  available_.notify_one();
+  return result;
+}
+
+auto Pool::work() -> void {
+  while (true) {
+    std::packaged_task<std::optional<Error>()> task{};
+    {
+      std::unique_lock lock{mutex_};
+      available_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+      if (queue_.empty()) {
+        return;
+      }
+      task = std::move(queue_.front());
+      queue_.pop_front();
+    }
+    // Exceptions other than Lox errors end up in the future
+    task();
+  }
+}
+}  // namespace Core
@@ -0,0 +1,77 @@
+#ifndef LOX_ISOLATE
+#define LOX_ISOLATE
+
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "./budget.hpp"
+#include "./core.hpp"
+#include "./output.hpp"
+
+namespace Core {
+/**
+ * A script together with everything executing it may touch: its own globals,
+ * through which every value it creates is reached, and its own output sink.
+ * Isolates share nothing mutable, so different isolates may run on different
+ * threads at the same time. The compiled script itself is shared.
+ */
+class Isolate {
+ public:
+  Isolate(Script script, std::unique_ptr<Output::Sink> out,
+          Budget budget = {});
+
+  [[nodiscard]] auto globals() -> Globals&;
+
+  [[nodiscard]] auto out() -> Output::Sink&;
+
+  /**
+   * Executes the script in the globals of the isolate, then flushes its sink.
+   *
+   * @return The runtime error that stopped the script, if any.
+   */
+  auto run() -> std::optional<Error>;
+
+ private:
+  Script script_;
+  Globals globals_;
+  std::unique_ptr<Output::Sink> out_;
+  Budget budget_;
+};
+
+/**
+ * A fixed set of threads running isolates, in the order they are submitted.
+ */
+class Pool {
+ public:
+  explicit Pool(std::size_t threads);
+
+  Pool(Pool const&) = delete;
+  auto operator=(Pool const&) -> Pool& = delete;
+
+  // Runs the isolates still queued, then joins the threads.
+  ~Pool();
+
+  /**
+   * Queues an isolate to run. The isolate must not be used or destroyed until
+   * the returned future is ready.
+   */
+  auto submit(Isolate& isolate) -> std::future<std::optional<Error>>;
+
+ private:
+  auto work() -> void;
+
+  std::mutex mutex_;
+  std::condition_variable available_;
+  std::deque<std::packaged_task<std::optional<Error>()>> queue_;
+  bool stopping_;
+  std::vector<std::thread> threads_;
+};
+}  // namespace Core
+
+#endif
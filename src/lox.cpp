@@ -1,28 +1,113 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <future>
 #include <iostream>
+#include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <variant>
+#include <vector>
 
-#include "./interpreter.hpp"
-#include "./parser/parser.hpp"
-#include "./resolver.hpp"
-#include "./scanner.hpp"
-#include "./types/expression.hpp"
-#include "./types/function.hpp"
-#include "./types/statement.hpp"
-#include "./types/token.hpp"
-#include "./utils/error.hpp"
+#include "./budget.hpp"
+#include "./cache.hpp"
+#include "./core.hpp"
+#include "./counters.hpp"
+#include "./isolate.hpp"
+#include "./memory.hpp"
+#include "./output.hpp"
+#include "./phases.hpp"
+#include "./profiler.hpp"
+#include "./trace.hpp"
 #include "./utils/reader.hpp"
 
+struct Options {
+  std::vector<std::string> scripts_;
+  // Threads to run several scripts on
+  std::size_t jobs_{std::max(1U, std::thread::hardware_concurrency())};
+  bool use_cache_{true};
+  bool cache_stats_{false};
+  // Empty for standard output
+  std::string output_;
+  // Applies to each script on its own
+  Budget budget_;
+  // How to report the phases of running a single script, on standard error
+  enum class PhaseReport { NONE, TEXT, JSON } time_phases_{PhaseReport::NONE};
+  // Where to write the folded stacks of a profile of the run, if anywhere
+  std::string profile_;
+  // Whether to report what allocated the heap, on standard error
+  bool heap_profile_{false};
+  // Where to write how often each node of a single script executed, if
+  // anywhere
+  std::string node_counts_;
+  // Where to write a trace of the phases and the Lox calls, if anywhere
+  std::string trace_;
+  // Calls shorter than this are left out of the trace
+  std::chrono::nanoseconds trace_threshold_{0};
+};
+
 class Lox {
  public:
-  auto run(std::string const &file_path) -> void {
-    auto const file_contents = Reader::read_file(file_path);
+  explicit Lox(Options const &options)
+      : options_{options}, out_{make_sink(options.output_)} {
+    if (options_.use_cache_) {
+      cache_.emplace(Cache::default_directory());
+    }
+  }
+
+  auto run(std::vector<std::string> const &file_paths) -> void {
+    std::optional<Trace::Recorder> trace{};
+    if (!options_.trace_.empty()) {
+      trace.emplace(options_.trace_threshold_);
+    }
+    std::optional<Profiler::Sampler> sampler{};
+    if (!options_.profile_.empty()) {
+      sampler.emplace();
+    }
+    if (options_.heap_profile_) {
+      Memory::start_profile();
+    }
+
+    if (file_paths.size() == 1) {
+      do_run(Reader::read_file(file_paths.front()));
+    } else {
+      run_batch(file_paths);
+    }
+    // std::exit() below does not run destructors
+    out_->flush();
+
+    if (trace) {
+      std::ofstream file{options_.trace_};
+      trace->write_json(file);
+    }
+    if (sampler) {
+      std::ofstream profile{options_.profile_};
+      sampler->write_folded(profile);
+    }
+    if (options_.heap_profile_) {
+      Memory::stop_profile().write_text(std::cerr);
+    }
 
-    do_run(file_contents);
+    if (options_.cache_stats_ && cache_) {
+      Cache::Stats const stats{cache_->stats()};
+      std::cerr << "[cache] hits: " << stats.hits_
+                << ", misses: " << stats.misses_ << '\n';
+    }
 
     if (had_error) {
       std::exit(65);
     }
 
+    // A script stopped by its budget is not necessarily wrong, only bigger
+    // than it was allowed to be
+    if (had_budget_error) {
+      std::exit(75);
+    }
+
     if (had_runtime_error) {
       std::exit(70);
     }
@@ -30,38 +115,238 @@ class Lox {
 
  private:
   auto do_run(std::string const &contents) -> void {
-    Expression expr;
+    std::optional<Phases::Report> report{};
+    if (options_.time_phases_ != Options::PhaseReport::NONE) {
+      report.emplace();
+    }
+    Phases::Report *const phases{report ? &*report : nullptr};
+
     try {
-      std::vector<Token> const tokens = Scanner::scan_tokens(contents);
-      std::vector<Statement> const statements = Parser::parse(tokens);
-      std::unordered_map<Token, std::size_t> const resolution =
-          Resolver::resolve(statements);
-      Interpreter::interpret(statements, resolution);
-    } catch (CompileTimeError const &e) {
-      had_error = true;
-      e.report();
-      return;
-    } catch (RuntimeError const &e) {
-      had_runtime_error = true;
-      e.report();
-      return;
+      auto compiled{Core::compile(contents, {}, cache_ ? &*cache_ : nullptr,
+                                  phases)};
+      if (auto const errors{std::get_if<std::vector<Core::Error>>(&compiled)}) {
+        had_error = true;
+        for (Core::Error const &error : *errors) {
+          error.report(std::cerr);
+        }
+        return;
+      }
+
+      Core::Script const &script{std::get<Core::Script>(compiled)};
+      std::optional<Counters::Profile> counters{};
+      if (!options_.node_counts_.empty()) {
+        counters.emplace(script.program().statements_);
+      }
+      if (std::optional<Core::Error> const error{Core::execute(
+              script, *out_, options_.budget_, phases,
+              counters ? &*counters : nullptr)}) {
+        record(*error);
+        // Keep the output of the script in front of the error
+        out_->flush();
+        error->report(std::cerr);
+      }
+      report_phases(report);
+      if (counters) {
+        std::ofstream file{options_.node_counts_};
+        counters->write_json(file);
+      }
     } catch (std::exception const &e) {
+      out_->flush();
       std::cerr << "Unhandled exception: " << e.what() << '\n';
       std::exit(-1);
+    }
+  }
+
+  // Runs each script in an isolate of its own, concurrently, and prints their
+  // output in the order of the scripts.
+  auto run_batch(std::vector<std::string> const &file_paths) -> void {
+    std::vector<std::unique_ptr<Core::Isolate>> isolates(file_paths.size());
+    std::vector<Output::MemorySink *> outputs(file_paths.size());
+    std::vector<std::future<std::optional<Core::Error>>> results(
+        file_paths.size());
+
+    Core::Pool pool{options_.jobs_};
+    for (std::size_t i = 0; i < file_paths.size(); ++i) {
+      auto compiled{Core::compile(Reader::read_file(file_paths[i]), {},
+                                  cache_ ? &*cache_ : nullptr)};
+      if (auto const errors{std::get_if<std::vector<Core::Error>>(&compiled)}) {
+        had_error = true;
+        for (Core::Error const &error : *errors) {
+          std::cerr << file_paths[i] << ": ";
+          error.report(std::cerr);
+        }
+        continue;
+      }
+
+      auto out{std::make_unique<Output::MemorySink>()};
+      outputs[i] = out.get();
+      isolates[i] = std::make_unique<Core::Isolate>(
+          std::get<Core::Script>(std::move(compiled)), std::move(out),
+          options_.budget_);
+      results[i] = pool.submit(*isolates[i]);
+    }
+
+    for (std::size_t i = 0; i < file_paths.size(); ++i) {
+      if (!isolates[i]) {
+        continue;
+      }
+      std::optional<Core::Error> const error{results[i].get()};
+      out_->write(outputs[i]->contents());
+      if (error) {
+        record(*error);
+        out_->flush();
+        std::cerr << file_paths[i] << ": ";
+        error->report(std::cerr);
+      }
+    }
+  }
+
+  auto report_phases(std::optional<Phases::Report> const &report) -> void {
+    if (!report) {
       return;
     }
+    out_->flush();
+    if (options_.time_phases_ == Options::PhaseReport::JSON) {
+      report->write_json(std::cerr);
+    } else {
+      report->write_text(std::cerr);
+    }
+  }
+
+  auto record(Core::Error const &error) -> void {
+    if (error.phase_ == Core::Error::Phase::BUDGET) {
+      had_budget_error = true;
+    } else {
+      had_runtime_error = true;
+    }
   }
 
+  static auto make_sink(std::string const &path)
+      -> std::unique_ptr<Output::Sink> {
+    if (path.empty()) {
+      return std::make_unique<Output::StdoutSink>();
+    }
+    return std::make_unique<Output::FileSink>(path);
+  }
+
+  Options options_;
+  std::unique_ptr<Output::Sink> out_;
+  std::optional<Cache::Store> cache_;
+
   bool had_error{false};
   bool had_runtime_error{false};
+  bool had_budget_error{false};
 };
 
+// Parses the value of an option, which must be a positive number
+template <typename T>
+auto parse_positive(char const *const text) -> std::optional<T> {
+  char *end{nullptr};
+  double const value{std::strtod(text, &end)};
+  if (end == text || *end != '\0' || !(value > 0)) {
+    return std::nullopt;
+  }
+  return static_cast<T>(value);
+}
+
+auto parse_options(int argc, char *argv[]) -> std::optional<Options> {
+  Options options{};
+  for (int i = 1; i < argc; ++i) {
+    std::string_view const arg{argv[i]};
+    if (arg == "--no-cache") {
+      options.use_cache_ = false;
+    } else if (arg == "--cache-stats") {
+      options.cache_stats_ = true;
+    } else if (arg == "--time-phases" || arg == "--time-phases=text") {
+      options.time_phases_ = Options::PhaseReport::TEXT;
+    } else if (arg == "--time-phases=json") {
+      options.time_phases_ = Options::PhaseReport::JSON;
+    } else if (arg.starts_with("--node-counts=")) {
+      options.node_counts_ =
+          arg.substr(std::string_view{"--node-counts="}.size());
+      if (options.node_counts_.empty()) {
+        return std::nullopt;
+      }
+    } else if (arg.starts_with("--trace=")) {
+      options.trace_ = arg.substr(std::string_view{"--trace="}.size());
+      if (options.trace_.empty()) {
+        return std::nullopt;
+      }
+    } else if (arg == "--heap-profile") {
+      options.heap_profile_ = true;
+    } else if (arg.starts_with("--profile=")) {
+      options.profile_ = arg.substr(std::string_view{"--profile="}.size());
+      if (options.profile_.empty()) {
+        return std::nullopt;
+      }
+    } else if (arg == "--output") {
+      if (++i == argc) {
+        return std::nullopt;
+      }
+      options.output_ = argv[i];
+    } else if (arg == "--jobs") {
+      if (++i == argc || std::atoi(argv[i]) <= 0) {
+        return std::nullopt;
+      }
+      options.jobs_ = static_cast<std::size_t>(std::atoi(argv[i]));
+    } else if (arg == "--max-statements" || arg == "--max-heap" ||
+               arg == "--max-depth") {
+      std::optional<std::uint64_t> const value{
+          ++i == argc ? std::nullopt : parse_positive<std::uint64_t>(argv[i])};
+      if (!value) {
+        return std::nullopt;
+      }
+      if (arg == "--max-statements") {
+        options.budget_.statements_ = *value;
+      } else if (arg == "--max-heap") {
+        options.budget_.heap_bytes_ = *value;
+      } else {
+        options.budget_.call_depth_ = static_cast<std::size_t>(*value);
+      }
+    } else if (arg == "--max-time") {
+      std::optional<double> const seconds{
+          ++i == argc ? std::nullopt : parse_positive<double>(argv[i])};
+      if (!seconds) {
+        return std::nullopt;
+      }
+      options.budget_.wall_time_ =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::duration<double>{*seconds});
+    } else if (arg == "--trace-threshold") {
+      std::optional<double> const microseconds{
+          ++i == argc ? std::nullopt : parse_positive<double>(argv[i])};
+      if (!microseconds) {
+        return std::nullopt;
+      }
+      options.trace_threshold_ =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::duration<double, std::micro>{*microseconds});
+    } else if (arg.starts_with("--")) {
+      return std::nullopt;
+    } else {
+      options.scripts_.emplace_back(arg);
+    }
+  }
+
+  if (options.scripts_.empty()) {
+    return std::nullopt;
+  }
+  return options;
+}
+
 auto main(int argc, char *argv[]) -> int {
-  if (argc != 2) {
-    std::cout << "Wrong! Correct usage: cpplox [script]\n";
+  if (std::optional<Options> const options{parse_options(argc, argv)}) {
+    Lox lox{*options};
+    lox.run(options->scripts_);
   } else {
-    Lox lox;
-    lox.run(argv[1]);
+    std::cout << "Wrong! Correct usage: cpplox [--no-cache] [--cache-stats] "
+                 "[--time-phases[=text|json]] [--profile=file] "
+                 "[--heap-profile] [--node-counts=file] "
+                 "[--trace=file] [--trace-threshold microseconds] "
+                 "[--output file] [--jobs n] "
+                 "[--max-statements n] "
+                 "[--max-heap bytes] [--max-time seconds] [--max-depth n] "
+                 "[script...]\n";
   }
   return 0;
 }
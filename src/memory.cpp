@@ -0,0 +1,332 @@
+#include "./memory.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <map>
+#include <new>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <malloc.h>
+
+namespace {
+thread_local std::uint64_t allocated_bytes{0};
+thread_local std::uint64_t allocations{0};
+thread_local std::int64_t live_bytes{0};
+thread_local std::int64_t peak_live_bytes{0};
+
+// Where the calling thread's allocations go in a heap profile
+thread_local Memory::Category category{Memory::Category::OTHER};
+thread_local std::size_t line{0};
+
+/**
+ * The allocations of one thread by site, in an open addressed table. It is
+ * allocated with calloc, as it fills up from within operator new, and kept
+ * until the process exits, as the thread may not be.
+ */
+struct Table {
+  static constexpr std::size_t CAPACITY{std::size_t{1} << 14};
+
+  struct Entry {
+    // The line and the category of the site, plus one: 0 if empty
+    std::uint64_t key_;
+    std::uint64_t allocations_;
+    std::uint64_t bytes_;
+  };
+
+  Table* next_;
+  // Of sites that did not fit
+  Entry overflow_;
+  Entry entries_[CAPACITY];
+};
+
+std::atomic<Table*> tables{nullptr};
+thread_local Table* table{nullptr};
+
+// Over every thread while profiling, as memory is often freed by another
+// thread than the one that allocated it
+std::atomic<std::int64_t> profiled_live_bytes{0};
+std::atomic<std::int64_t> profiled_peak_bytes{0};
+
+constexpr std::size_t CATEGORIES{
+    static_cast<std::size_t>(Memory::Category::COLLECTION) + 1};
+
+auto key(Memory::Category const category, std::size_t const line)
+    -> std::uint64_t {
+  return (static_cast<std::uint64_t>(line) * CATEGORIES +
+          static_cast<std::uint64_t>(category)) +
+         1;
+}
+
+[[gnu::noinline]] auto attribute(std::size_t const size) noexcept -> void {
+  std::int64_t const live{profiled_live_bytes.fetch_add(
+                              static_cast<std::int64_t>(size),
+                              std::memory_order_relaxed) +
+                          static_cast<std::int64_t>(size)};
+  std::int64_t peak{profiled_peak_bytes.load(std::memory_order_relaxed)};
+  while (live > peak && !profiled_peak_bytes.compare_exchange_weak(
+                            peak, live, std::memory_order_relaxed)) {
+  }
+
+  if (!table) {
+    table = static_cast<Table*>(std::calloc(1, sizeof(Table)));
+    if (!table) {
+      return;
+    }
+    table->next_ = tables.load(std::memory_order_relaxed);
+    while (!tables.compare_exchange_weak(table->next_, table,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed)) {
+    }
+  }
+
+  std::uint64_t const site{key(category, line)};
+  Table::Entry* entry{&table->overflow_};
+  // Fibonacci hashing, then linear probing
+  std::size_t slot{static_cast<std::size_t>((site * 0x9E3779B97F4A7C15U) >>
+                                            50)};
+  for (std::size_t probes = 0; probes < 64; ++probes) {
+    Table::Entry& candidate{table->entries_[slot]};
+    if (candidate.key_ == site || candidate.key_ == 0) {
+      candidate.key_ = site;
+      entry = &candidate;
+      break;
+    }
+    slot = (slot + 1) % Table::CAPACITY;
+  }
+  ++entry->allocations_;
+  entry->bytes_ += size;
+}
+
+auto track(void* const memory, std::size_t const size) noexcept -> void* {
+  if (memory) {
+    allocated_bytes += size;
+    ++allocations;
+    live_bytes += static_cast<std::int64_t>(size);
+    peak_live_bytes = std::max(peak_live_bytes, live_bytes);
+    if (Memory::profiling.load(std::memory_order_relaxed)) [[unlikely]] {
+      attribute(size);
+    }
+  }
+  return memory;
+}
+
+auto allocate(std::size_t const size) noexcept -> void* {
+  // malloc(0) may return null, which new must not
+  return track(std::malloc(size == 0 ? 1 : size), size);
+}
+
+auto allocate(std::size_t const size, std::align_val_t const alignment) noexcept
+    -> void* {
+  auto const align{static_cast<std::size_t>(alignment)};
+  // aligned_alloc wants a multiple of the alignment
+  return track(std::aligned_alloc(align, (size + align - 1) / align * align),
+               size);
+}
+
+// Sized deletes, which is what the compiler and the standard containers use
+// for complete types, hand back the size that was allocated
+auto release(void* const memory, std::size_t const size) noexcept -> void {
+  if (memory) {
+    live_bytes -= static_cast<std::int64_t>(size);
+    if (Memory::profiling.load(std::memory_order_relaxed)) [[unlikely]] {
+      profiled_live_bytes.fetch_sub(static_cast<std::int64_t>(size),
+                                    std::memory_order_relaxed);
+    }
+  }
+  std::free(memory);
+}
+
+// Otherwise malloc is asked, which may know of a few bytes more
+auto release(void* const memory) noexcept -> void {
+  release(memory, memory ? malloc_usable_size(memory) : 0);
+}
+}  // namespace
+
+auto Memory::allocated_bytes() -> std::uint64_t { return ::allocated_bytes; }
+
+auto Memory::allocations() -> std::uint64_t { return ::allocations; }
+
+auto Memory::live_bytes() -> std::int64_t { return ::live_bytes; }
+
+auto Memory::peak_live_bytes() -> std::int64_t { return ::peak_live_bytes; }
+
+auto Memory::reset_peak() -> void { ::peak_live_bytes = ::live_bytes; }
+
+auto Memory::Site::enter(Category const category, std::size_t const line)
+    -> void {
+  category_ = std::exchange(::category, category);
+  line_ = ::line;
+  if (line != 0) {
+    ::line = line;
+  }
+}
+
+auto Memory::Site::leave() -> void {
+  ::category = category_;
+  ::line = line_;
+}
+
+auto Memory::start_profile() -> void {
+  // What is live already counts towards the peak
+  profiled_live_bytes.store(::live_bytes, std::memory_order_relaxed);
+  profiled_peak_bytes.store(::live_bytes, std::memory_order_relaxed);
+  for (Table* current{tables.load(std::memory_order_acquire)}; current;
+       current = current->next_) {
+    std::fill(std::begin(current->entries_), std::end(current->entries_),
+              Table::Entry{});
+    current->overflow_ = {};
+  }
+  profiling.store(true, std::memory_order_release);
+}
+
+auto Memory::stop_profile() -> Profile {
+  profiling.store(false, std::memory_order_release);
+
+  std::map<std::uint64_t, SiteUsage> sites{};
+  auto const add{[&sites](Table::Entry const& entry, std::uint64_t const key) {
+    if (entry.allocations_ == 0) {
+      return;
+    }
+    SiteUsage const site{static_cast<Category>((key - 1) % CATEGORIES),
+                         (key - 1) / CATEGORIES, 0, 0};
+    SiteUsage& usage{sites.try_emplace(key, site).first->second};
+    usage.allocations_ += entry.allocations_;
+    usage.bytes_ += entry.bytes_;
+  }};
+  for (Table const* current{tables.load(std::memory_order_acquire)}; current;
+       current = current->next_) {
+    for (Table::Entry const& entry : current->entries_) {
+      add(entry, entry.key_);
+    }
+    add(current->overflow_, ::key(Category::OTHER, 0));
+  }
+
+  Profile profile{profiled_peak_bytes.load(std::memory_order_relaxed), {}};
+  for (auto const& [key, usage] : sites) {
+    profile.sites_.push_back(usage);
+  }
+  std::stable_sort(profile.sites_.begin(), profile.sites_.end(),
+                   [](SiteUsage const& a, SiteUsage const& b) {
+                     return a.bytes_ > b.bytes_;
+                   });
+  return profile;
+}
+
+auto Memory::Profile::write_text(std::ostream& out,
+                                 std::size_t const top_sites) const -> void {
+  constexpr std::array<char const*, CATEGORIES> names{
+      "other",  "environment", "arguments", "copy",
+      "string", "instance",    "function",  "collection"};
+
+  std::array<SiteUsage, CATEGORIES> categories{};
+  SiteUsage total{};
+  for (SiteUsage const& site : sites_) {
+    SiteUsage& usage{categories[static_cast<std::size_t>(site.category_)]};
+    usage.allocations_ += site.allocations_;
+    usage.bytes_ += site.bytes_;
+    total.allocations_ += site.allocations_;
+    total.bytes_ += site.bytes_;
+  }
+
+  std::ios_base::fmtflags const flags{out.flags()};
+  out << "allocations: " << total.allocations_ << ", bytes: " << total.bytes_
+      << ", peak live bytes: " << peak_live_bytes_ << '\n';
+  out << std::left << std::setw(13) << "category" << std::right
+      << std::setw(13) << "allocations" << std::setw(16) << "bytes" << '\n';
+  for (std::size_t i = 0; i < CATEGORIES; ++i) {
+    if (categories[i].allocations_ != 0) {
+      out << std::left << std::setw(13) << names[i] << std::right
+          << std::setw(13) << categories[i].allocations_ << std::setw(16)
+          << categories[i].bytes_ << '\n';
+    }
+  }
+
+  out << std::left << std::setw(8) << "line" << std::setw(13) << "category"
+      << std::right << std::setw(13) << "allocations" << std::setw(16)
+      << "bytes" << '\n';
+  for (std::size_t i = 0; i < std::min(top_sites, sites_.size()); ++i) {
+    SiteUsage const& site{sites_[i]};
+    out << std::left << std::setw(8)
+        << (site.line_ == 0 ? "?" : std::to_string(site.line_))
+        << std::setw(13) << names[static_cast<std::size_t>(site.category_)]
+        << std::right << std::setw(13) << site.allocations_ << std::setw(16)
+        << site.bytes_ << '\n';
+  }
+  out.flags(flags);
+}
+
+auto operator new(std::size_t const size) -> void* {
+  if (void* const memory{allocate(size)}) {
+    return memory;
+  }
+  throw std::bad_alloc{};
+}
+
+auto operator new[](std::size_t const size) -> void* {
+  return operator new(size);
+}
+
+auto operator new(std::size_t const size, std::align_val_t const alignment)
+    -> void* {
+  if (void* const memory{allocate(size, alignment)}) {
+    return memory;
+  }
+  throw std::bad_alloc{};
+}
+
+auto operator new[](std::size_t const size, std::align_val_t const alignment)
+    -> void* {
+  return operator new(size, alignment);
+}
+
+auto operator new(std::size_t const size, std::nothrow_t const&) noexcept
+    -> void* {
+  return allocate(size);
+}
+
+auto operator new[](std::size_t const size, std::nothrow_t const&) noexcept
+    -> void* {
+  return allocate(size);
+}
+
+auto operator delete(void* const memory) noexcept -> void { release(memory); }
+
+auto operator delete[](void* const memory) noexcept -> void {
+  release(memory);
+}
+
+auto operator delete(void* const memory, std::size_t const size) noexcept
+    -> void {
+  release(memory, size);
+}
+
+auto operator delete[](void* const memory, std::size_t const size) noexcept
+    -> void {
+  release(memory, size);
+}
+
+auto operator delete(void* const memory, std::align_val_t) noexcept -> void {
+  release(memory);
+}
+
+auto operator delete[](void* const memory, std::align_val_t) noexcept -> void {
+  release(memory);
+}
+
+auto operator delete(void* const memory, std::size_t const size,
+                     std::align_val_t) noexcept -> void {
+  release(memory, size);
+}
+
+auto operator delete[](void* const memory, std::size_t const size,
+                       std::align_val_t) noexcept -> void {
+  release(memory, size);
+}
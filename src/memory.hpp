@@ -0,0 +1,116 @@
+#ifndef LOX_MEMORY
+#define LOX_MEMORY
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+/**
+ * Counts what the calling thread allocates through operator new, which
+ * memory.cpp replaces. Every container, string and shared object the
+ * interpreter creates goes through it.
+ */
+namespace Memory {
+// Bytes ever allocated by the calling thread, freed since or not
+auto allocated_bytes() -> std::uint64_t;
+
+auto allocations() -> std::uint64_t;
+
+/**
+ * Bytes allocated by the calling thread less those it freed. Memory freed by
+ * another thread than the one that allocated it makes one of the two
+ * negative, so only the sum over the threads is meaningful.
+ */
+auto live_bytes() -> std::int64_t;
+
+// The most live_bytes has been since the last reset_peak
+auto peak_live_bytes() -> std::int64_t;
+
+auto reset_peak() -> void;
+
+// What the interpreter allocates for, as a heap profile tells them apart
+enum class Category {
+  OTHER,
+  // Scopes of blocks and calls, and the variables defined in them
+  ENVIRONMENT,
+  // The arguments of calls
+  ARGUMENTS,
+  // Values copied out of variables and properties: strings, functions and
+  // classes are copied whole
+  COPY,
+  // Strings built by concatenation
+  STRING,
+  // Instances of classes and their fields
+  INSTANCE,
+  // Functions and classes as they are declared
+  FUNCTION,
+  // Lists and maps
+  COLLECTION,
+};
+
+// Whether a heap profile is being taken
+inline std::atomic<bool> profiling{false};
+
+/**
+ * Puts what the calling thread allocates down to a category and a line of
+ * Lox source for as long as it lives, while a heap profile is being taken. A
+ * site without a line keeps the line of the site around it. Sites must not
+ * outlive a suspension of the task they are in.
+ */
+class Site {
+ public:
+  Site(Category const category, std::size_t const line)
+      : active_{profiling.load(std::memory_order_relaxed)} {
+    if (active_) [[unlikely]] {
+      enter(category, line);
+    }
+  }
+
+  Site(Site const&) = delete;
+  auto operator=(Site const&) -> Site& = delete;
+
+  ~Site() {
+    if (active_) [[unlikely]] {
+      leave();
+    }
+  }
+
+ private:
+  auto enter(Category category, std::size_t line) -> void;
+
+  auto leave() -> void;
+
+  bool active_;
+  Category category_{Category::OTHER};
+  std::size_t line_{0};
+};
+
+struct SiteUsage {
+  Category category_;
+  // 0 if unknown
+  std::size_t line_;
+  std::uint64_t allocations_;
+  std::uint64_t bytes_;
+};
+
+// What was allocated, by every thread, while a heap profile was taken
+struct Profile {
+  // The most bytes allocated and not freed at once, over every thread
+  std::int64_t peak_live_bytes_;
+  // Most bytes first
+  std::vector<SiteUsage> sites_;
+
+  // Totals by category, then the sites that allocated the most bytes
+  auto write_text(std::ostream& out, std::size_t top_sites = 20) const
+      -> void;
+};
+
+auto start_profile() -> void;
+
+// Only complete once the threads that allocated during the profile are done
+auto stop_profile() -> Profile;
+}  // namespace Memory
+
+#endif
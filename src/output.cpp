@@ -0,0 +1,114 @@
+#include "./output.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+namespace {
+// Longest shortest-form double, "-2.2250738585072014e-308", with room to spare
+constexpr std::size_t MAX_NUMBER_LENGTH{32};
+
+auto format(double const number, char* const first) -> char* {
+  char* const last{first + MAX_NUMBER_LENGTH};
+  if (std::isnan(number)) {
+    std::memcpy(first, "nan", 3);
+    return first + 3;
+  }
+  if (number == std::trunc(number) && std::abs(number) < 1e21) {
+    // Most integers fit a machine integer, which formats much faster
+    if (std::abs(number) < 1e18 && !(number == 0 && std::signbit(number))) {
+      return std::to_chars(first, last, static_cast<std::int64_t>(number)).ptr;
+    }
+    // Integers are exact in fixed notation, which never needs more than 22
+    // characters below 10^21.
+    return std::to_chars(first, last, number, std::chars_format::fixed, 0).ptr;
+  }
+  return std::to_chars(first, last, number).ptr;
+}
+}  // namespace
+
+namespace Output {
+Sink::Sink(std::size_t const capacity)
+    : buffer_(std::max(capacity, MAX_NUMBER_LENGTH)), size_{0} {}
+
+auto Sink::write(std::string_view const text) -> void {
+  if (text.size() > buffer_.size() - size_) {
+    flush();
+    // Hand on whatever does not fit in the buffer right away
+    if (text.size() > buffer_.size()) {
+      emit(text);
+      return;
+    }
+  }
+  std::memcpy(buffer_.data() + size_, text.data(), text.size());
+  size_ += text.size();
+}
+
+auto Sink::write(char const c) -> void {
+  if (size_ == buffer_.size()) {
+    flush();
+  }
+  buffer_[size_++] = c;
+}
+
+auto Sink::write(double const number) -> void {
+  if (buffer_.size() - size_ < MAX_NUMBER_LENGTH) {
+    flush();
+  }
+  size_ = static_cast<std::size_t>(format(number, buffer_.data() + size_) -
+                                   buffer_.data());
+}
+
+auto Sink::flush() -> void {
+  if (size_ > 0) {
+    // Reset first, so that a throwing emit() does not emit the bytes twice
+    std::size_t const size{size_};
+    size_ = 0;
+    emit(std::string_view{buffer_.data(), size});
+  }
+}
+
+StdoutSink::StdoutSink(std::size_t const capacity) : Sink{capacity} {}
+
+StdoutSink::~StdoutSink() { flush(); }
+
+auto StdoutSink::emit(std::string_view const bytes) -> void {
+  std::fwrite(bytes.data(), 1, bytes.size(), stdout);
+  std::fflush(stdout);
+}
+
+FileSink::FileSink(std::string const& path, std::size_t const capacity)
+    : Sink{capacity}, file_{std::fopen(path.c_str(), "wb")} {
+  if (!file_) {
+    throw std::ofstream::failure("Failed to open file");
+  }
+}
+
+FileSink::~FileSink() {
+  flush();
+  std::fclose(file_);
+}
+
+auto FileSink::emit(std::string_view const bytes) -> void {
+  std::fwrite(bytes.data(), 1, bytes.size(), file_);
+}
+
+MemorySink::MemorySink(std::size_t const capacity) : Sink{capacity} {}
+
+MemorySink::~MemorySink() { flush(); }
+
+auto MemorySink::contents() -> std::string const& {
+  flush();
+  return contents_;
+}
+
+auto MemorySink::emit(std::string_view const bytes) -> void {
+  contents_.append(bytes);
+}
+}  // namespace Output
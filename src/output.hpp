@@ -0,0 +1,95 @@
+#ifndef LOX_OUTPUT
+#define LOX_OUTPUT
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Output {
+constexpr std::size_t DEFAULT_CAPACITY{std::size_t{1} << 16};
+
+/**
+ * Where printed values go. Writes are collected in a buffer of fixed capacity
+ * and handed on in large chunks, when the buffer fills up and on flush().
+ *
+ * Subclasses must call flush() in their destructor: the buffer can no longer
+ * be emitted once the subclass is gone.
+ */
+class Sink {
+ public:
+  explicit Sink(std::size_t capacity = DEFAULT_CAPACITY);
+
+  Sink(Sink const&) = delete;
+  auto operator=(Sink const&) -> Sink& = delete;
+
+  virtual ~Sink() = default;
+
+  auto write(std::string_view text) -> void;
+
+  auto write(char c) -> void;
+
+  /**
+   * Writes a number the way Lox prints it: integers below 10^21 in full and
+   * without a fractional part, everything else in the shortest form that
+   * reads back as the same number.
+   */
+  auto write(double number) -> void;
+
+  auto flush() -> void;
+
+ protected:
+  virtual auto emit(std::string_view bytes) -> void = 0;
+
+ private:
+  std::vector<char> buffer_;
+  std::size_t size_;
+};
+
+class StdoutSink : public Sink {
+ public:
+  explicit StdoutSink(std::size_t capacity = DEFAULT_CAPACITY);
+
+  ~StdoutSink() override;
+
+ protected:
+  auto emit(std::string_view bytes) -> void override;
+};
+
+class FileSink : public Sink {
+ public:
+  /**
+   * Truncates the file, or creates it.
+   *
+   * @throws std::ofstream::failure If the file cannot be opened.
+   */
+  explicit FileSink(std::string const& path,
+                    std::size_t capacity = DEFAULT_CAPACITY);
+
+  ~FileSink() override;
+
+ protected:
+  auto emit(std::string_view bytes) -> void override;
+
+ private:
+  std::FILE* file_;
+};
+
+class MemorySink : public Sink {
+ public:
+  explicit MemorySink(std::size_t capacity = DEFAULT_CAPACITY);
+
+  ~MemorySink() override;
+
+  // Everything written so far, including what is still buffered
+  [[nodiscard]] auto contents() -> std::string const&;
+
+ protected:
+  auto emit(std::string_view bytes) -> void override;
+
+ private:
+  std::string contents_;
+};
+}  // namespace Output
+
+#endif
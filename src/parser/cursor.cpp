@@ -10,8 +10,8 @@
 
 namespace Parser {
 
-Cursor::Cursor(std::vector<Token> const& tokens)
-    : tokens_(tokens), current_(0){};
+Cursor::Cursor(std::vector<Token> const& tokens, std::size_t position)
+    : tokens_(tokens), current_(position), errors_{} {};
 
 template <typename Type>
 auto Cursor::match(Type type) const -> bool {
@@ -44,6 +44,8 @@ auto Cursor::previous() -> Token {
   return tokens_.at(current_ - 1);
 }
 
+auto Cursor::position() const -> std::size_t { return current_; }
+
 auto Cursor::synchronize() -> void {
   while (!is_at_end()) {
     if (match(TokenType::CLASS, TokenType::FUN, TokenType::VAR, TokenType::FOR,
@@ -59,4 +61,10 @@ auto Cursor::synchronize() -> void {
     }
   }
 }
+
+auto Cursor::report(Error const& error) -> void { errors_.push_back(error); }
+
+auto Cursor::error_count() const -> std::size_t { return errors_.size(); }
+
+auto Cursor::errors() const -> std::vector<Error> const& { return errors_; }
 }  // namespace Parser
@@ -14,9 +14,10 @@ namespace Parser {
 class Cursor {
   std::vector<Token> const& tokens_;
   std::size_t current_;
+  std::vector<Error> errors_;
 
  public:
-  explicit Cursor(std::vector<Token> const& tokens);
+  explicit Cursor(std::vector<Token> const& tokens, std::size_t position = 0);
 
   template <typename Type>
   [[nodiscard]] auto match(Type type) const -> bool;
@@ -34,7 +35,17 @@ class Cursor {
 
   auto previous() -> Token;
 
+  // Index of the next token to be taken.
+  [[nodiscard]] auto position() const -> std::size_t;
+
   auto synchronize() -> void;
+
+  // Records an error the parser recovers from.
+  auto report(Error const& error) -> void;
+
+  [[nodiscard]] auto error_count() const -> std::size_t;
+
+  [[nodiscard]] auto errors() const -> std::vector<Error> const&;
 };
 }  // namespace Parser
 
@@ -13,8 +13,8 @@ Error::Error(std::size_t line, std::string const& where,
              std::string const& message)
     : line_(line), where_(where), message_(message), tokens_{} {}
 
-auto Error::report() const -> void {
-  std::cerr << "[line " << line_ << "] Parsing error " << where_ << ": "
+auto Error::report(std::ostream& out) const -> void {
+  out << "[line " << line_ << "] Parsing error " << where_ << ": "
             << message_ << '\n';
 }
 
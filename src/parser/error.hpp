@@ -15,7 +15,9 @@ struct Error : CompileTimeError {
   std::string where_;
   std::string message_;
 
-  auto report() const -> void final;
+  using CompileTimeError::report;
+
+  auto report(std::ostream& out) const -> void final;
 
  private:
   std::vector<Token> tokens_;
@@ -36,6 +36,18 @@ auto primary(Cursor& cursor) -> Expression {
   if (cursor.match(TokenType::THIS)) {
     return ThisExpression{cursor.take()};
   }
+  if (cursor.match(TokenType::SUPER)) {
+    Token const keyword{cursor.take()};
+    cursor.take(TokenType::DOT);
+    return SuperExpression{keyword, cursor.take(TokenType::IDENTIFIER)};
+  }
+  if (cursor.match(TokenType::LEFT_BRACKET)) {
+    Token const bracket{cursor.peek()};
+    return ListExpression{
+        bracket, Utils::parse_delimited_list<Expression>(
+                     cursor, expression, TokenType::LEFT_BRACKET,
+                     TokenType::RIGHT_BRACKET)};
+  }
 
   throw error(cursor.peek(), "Expected expression.");
 }
@@ -61,6 +73,11 @@ auto call(Cursor& cursor) -> Expression {
 
       Token const name{cursor.take(TokenType::IDENTIFIER)};
       expr = Box{GetExpression{name, expr}};
+    } else if (cursor.match(TokenType::LEFT_BRACKET)) {
+      cursor.take();
+      Expression const index{expression(cursor)};
+      Token const closing{cursor.take(TokenType::RIGHT_BRACKET)};
+      expr = IndexExpression{expr, closing, index};
     } else {
       break;
     }
@@ -74,6 +91,14 @@ auto unary(Cursor& cursor) -> Expression {
     Token const op{cursor.take()};
     return UnaryExpression{op, unary(cursor)};
   }
+  if (cursor.match(TokenType::SPAWN)) {
+    Token const keyword{cursor.take()};
+    Expression const expr{call(cursor)};
+    if (!std::holds_alternative<Box<CallExpression>>(expr)) {
+      throw error(keyword, "Expected a call after 'spawn'.");
+    }
+    return SpawnExpression{keyword, expr};
+  }
 
   return call(cursor);
 }
@@ -139,10 +164,13 @@ auto assignment(Cursor& cursor) -> Expression {
       return AssignmentExpression{var->name_, value};
     } else if (auto const get{std::get_if<Box<GetExpression>>(&expr)}) {
       return SetExpression{(*get)->name_, (*get)->object_, value};
+    } else if (auto const index{std::get_if<Box<IndexExpression>>(&expr)}) {
+      return IndexSetExpression{(*index)->object_, (*index)->bracket_,
+                                (*index)->index_, value};
     }
 
     // Do not throw, just report the error
-    error(equals, "Invalid assignment target.").report();
+    cursor.report(error(equals, "Invalid assignment target."));
   }
 
   return expr;
@@ -5,10 +5,30 @@
 #include "../types/statement.hpp"
 #include "../types/token.hpp"
 #include "./cursor.hpp"
+#include "./error.hpp"
 #include "./statements.hpp"
 
 namespace Parser {
 auto parse(std::vector<Token> const& tokens) -> std::vector<Statement> {
+  bool had_error{false};
+  return parse(tokens, had_error);
+}
+
+auto parse(std::vector<Token> const& tokens, bool& had_error)
+    -> std::vector<Statement> {
+  std::vector<Error> errors{};
+  std::vector<Statement> statements{parse(tokens, errors)};
+
+  for (Error const& error : errors) {
+    error.report();
+  }
+  had_error = !errors.empty();
+
+  return statements;
+}
+
+auto parse(std::vector<Token> const& tokens, std::vector<Error>& errors)
+    -> std::vector<Statement> {
   Cursor cursor(tokens);
 
   std::vector<Statement> statements{};
@@ -17,6 +37,8 @@ auto parse(std::vector<Token> const& tokens) -> std::vector<Statement> {
     statements.push_back(Statements::declaration(cursor));
   }
 
+  errors = cursor.errors();
+
   return statements;
 }
 }  // namespace Parser
@@ -5,9 +5,18 @@
 
 #include "../types/statement.hpp"
 #include "../types/token.hpp"
+#include "./error.hpp"
 
 namespace Parser {
 auto parse(std::vector<Token> const& tokens) -> std::vector<Statement>;
+
+// As above, also setting had_error if any parsing error was reported.
+auto parse(std::vector<Token> const& tokens, bool& had_error)
+    -> std::vector<Statement>;
+
+// Collects the errors the parser recovered from instead of reporting them.
+auto parse(std::vector<Token> const& tokens, std::vector<Error>& errors)
+    -> std::vector<Statement>;
 }  // namespace Parser
 
 #endif
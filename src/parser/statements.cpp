@@ -1,5 +1,9 @@
 #include "./statements.hpp"
 
+#include <algorithm>
+#include <iterator>
+#include <variant>
+
 #include "../types/expression.hpp"
 #include "../types/statement.hpp"
 #include "./cursor.hpp"
@@ -27,13 +31,12 @@ auto expression_statement(Cursor& cursor) -> Statement {
 }
 
 auto block_statement(Cursor& cursor) -> Statement {
-  Token const keyword{cursor.take()};
-  assert(keyword.type_ == TokenType::LEFT_BRACE);
-  static_cast<void>(keyword);
+  // Function bodies are parsed as blocks without checking for the brace first
+  cursor.take(TokenType::LEFT_BRACE);
 
   std::vector<Statement> statements{};
 
-  while (!cursor.match(TokenType::RIGHT_BRACE)) {
+  while (!cursor.match(TokenType::RIGHT_BRACE) && !cursor.is_at_end()) {
     statements.push_back(declaration(cursor));
   }
 
@@ -65,19 +68,17 @@ auto if_statement(Cursor& cursor) -> Statement {
 auto while_statement(Cursor& cursor) -> Statement {
   Token const keyword{cursor.take()};
   assert(keyword.type_ == TokenType::WHILE);
-  static_cast<void>(keyword);
 
   cursor.take(TokenType::LEFT_PAREN);
   Expression const condition{Expressions::expression(cursor)};
   cursor.take(TokenType::RIGHT_PAREN);
 
-  return Box{WhileStatement{condition, statement(cursor)}};
+  return Box{WhileStatement{keyword, condition, statement(cursor)}};
 }
 
 auto for_statement(Cursor& cursor) -> Statement {
   Token const keyword{cursor.take()};
   assert(keyword.type_ == TokenType::FOR);
-  static_cast<void>(keyword);
 
   cursor.take(TokenType::LEFT_PAREN);
 
@@ -85,7 +86,6 @@ auto for_statement(Cursor& cursor) -> Statement {
   if (cursor.match(TokenType::SEMICOLON)) {
     cursor.take();
   } else if (cursor.match(TokenType::VAR)) {
-    cursor.take();
     initializer = variable_declaration(cursor);
   } else {
     initializer = expression_statement(cursor);
@@ -107,6 +107,7 @@ auto for_statement(Cursor& cursor) -> Statement {
   return Box{BlockStatement{
       {initializer,
        WhileStatement{
+           keyword,
            std::holds_alternative<std::monostate>(condition)
                ? LiteralExpression{true}
                : condition,
@@ -124,6 +125,17 @@ auto return_statement(Cursor& cursor) -> Statement {
   return ReturnStatement{keyword, value};
 }
 
+auto yield_statement(Cursor& cursor) -> Statement {
+  Token const keyword{cursor.take()};
+  assert(keyword.type_ == TokenType::YIELD);
+
+  Expression const value{cursor.match(TokenType::SEMICOLON)
+                             ? std::monostate{}
+                             : Expressions::expression(cursor)};
+  cursor.take(TokenType::SEMICOLON);
+  return YieldStatement{keyword, value};
+}
+
 auto statement(Cursor& cursor) -> Statement {
   if (cursor.match(TokenType::PRINT)) {
     return print_statement(cursor);
@@ -137,6 +149,9 @@ auto statement(Cursor& cursor) -> Statement {
   if (cursor.match(TokenType::RETURN)) {
     return return_statement(cursor);
   }
+  if (cursor.match(TokenType::YIELD)) {
+    return yield_statement(cursor);
+  }
   if (cursor.match(TokenType::WHILE)) {
     return while_statement(cursor);
   }
@@ -153,6 +168,33 @@ auto parse_params(Cursor& cursor) -> std::vector<Token> {
   });
 }
 
+// Whether a statement yields. Yields in nested functions belong to those.
+struct Yields {
+  auto operator()(YieldStatement const&) const -> bool { return true; }
+
+  auto operator()(Box<BlockStatement> const& stmt) const -> bool {
+    return std::any_of(std::begin(stmt->statements_),
+                       std::end(stmt->statements_),
+                       [this](Statement const& statement) {
+                         return std::visit(*this, statement);
+                       });
+  }
+
+  auto operator()(Box<IfStatement> const& stmt) const -> bool {
+    return std::visit(*this, stmt->then_branch_) ||
+           std::visit(*this, stmt->else_branch_);
+  }
+
+  auto operator()(Box<WhileStatement> const& stmt) const -> bool {
+    return std::visit(*this, stmt->body_);
+  }
+
+  template <typename T>
+  auto operator()(T const&) const -> bool {
+    return false;
+  }
+};
+
 enum class FunctionType { Function, Method };
 
 auto function_declaration(Cursor& cursor, FunctionType type) -> Statement {
@@ -167,8 +209,9 @@ auto function_declaration(Cursor& cursor, FunctionType type) -> Statement {
   std::vector<Token> const parameters{parse_params(cursor)};
 
   std::vector<Statement> const body{block_statement(cursor)};
+  bool const generator{std::visit(Yields{}, body.front())};
 
-  return Box{FunctionStatement{name, parameters, body}};
+  return Box{FunctionStatement{name, parameters, body, generator}};
 }
 
 auto class_declaration(Cursor& cursor) -> Statement {
@@ -178,18 +221,24 @@ auto class_declaration(Cursor& cursor) -> Statement {
 
   Token const name{cursor.take(TokenType::IDENTIFIER)};
 
+  Expression superclass{};
+  if (cursor.match(TokenType::LESS)) {
+    cursor.take();
+    superclass = VariableExpression{cursor.take(TokenType::IDENTIFIER)};
+  }
+
   cursor.take(TokenType::LEFT_BRACE);
 
   std::vector<Box<FunctionStatement>> methods{};
 
-  while (!cursor.match(TokenType::RIGHT_BRACE)) {
+  while (!cursor.match(TokenType::RIGHT_BRACE) && !cursor.is_at_end()) {
     methods.emplace_back(*std::get<Box<FunctionStatement>>(
         function_declaration(cursor, FunctionType::Method)));
   }
 
   cursor.take(TokenType::RIGHT_BRACE);
 
-  return Box{ClassStatement{name, methods}};
+  return Box{ClassStatement{name, superclass, methods}};
 }
 
 auto variable_declaration(Cursor& cursor) -> Statement {
@@ -223,7 +272,7 @@ auto declaration(Cursor& cursor) -> Statement {
     }
     return statement(cursor);
   } catch (Error const& e) {
-    e.report();
+    cursor.report(e);
     cursor.synchronize();
     return std::monostate{};
   }
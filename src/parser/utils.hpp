@@ -8,12 +8,13 @@
 
 namespace Parser::Utils {
 template <typename T, typename F>
-auto parse_parenthesized_list(Cursor& cursor, F const& f) -> std::vector<T> {
-  cursor.take(TokenType::LEFT_PAREN);
+auto parse_delimited_list(Cursor& cursor, F const& f, TokenType const open,
+                          TokenType const close) -> std::vector<T> {
+  cursor.take(open);
 
   std::vector<T> list{};
 
-  if (!cursor.match(TokenType::RIGHT_PAREN)) {
+  if (!cursor.match(close)) {
     list.push_back(f(cursor));
     while (cursor.match(TokenType::COMMA)) {
       cursor.take();
@@ -22,12 +23,19 @@ auto parse_parenthesized_list(Cursor& cursor, F const& f) -> std::vector<T> {
   }
 
   if (list.size() >= 255) {
-    error(cursor.peek(), "Can't have more than 255 constituents.").report();
+    cursor.report(
+        error(cursor.peek(), "Can't have more than 255 constituents."));
   }
 
-  cursor.take(TokenType::RIGHT_PAREN);
+  cursor.take(close);
 
   return list;
 }
+
+template <typename T, typename F>
+auto parse_parenthesized_list(Cursor& cursor, F const& f) -> std::vector<T> {
+  return parse_delimited_list<T>(cursor, f, TokenType::LEFT_PAREN,
+                                 TokenType::RIGHT_PAREN);
+}
 }  // namespace Parser::Utils
 #endif
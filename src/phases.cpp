@@ -0,0 +1,288 @@
+#include "./phases.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+#include <variant>
+#include <vector>
+
+#include "./memory.hpp"
+#include "./pool.hpp"
+#include "./trace.hpp"
+#include "./types/expression.hpp"
+#include "./types/statement.hpp"
+#include "./utils/box.hpp"
+
+namespace {
+auto name(Phases::Phase const phase) -> char const* {
+  switch (phase) {
+    case Phases::Phase::CACHE:
+      return "cache";
+    case Phases::Phase::SCAN:
+      return "scan";
+    case Phases::Phase::PARSE:
+      return "parse";
+    case Phases::Phase::RESOLVE:
+      return "resolve";
+    case Phases::Phase::INTERPRET:
+      return "interpret";
+  }
+  return "unknown";
+}
+
+// Counts the statements and expressions of a tree, but not the empty ones
+struct NodeCount {
+  std::size_t& nodes_;
+
+  template <typename... Ts>
+  auto operator()(std::variant<Ts...> const& variant) const -> void {
+    std::visit(*this, variant);
+  }
+
+  template <typename T>
+  auto operator()(Box<T> const& box) const -> void {
+    (*this)(*box);
+  }
+
+  template <typename T>
+  auto operator()(std::vector<T> const& elements) const -> void {
+    for (T const& element : elements) {
+      (*this)(element);
+    }
+  }
+
+  auto operator()(std::monostate) const -> void {}
+
+  auto operator()(LiteralExpression const&) const -> void { ++nodes_; }
+
+  auto operator()(ThisExpression const&) const -> void { ++nodes_; }
+
+  auto operator()(VariableExpression const&) const -> void { ++nodes_; }
+
+  auto operator()(AssignmentExpression const& expr) const -> void {
+    ++nodes_;
+    (*this)(expr.value_);
+  }
+
+  auto operator()(BinaryExpression const& expr) const -> void {
+    ++nodes_;
+    (*this)(expr.left_);
+    (*this)(expr.right_);
+  }
+
+  auto operator()(CallExpression const& expr) const -> void {
+    ++nodes_;
+    (*this)(expr.callee_);
+    (*this)(expr.arguments_);
+  }
+
+  auto operator()(GetExpression const& expr) const -> void {
+    ++nodes_;
+    (*this)(expr.object_);
+  }
+
+  auto operator()(GroupingExpression const& expr) const -> void {
+    ++nodes_;
+    (*this)(expr.expression_);
+  }
+
+  auto operator()(LogicalExpression const& expr) const -> void {
+    ++nodes_;
+    (*this)(expr.left_);
+    (*this)(expr.right_);
+  }
+
+  auto operator()(SetExpression const& expr) const -> void {
+    ++nodes_;
+    (*this)(expr.object_);
+    (*this)(expr.value_);
+  }
+
+  auto operator()(UnaryExpression const& expr) const -> void {
+    ++nodes_;
+    (*this)(expr.right_);
+  }
+
+  auto operator()(ListExpression const& expr) const -> void {
+    ++nodes_;
+    (*this)(expr.elements_);
+  }
+
+  auto operator()(IndexExpression const& expr) const -> void {
+    ++nodes_;
+    (*this)(expr.object_);
+    (*this)(expr.index_);
+  }
+
+  auto operator()(IndexSetExpression const& expr) const -> void {
+    ++nodes_;
+    (*this)(expr.object_);
+    (*this)(expr.index_);
+    (*this)(expr.value_);
+  }
+
+  auto operator()(SpawnExpression const& expr) const -> void {
+    ++nodes_;
+    (*this)(expr.call_);
+  }
+
+  auto operator()(SuperExpression const&) const -> void { ++nodes_; }
+
+  auto operator()(ExpressionStatement const& stmt) const -> void {
+    ++nodes_;
+    (*this)(stmt.expression_);
+  }
+
+  auto operator()(PrintStatement const& stmt) const -> void {
+    ++nodes_;
+    (*this)(stmt.expression_);
+  }
+
+  auto operator()(ReturnStatement const& stmt) const -> void {
+    ++nodes_;
+    (*this)(stmt.value_);
+  }
+
+  auto operator()(YieldStatement const& stmt) const -> void {
+    ++nodes_;
+    (*this)(stmt.value_);
+  }
+
+  auto operator()(VariableStatement const& stmt) const -> void {
+    ++nodes_;
+    (*this)(stmt.initializer_);
+  }
+
+  auto operator()(BlockStatement const& stmt) const -> void {
+    ++nodes_;
+    (*this)(stmt.statements_);
+  }
+
+  auto operator()(FunctionStatement const& stmt) const -> void {
+    ++nodes_;
+    (*this)(stmt.body_);
+  }
+
+  auto operator()(ClassStatement const& stmt) const -> void {
+    ++nodes_;
+    (*this)(stmt.superclass_);
+    (*this)(stmt.methods_);
+  }
+
+  auto operator()(IfStatement const& stmt) const -> void {
+    ++nodes_;
+    (*this)(stmt.condition_);
+    (*this)(stmt.then_branch_);
+    (*this)(stmt.else_branch_);
+  }
+
+  auto operator()(WhileStatement const& stmt) const -> void {
+    ++nodes_;
+    (*this)(stmt.condition_);
+    (*this)(stmt.body_);
+  }
+};
+}  // namespace
+
+namespace Phases {
+Report::Scope::Scope(Report* const report, Phase const phase)
+    : report_{report},
+      phase_{phase},
+      traced_{Trace::active.load(std::memory_order_relaxed) != nullptr},
+      allocations_{0},
+      allocated_bytes_{0},
+      live_bytes_{0},
+      pool_hits_{0},
+      pool_misses_{0} {
+  if (report_) {
+    allocations_ = Memory::allocations();
+    allocated_bytes_ = Memory::allocated_bytes();
+    live_bytes_ = Memory::live_bytes();
+    Memory::reset_peak();
+    pool_hits_ = Pool::hits();
+    pool_misses_ = Pool::misses();
+  }
+  if (report_ || traced_) {
+    start_ = std::chrono::steady_clock::now();
+  }
+}
+
+Report::Scope::~Scope() {
+  if (!report_ && !traced_) {
+    return;
+  }
+  auto const end{std::chrono::steady_clock::now()};
+  if (traced_) {
+    Trace::phase(name(phase_), start_, end);
+  }
+  if (!report_) {
+    return;
+  }
+  std::int64_t const peak{Memory::peak_live_bytes() - live_bytes_};
+  auto const wall_time{end - start_};
+  report_->phases_.push_back(
+      {phase_, std::chrono::duration_cast<std::chrono::nanoseconds>(wall_time),
+       Memory::allocations() - allocations_,
+       Memory::allocated_bytes() - allocated_bytes_,
+       static_cast<std::uint64_t>(std::max<std::int64_t>(peak, 0)),
+       Pool::hits() - pool_hits_, Pool::misses() - pool_misses_});
+}
+
+auto Report::count(std::vector<Statement> const& statements) -> void {
+  nodes_ = 0;
+  NodeCount{nodes_}(statements);
+}
+
+auto Report::write_text(std::ostream& out) const -> void {
+  std::ios_base::fmtflags const flags{out.flags()};
+  out << std::left << std::setw(10) << "phase" << std::right << std::setw(12)
+      << "time (ms)" << std::setw(13) << "allocations" << std::setw(18)
+      << "allocated (B)" << std::setw(18) << "peak heap (B)" << '\n';
+  for (Measurement const& measurement : phases_) {
+    double const milliseconds{
+        std::chrono::duration<double, std::milli>{measurement.wall_time_}
+            .count()};
+    out << std::left << std::setw(10) << name(measurement.phase_)
+        << std::right << std::setw(12) << std::fixed << std::setprecision(3)
+        << milliseconds << std::setw(13) << measurement.allocations_
+        << std::setw(18) << measurement.allocated_bytes_ << std::setw(18)
+        << measurement.peak_heap_bytes_ << '\n';
+  }
+  std::uint64_t hits{0};
+  std::uint64_t misses{0};
+  for (Measurement const& measurement : phases_) {
+    hits += measurement.pool_hits_;
+    misses += measurement.pool_misses_;
+  }
+  if (hits + misses > 0) {
+    out << "environment pool: " << hits << " hits, " << misses << " misses ("
+        << std::fixed << std::setprecision(1)
+        << 100.0 * static_cast<double>(hits) /
+               static_cast<double>(hits + misses)
+        << "% hit rate)\n";
+  }
+  out << "tokens: " << tokens_ << ", nodes: " << nodes_
+      << ", resolved names: " << resolved_names_ << '\n';
+  out.flags(flags);
+}
+
+auto Report::write_json(std::ostream& out) const -> void {
+  out << "{\"phases\": [";
+  for (std::size_t i = 0; i < phases_.size(); ++i) {
+    Measurement const& measurement{phases_[i]};
+    out << (i == 0 ? "" : ", ") << "{\"name\": \"" << name(measurement.phase_)
+        << "\", \"wall_ns\": " << measurement.wall_time_.count()
+        << ", \"allocations\": " << measurement.allocations_
+        << ", \"allocated_bytes\": " << measurement.allocated_bytes_
+        << ", \"peak_heap_bytes\": " << measurement.peak_heap_bytes_
+        << ", \"pool_hits\": " << measurement.pool_hits_
+        << ", \"pool_misses\": " << measurement.pool_misses_ << '}';
+  }
+  out << "], \"tokens\": " << tokens_ << ", \"nodes\": " << nodes_
+      << ", \"resolved_names\": " << resolved_names_ << "}\n";
+}
+}  // namespace Phases
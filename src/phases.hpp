@@ -0,0 +1,74 @@
+#ifndef LOX_PHASES
+#define LOX_PHASES
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "./types/statement.hpp"
+
+/**
+ * Where the time and the memory of running a script went, phase by phase.
+ * Only measured when asked for: otherwise, a phase costs a null check and a
+ * relaxed load.
+ */
+namespace Phases {
+enum class Phase { CACHE, SCAN, PARSE, RESOLVE, INTERPRET };
+
+struct Measurement {
+  Phase phase_;
+  std::chrono::nanoseconds wall_time_;
+  std::uint64_t allocations_;
+  std::uint64_t allocated_bytes_;
+  // The most the phase had allocated and not freed at once
+  std::uint64_t peak_heap_bytes_;
+  // Allocations the pool served from its free lists, and those it did not
+  std::uint64_t pool_hits_;
+  std::uint64_t pool_misses_;
+};
+
+/**
+ * Measurements of the phases, in the order they ran, and the sizes of what
+ * they produced. Allocations are those of the thread running the phase, so
+ * they leave out tasks running on other threads.
+ */
+class Report {
+ public:
+  // Measures a phase for as long as it lives, and traces it when tracing
+  class Scope {
+   public:
+    Scope(Report* report, Phase phase);
+
+    Scope(Scope const&) = delete;
+    auto operator=(Scope const&) -> Scope& = delete;
+
+    ~Scope();
+
+   private:
+    Report* report_;
+    Phase phase_;
+    bool traced_;
+    std::chrono::steady_clock::time_point start_;
+    std::uint64_t allocations_;
+    std::uint64_t allocated_bytes_;
+    std::int64_t live_bytes_;
+    std::uint64_t pool_hits_;
+    std::uint64_t pool_misses_;
+  };
+
+  auto count(std::vector<Statement> const& statements) -> void;
+
+  auto write_text(std::ostream& out) const -> void;
+
+  auto write_json(std::ostream& out) const -> void;
+
+  std::vector<Measurement> phases_;
+  std::size_t tokens_{0};
+  std::size_t nodes_{0};
+  std::size_t resolved_names_{0};
+};
+}  // namespace Phases
+
+#endif
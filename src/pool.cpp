@@ -0,0 +1,85 @@
+#include "./pool.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace {
+constexpr std::size_t CLASSES{Pool::MAX_SIZE / Pool::GRANULE};
+
+struct Block {
+  Block* next_;
+};
+
+// Plain data, which stays usable while the thread exits
+thread_local Block* free_lists[CLASSES]{};
+thread_local std::size_t free_counts[CLASSES]{};
+thread_local bool exited{false};
+thread_local std::uint64_t served{0};
+thread_local std::uint64_t passed_on{0};
+
+// Hands the free blocks of the thread back to the heap as it exits. Blocks
+// freed after that go straight back as well.
+struct Reaper {
+  bool armed_{false};
+
+  ~Reaper() {
+    exited = true;
+    for (std::size_t size_class = 0; size_class < CLASSES; ++size_class) {
+      while (Block* const block{free_lists[size_class]}) {
+        free_lists[size_class] = block->next_;
+        ::operator delete(block, (size_class + 1) * Pool::GRANULE);
+      }
+      free_counts[size_class] = 0;
+    }
+  }
+};
+
+thread_local Reaper reaper{};
+
+auto size_class(std::size_t const size) -> std::size_t {
+  return size == 0 ? 0 : (size - 1) / Pool::GRANULE;
+}
+}  // namespace
+
+namespace Pool {
+// Out of line, as fibers may move to another thread between two calls
+[[gnu::noinline]] auto allocate(std::size_t const size) -> void* {
+  if (size > MAX_SIZE) {
+    return ::operator new(size);
+  }
+  std::size_t const index{size_class(size)};
+  if (Block* const block{free_lists[index]}) {
+    free_lists[index] = block->next_;
+    --free_counts[index];
+    ++served;
+    return block;
+  }
+  ++passed_on;
+  return ::operator new((index + 1) * GRANULE);
+}
+
+[[gnu::noinline]] auto deallocate(void* const memory,
+                                  std::size_t const size) noexcept -> void {
+  if (!memory) {
+    return;
+  }
+  if (size > MAX_SIZE) {
+    ::operator delete(memory, size);
+    return;
+  }
+  std::size_t const index{size_class(size)};
+  if (exited || free_counts[index] >= KEEP) {
+    ::operator delete(memory, (index + 1) * GRANULE);
+    return;
+  }
+  // Touched for the thread to free its blocks as it exits
+  reaper.armed_ = true;
+  free_lists[index] = new (memory) Block{free_lists[index]};
+  ++free_counts[index];
+}
+
+auto hits() -> std::uint64_t { return served; }
+
+auto misses() -> std::uint64_t { return passed_on; }
+}  // namespace Pool
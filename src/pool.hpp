@@ -0,0 +1,58 @@
+#ifndef LOX_POOL
+#define LOX_POOL
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+/**
+ * Free lists of small blocks, one per size class and per thread, which
+ * environments, their variables and the tables of their variables are
+ * allocated from. Blocks freed by a call are taken again by the next one on
+ * the same thread, without going through malloc. A block freed on another
+ * thread than the one that took it joins the lists of that other thread.
+ */
+namespace Pool {
+// Sizes are rounded up to a multiple of the granule
+constexpr std::size_t GRANULE{16};
+// Larger blocks go straight to operator new
+constexpr std::size_t MAX_SIZE{256};
+// Free blocks a thread keeps of each size, so that what a deep recursion
+// frees goes back to the heap
+constexpr std::size_t KEEP{256};
+
+auto allocate(std::size_t size) -> void*;
+
+auto deallocate(void* memory, std::size_t size) noexcept -> void;
+
+// Allocations of the calling thread that the pool served, and those it
+// passed on to operator new for want of a free block of their size
+auto hits() -> std::uint64_t;
+
+auto misses() -> std::uint64_t;
+
+template <typename T>
+struct Allocator {
+  using value_type = T;
+
+  Allocator() = default;
+
+  template <typename U>
+  Allocator(Allocator<U> const&) {}
+
+  auto allocate(std::size_t const n) -> T* {
+    return static_cast<T*>(Pool::allocate(n * sizeof(T)));
+  }
+
+  auto deallocate(T* const memory, std::size_t const n) noexcept -> void {
+    Pool::deallocate(memory, n * sizeof(T));
+  }
+
+  template <typename U>
+  auto operator==(Allocator<U> const&) const -> bool {
+    return true;
+  }
+};
+}  // namespace Pool
+
+#endif
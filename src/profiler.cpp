@@ -0,0 +1,278 @@
+#include "./profiler.hpp"
+
+#include <pthread.h>
+#include <sys/time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "./types/class.hpp"
+#include "./types/function.hpp"
+#include "./types/native.hpp"
+
+namespace Profiler {
+namespace {
+// Frames of a sample beyond these, from the root, are left out
+constexpr std::size_t MAX_FRAMES{128};
+constexpr std::size_t MAX_SAMPLE_SIZE{std::size_t{4} << 10};
+constexpr std::size_t BUFFER_SIZE{std::size_t{1} << 20};
+constexpr std::chrono::milliseconds COLLECT_INTERVAL{20};
+
+/**
+ * Where the signal handler leaves samples, each as its size then its folded
+ * stack, until the collector takes them. Handlers on different threads take
+ * turns through a spin lock, which the collector only takes with the signal
+ * blocked, so a handler never waits on the thread it interrupted.
+ */
+struct Buffer {
+  std::atomic_flag lock_{};
+  std::size_t size_{0};
+  std::uint64_t dropped_{0};
+  char data_[BUFFER_SIZE];
+};
+
+thread_local Stack* active{nullptr};
+
+std::atomic<Buffer*> buffer{nullptr};
+// Handlers past their check of the buffer
+std::atomic<int> handlers{0};
+
+// Only what is safe in a signal handler from here on: no allocation, no
+// locks but the spin lock
+class Writer {
+ public:
+  Writer(char* const begin, char* const end) : out_{begin}, end_{end} {}
+
+  auto text(std::string_view const text) -> void {
+    std::size_t const size{
+        std::min(text.size(), static_cast<std::size_t>(end_ - out_))};
+    std::memcpy(out_, text.data(), size);
+    out_ += size;
+  }
+
+  auto number(std::size_t value) -> void {
+    char digits[24];
+    char* digit{std::end(digits)};
+    do {
+      *--digit = static_cast<char>('0' + value % 10);
+      value /= 10;
+    } while (value != 0);
+    text({digit, static_cast<std::size_t>(std::end(digits) - digit)});
+  }
+
+  [[nodiscard]] auto end() const -> char* { return out_; }
+
+ private:
+  char* out_;
+  char* end_;
+};
+
+auto fold(Stack const* const stack, Writer& out) -> void {
+  if (!stack) {
+    out.text("<runtime>");
+    return;
+  }
+
+  struct Entry {
+    std::string_view name_;
+    std::size_t line_;
+  };
+  // Innermost first, as the shadow stacks link them
+  Entry entries[MAX_FRAMES];
+  std::size_t count{0};
+  bool truncated{false};
+  for (Stack const* current{stack}; current && !truncated;
+       current = current->parent_) {
+    for (Frame const* frame{current->top_}; frame; frame = frame->caller_) {
+      if (count == MAX_FRAMES) {
+        truncated = true;
+        break;
+      }
+      entries[count++] = {frame->name_, frame->line_};
+    }
+    if (count == MAX_FRAMES) {
+      truncated = true;
+      break;
+    }
+    entries[count++] = {current->root_, current->line_};
+  }
+
+  if (truncated) {
+    out.text("[truncated];");
+  }
+  for (std::size_t i = count; i-- > 0;) {
+    out.text(entries[i].name_);
+    if (entries[i].line_ != 0) {
+      out.text(":");
+      out.number(entries[i].line_);
+    }
+    if (i != 0) {
+      out.text(";");
+    }
+  }
+}
+
+auto on_sample(int) -> void {
+  int const saved_errno{errno};
+  handlers.fetch_add(1, std::memory_order_acquire);
+  if (Buffer* const target{buffer.load(std::memory_order_acquire)}) {
+    char sample[MAX_SAMPLE_SIZE];
+    Writer out{sample, std::end(sample)};
+    fold(active, out);
+    auto const size{static_cast<std::uint32_t>(out.end() - sample)};
+
+    while (target->lock_.test_and_set(std::memory_order_acquire)) {
+    }
+    if (target->size_ + sizeof(size) + size <= BUFFER_SIZE) {
+      std::memcpy(target->data_ + target->size_, &size, sizeof(size));
+      std::memcpy(target->data_ + target->size_ + sizeof(size), sample, size);
+      target->size_ += sizeof(size) + size;
+    } else {
+      ++target->dropped_;
+    }
+    target->lock_.clear(std::memory_order_release);
+  }
+  handlers.fetch_sub(1, std::memory_order_release);
+  errno = saved_errno;
+}
+
+auto set_timer(std::chrono::microseconds const interval) -> void {
+  itimerval timer{};
+  timer.it_interval.tv_sec = static_cast<time_t>(interval.count() / 1000000);
+  timer.it_interval.tv_usec =
+      static_cast<suseconds_t>(interval.count() % 1000000);
+  timer.it_value = timer.it_interval;
+  setitimer(ITIMER_PROF, &timer, nullptr);
+}
+}  // namespace
+
+auto name(Object const& callee) -> std::string_view {
+  if (auto const function{std::get_if<Box<LoxFunction>>(&callee)}) {
+    return (*function)->declaration_->name_.lexeme_;
+  }
+  if (auto const klass{std::get_if<Box<LoxClass>>(&callee)}) {
+    return (*klass)->name_;
+  }
+  if (auto const native{
+          std::get_if<std::shared_ptr<NativeFunction>>(&callee)}) {
+    return (*native)->name_;
+  }
+  return "<unknown>";
+}
+
+[[gnu::noinline]] auto activate(Stack* const stack) -> Stack* {
+  return std::exchange(active, stack);
+}
+
+struct Sampler::State {
+  Buffer buffer_{};
+  // Only touched by the collector until it is joined
+  std::vector<char> taken_{};
+  std::map<std::string, std::uint64_t> stacks_{};
+  std::uint64_t dropped_{0};
+
+  std::mutex mutex_{};
+  std::condition_variable stopped_{};
+  bool stopping_{false};
+  std::thread collector_{};
+
+  // Moves the samples in the buffer to the counts of their stacks
+  auto collect() -> void {
+    while (buffer_.lock_.test_and_set(std::memory_order_acquire)) {
+    }
+    taken_.assign(buffer_.data_, buffer_.data_ + buffer_.size_);
+    buffer_.size_ = 0;
+    dropped_ += std::exchange(buffer_.dropped_, 0);
+    buffer_.lock_.clear(std::memory_order_release);
+
+    for (std::size_t offset = 0; offset < taken_.size();) {
+      std::uint32_t size{0};
+      std::memcpy(&size, taken_.data() + offset, sizeof(size));
+      offset += sizeof(size);
+      ++stacks_[std::string{taken_.data() + offset, size}];
+      offset += size;
+    }
+  }
+
+  auto run() -> void {
+    std::unique_lock lock{mutex_};
+    while (!stopping_) {
+      stopped_.wait_for(lock, COLLECT_INTERVAL);
+      collect();
+    }
+  }
+};
+
+Sampler::Sampler(std::chrono::microseconds const interval)
+    : state_{std::make_unique<State>()} {
+  // The collector must never be interrupted by a sample, as it takes the
+  // lock the handler spins on. Threads inherit the signal mask.
+  sigset_t profiling{};
+  sigemptyset(&profiling);
+  sigaddset(&profiling, SIGPROF);
+  sigset_t previous{};
+  pthread_sigmask(SIG_BLOCK, &profiling, &previous);
+  state_->collector_ = std::thread{[state = state_.get()]() { state->run(); }};
+  pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+
+  buffer.store(&state_->buffer_, std::memory_order_release);
+  struct sigaction action{};
+  action.sa_handler = &on_sample;
+  action.sa_flags = SA_RESTART;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGPROF, &action, nullptr);
+  set_timer(interval);
+}
+
+Sampler::~Sampler() { stop(); }
+
+auto Sampler::stop() -> void {
+  if (!state_->collector_.joinable()) {
+    return;
+  }
+  set_timer(std::chrono::microseconds{0});
+  // A sample may still be pending: ignoring the signal discards it
+  struct sigaction action{};
+  action.sa_handler = SIG_IGN;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGPROF, &action, nullptr);
+  buffer.store(nullptr, std::memory_order_release);
+  while (handlers.load(std::memory_order_acquire) != 0) {
+    std::this_thread::yield();
+  }
+
+  {
+    std::lock_guard const lock{state_->mutex_};
+    state_->stopping_ = true;
+  }
+  state_->stopped_.notify_one();
+  state_->collector_.join();
+  state_->collect();
+}
+
+auto Sampler::write_folded(std::ostream& out) -> void {
+  stop();
+  for (auto const& [stack, count] : state_->stacks_) {
+    out << stack << ' ' << count << '\n';
+  }
+  if (state_->dropped_ != 0) {
+    out << "[dropped] " << state_->dropped_ << '\n';
+  }
+}
+}  // namespace Profiler
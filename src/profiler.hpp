@@ -0,0 +1,81 @@
+#ifndef LOX_PROFILER
+#define LOX_PROFILER
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string_view>
+
+#include "./types/object.hpp"
+
+/**
+ * A sampling profiler of Lox code. The interpreter keeps a shadow stack of
+ * the Lox calls in progress, which a SIGPROF handler reads in place at every
+ * sample, so that keeping it costs a few stores per call.
+ */
+namespace Profiler {
+// A call in progress, as samples see it
+struct Frame {
+  // What the callee is called, which outlives the call
+  std::string_view name_;
+  // Where the call is at, as far as the interpreter has said: 0 if unknown
+  std::size_t line_;
+  Frame* caller_;
+};
+
+// The calls in progress on one stack of the interpreter
+struct Stack {
+  // Names the code the stack starts with, e.g. "<script>"
+  char const* root_;
+  // Where the root is at, once it makes a call
+  std::size_t line_;
+  Frame* top_;
+  // The stack that was active when this one became so: for the body of a
+  // generator, the stack that resumed it
+  Stack* parent_;
+};
+
+// What samples call the callee: "<unknown>" for what cannot be called
+auto name(Object const& callee) -> std::string_view;
+
+/**
+ * Makes the stack the one the interpreter runs on the calling thread, as the
+ * signal handler finds it, and returns the one that was. Never inlined, as
+ * fibers move between threads.
+ */
+auto activate(Stack* stack) -> Stack*;
+
+/**
+ * Samples the process while it lives, at a rate of CPU time. Samples taken
+ * outside of the interpreter are put down to "<runtime>". Only one sampler
+ * may exist at a time.
+ */
+class Sampler {
+ public:
+  static constexpr std::chrono::microseconds DEFAULT_INTERVAL{1000};
+
+  explicit Sampler(std::chrono::microseconds interval = DEFAULT_INTERVAL);
+
+  Sampler(Sampler const&) = delete;
+  auto operator=(Sampler const&) -> Sampler& = delete;
+
+  ~Sampler();
+
+  // Stops sampling. Samples taken so far are kept.
+  auto stop() -> void;
+
+  /**
+   * Writes the samples as folded stacks, as flamegraph.pl reads them: one
+   * line per distinct stack, its frames from the root down separated by
+   * semicolons, then the number of samples.
+   */
+  auto write_folded(std::ostream& out) -> void;
+
+ private:
+  struct State;
+  std::unique_ptr<State> state_;
+};
+}  // namespace Profiler
+
+#endif
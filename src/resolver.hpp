@@ -1,8 +1,11 @@
+#ifndef LOX_RESOLVER
+#define LOX_RESOLVER
+
 #include <iostream>
 #include <unordered_map>
 #include <vector>
 
-#include "./interpreter.hpp"
+#include "./types/program.hpp"
 #include "./types/statement.hpp"
 #include "./utils/error.hpp"
 
@@ -14,21 +17,28 @@ struct Error : CompileTimeError {
   std::size_t line_;
   std::string message_;
 
-  auto report() const -> void final {
-    std::cerr << "[line " << line_ << "] Resolver error: " << message_ << '\n';
+  using CompileTimeError::report;
+
+  auto report(std::ostream& out) const -> void final {
+    out << "[line " << line_ << "] Resolver error: " << message_ << '\n';
   }
 };
 
-auto error(std::size_t line, std::string const& message) -> Error {
+inline auto error(std::size_t line, std::string const& message) -> Error {
   return Error{line, message};
 }
 }  // namespace Resolver
 
 class NameResolver {
  public:
-  NameResolver(std::unordered_map<Token, std::size_t>& resolution)
+  explicit NameResolver(std::unordered_map<Token, std::size_t>& resolution)
+      : NameResolver(resolution, {}) {}
+
+  // Resolves code that comes after the declaration of the given globals.
+  NameResolver(std::unordered_map<Token, std::size_t>& resolution,
+               std::unordered_map<std::string, bool> globals)
       : resolution_{resolution},
-        scopes_{{}},  // TODO add global names here
+        scopes_{std::move(globals)},
         current_function_type_{FunctionType::NONE},
         current_class_type_{ClassType::NONE} {}
 
@@ -61,6 +71,15 @@ class NameResolver {
     resolve(stmt.value_);
   }
 
+  auto operator()(YieldStatement const& stmt) -> void {
+    if (current_function_type_ == FunctionType::NONE) {
+      throw Resolver::error(stmt.keyword_.line_,
+                            "Can't yield from top-level code.");
+    }
+
+    resolve(stmt.value_);
+  }
+
   auto operator()(VariableStatement const& stmt) -> void {
     declare(stmt.name_);
     resolve(stmt.initializer_);
@@ -87,15 +106,29 @@ class NameResolver {
     declare(stmt->name_);
     define(stmt->name_);
 
-    begin_scope();
-    scopes_.back()["this"] = true;
+    auto const superclass{
+        std::get_if<VariableExpression>(&stmt->superclass_)};
+    if (superclass) {
+      if (superclass->name_.lexeme_ == stmt->name_.lexeme_) {
+        throw Resolver::error(superclass->name_.line_,
+                              "A class can't inherit from itself.");
+      }
+      current_class_type_ = ClassType::SUBCLASS;
+      resolve(stmt->superclass_);
+
+      // Methods find the superclass around them, as calls bind this
+      begin_scope();
+      scopes_.back()["super"] = true;
+    }
 
     for (Box<FunctionStatement> const& method : stmt->methods_) {
       FunctionType const declaration{FunctionType::METHOD};
       resolve_function(*method, declaration);
     }
 
-    end_scope();
+    if (superclass) {
+      end_scope();
+    }
 
     current_class_type_ = enclosing_class;
   }
@@ -172,13 +205,56 @@ class NameResolver {
     resolve(expr->object_);
   }
 
+  auto operator()(Box<ListExpression> const& expr) -> void {
+    for (Expression const& element : expr->elements_) {
+      resolve(element);
+    }
+  }
+
+  auto operator()(Box<IndexExpression> const& expr) -> void {
+    resolve(expr->object_);
+    resolve(expr->index_);
+  }
+
+  auto operator()(Box<IndexSetExpression> const& expr) -> void {
+    resolve(expr->object_);
+    resolve(expr->index_);
+    resolve(expr->value_);
+  }
+
   auto operator()(Box<UnaryExpression> const& expr) -> void {
     resolve(expr->right_);
   }
 
+  auto operator()(Box<SpawnExpression> const& expr) -> void {
+    resolve(expr->call_);
+  }
+
+  auto operator()(Box<SuperExpression> const& expr) -> void {
+    if (current_class_type_ == ClassType::NONE) {
+      throw Resolver::error(expr->keyword_.line_,
+                            "Can't use 'super' outside of a class.");
+    }
+    if (current_class_type_ != ClassType::SUBCLASS) {
+      throw Resolver::error(expr->keyword_.line_,
+                            "Can't use 'super' in a class with no superclass.");
+    }
+
+    resolve_local(expr->keyword_);
+    // The method found on super is bound to this, which the name of the
+    // method resolves to
+    Token this_keyword{expr->method_};
+    this_keyword.lexeme_ = "this";
+    resolve_local(this_keyword);
+  }
+
  private:
   enum class FunctionType { NONE, FUNCTION, METHOD };
-  enum class ClassType { NONE, CLASS };
+  enum class ClassType { NONE, CLASS, SUBCLASS };
+
+  // That of the globals, the outermost. Builtins are globals too, found by
+  // the slot of their name like the others.
+  static constexpr std::size_t GLOBAL_SCOPES{1};
 
   auto begin_scope() -> void { scopes_.emplace_back(); }
 
@@ -200,15 +276,50 @@ class NameResolver {
     if (!scopes_.empty()) {
       scopes_.back()[name.lexeme_] = true;
     }
+    // Declarations of globals define them in their slot
+    if (scopes_.size() == GLOBAL_SCOPES) {
+      resolution_[name] = GLOBAL + global_slot(name.lexeme_);
+    }
   }
 
   auto resolve_local(Token const& name) -> void {
-    for (auto scope = scopes_.crbegin(); scope != scopes_.crend(); ++scope) {
-      if (scope->find(name.lexeme_) != scope->end()) {
-        resolution_[name] = std::distance(scopes_.crbegin(), scope);
+    for (std::size_t scope = scopes_.size(); scope-- > GLOBAL_SCOPES;) {
+      if (scopes_[scope].find(name.lexeme_) != scopes_[scope].end()) {
+        resolution_[name] = resolve_in(scopes_.size() - 1, functions_.size(),
+                                       name.lexeme_, scope);
         return;
       }
     }
+
+    // Builtins, globals and names only declared later all have a slot of
+    // their own, which every use of the name in every program shares
+    resolution_[name] = GLOBAL + global_slot(name.lexeme_);
+  }
+
+  /**
+   * How code in the given scope, inside the given number of the functions
+   * being resolved, finds a variable declared in a scope around it. A
+   * variable from around the innermost of those functions is captured by
+   * it, and by each function in between.
+   */
+  auto resolve_in(std::size_t const scope, std::size_t const functions,
+                  std::string const& name, std::size_t const declared)
+      -> std::size_t {
+    if (functions == 0 || functions_[functions - 1].scope_ <= declared) {
+      return scope - declared;
+    }
+
+    Function& function{functions_[functions - 1]};
+    for (std::size_t i = 0; i < function.captures_.size(); ++i) {
+      if (function.captures_[i].name_ == name) {
+        return UPVALUE + i;
+      }
+    }
+    // Captured where the function is declared, right around its scope
+    std::size_t const from{
+        resolve_in(function.scope_ - 1, functions - 1, name, declared)};
+    function.captures_.push_back(Capture{name, from});
+    return UPVALUE + function.captures_.size() - 1;
   }
 
   auto resolve_function(FunctionStatement const& stmt,
@@ -217,6 +328,11 @@ class NameResolver {
     current_function_type_ = function_type;
 
     begin_scope();
+    functions_.push_back(Function{scopes_.size() - 1, {}});
+    // Calls of methods bind this next to the parameters
+    if (function_type == FunctionType::METHOD) {
+      scopes_.back()["this"] = true;
+    }
 
     for (Token const& param : stmt.params_) {
       declare(param);
@@ -224,12 +340,22 @@ class NameResolver {
     }
     resolve(stmt.body_);
 
+    stmt.captures_ = std::move(functions_.back().captures_);
+    functions_.pop_back();
     end_scope();
 
     current_function_type_ = enclosing_function;
   }
 
+  // A function being resolved: the scope of its parameters, and the
+  // variables from around it that it uses so far
+  struct Function {
+    std::size_t scope_;
+    std::vector<Capture> captures_;
+  };
+
   std::vector<std::unordered_map<std::string, bool>> scopes_;
+  std::vector<Function> functions_{};
   FunctionType current_function_type_;
   ClassType current_class_type_;
 
@@ -237,7 +363,7 @@ class NameResolver {
 };
 
 namespace Resolver {
-auto resolve(std::vector<Statement> const& statements)
+inline auto resolve(std::vector<Statement> const& statements)
     -> std::unordered_map<Token, std::size_t> {
   std::unordered_map<Token, std::size_t> resolution;
   NameResolver resolver{resolution};
@@ -249,3 +375,5 @@ auto resolve(std::vector<Statement> const& statements)
   return resolution;
 }
 }  // namespace Resolver
+
+#endif
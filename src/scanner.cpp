@@ -1,6 +1,7 @@
 #include "scanner.hpp"
 
 #include <cassert>
+#include <functional>
 #include <iostream>
 #include <optional>
 #include <string>
@@ -12,8 +13,8 @@ namespace Scanner {
 Error::Error(std::size_t const line, std::string const& message)
     : line_(line), message_(message) {}
 
-auto Error::report() const -> void {
-  std::cerr << "[line " << line_ << "] Scanning error: "
+auto Error::report(std::ostream& out) const -> void {
+  out << "[line " << line_ << "] Scanning error: "
             << ": " << message_ << '\n';
 }
 }  // namespace Scanner
@@ -31,11 +32,13 @@ auto match_keyword_token_type(std::string const& text)
   if (text == "or") return TokenType::OR;
   if (text == "print") return TokenType::PRINT;
   if (text == "return") return TokenType::RETURN;
+  if (text == "spawn") return TokenType::SPAWN;
   if (text == "super") return TokenType::SUPER;
   if (text == "this") return TokenType::THIS;
   if (text == "true") return TokenType::TRUE;
   if (text == "var") return TokenType::VAR;
   if (text == "while") return TokenType::WHILE;
+  if (text == "yield") return TokenType::YIELD;
 
   return std::nullopt;
 }
@@ -46,8 +49,9 @@ auto match_keyword_token_type(std::string const& text)
 
 class Cursor {
  public:
-  Cursor(std::string const& source)
-      : source_(source), start_(0), current_(0), line_(1) {}
+  Cursor(std::string const& source, std::size_t begin = 0,
+         std::size_t line = 1)
+      : source_(source), start_(begin), current_(begin), line_(line) {}
 
   auto advance() -> void { current_++; }
 
@@ -186,6 +190,10 @@ auto error(std::size_t const line, std::string message) -> void {
       return single_char(TokenType::LEFT_BRACE);
     case '}':
       return single_char(TokenType::RIGHT_BRACE);
+    case '[':
+      return single_char(TokenType::LEFT_BRACKET);
+    case ']':
+      return single_char(TokenType::RIGHT_BRACKET);
     case ',':
       return single_char(TokenType::COMMA);
     case '.':
@@ -271,15 +279,15 @@ auto handle_newline(Cursor& cursor) -> std::nullopt_t {
   error(cursor.at_line(), "Unexpected character '" + std::string{c} + "'");
   return std::nullopt;
 }
-}  // namespace
 
-namespace Scanner {
-[[nodiscard]] auto scan_tokens(std::string const& contents)
-    -> std::vector<Token> {
+template <typename Stop>
+auto scan(Cursor& cursor, Stop const& stop) -> std::vector<Token> {
   std::vector<Token> tokens;
-  Cursor cursor(contents);
 
   while (!cursor.is_at_end()) {
+    if (stop(cursor.index())) {
+      return tokens;
+    }
     cursor.advance_word();
     if (std::optional<Token> const token = scan_token(cursor)) {
       tokens.push_back(token.value());
@@ -291,4 +299,22 @@ namespace Scanner {
 
   return tokens;
 }
+}  // namespace
+
+namespace Scanner {
+[[nodiscard]] auto scan_tokens(std::string const& contents)
+    -> std::vector<Token> {
+  Cursor cursor(contents);
+  return scan(cursor, [](std::size_t) { return false; });
+}
+
+[[nodiscard]] auto scan_tokens(std::string const& contents,
+                               std::size_t const begin, std::size_t& line,
+                               std::function<bool(std::size_t)> const& stop)
+    -> std::vector<Token> {
+  Cursor cursor(contents, begin, line);
+  std::vector<Token> tokens{scan(cursor, stop)};
+  line = cursor.at_line();
+  return tokens;
+}
 }  // namespace Scanner
@@ -1,6 +1,7 @@
 #ifndef LOX_SCANNER
 #define LOX_SCANNER
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -14,11 +15,31 @@ struct Error : CompileTimeError {
   std::size_t line_;
   std::string message_;
 
-  auto report() const -> void final;
+  using CompileTimeError::report;
+
+  auto report(std::ostream& out) const -> void final;
 };
 
 [[nodiscard]] auto scan_tokens(std::string const& contents)
     -> std::vector<Token>;
+
+/**
+ * Scans part of the contents, for re-scanning an edited region.
+ *
+ * @param contents The full source.
+ * @param begin Offset to start scanning at. Must not be inside a token.
+ * @param line The line number at begin. Updated to the line number at which
+ * scanning stopped.
+ * @param stop Called with the offset before every token, comment or
+ * whitespace character; scanning stops as soon as it returns true.
+ *
+ * @return The tokens scanned, ending with an EOF token only if scanning
+ * reached the end of the contents.
+ */
+[[nodiscard]] auto scan_tokens(std::string const& contents, std::size_t begin,
+                               std::size_t& line,
+                               std::function<bool(std::size_t)> const& stop)
+    -> std::vector<Token>;
 }  // namespace Scanner
 
 #endif
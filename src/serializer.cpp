@@ -0,0 +1,514 @@
+#include "./serializer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "./types/expression.hpp"
+#include "./types/program.hpp"
+#include "./types/statement.hpp"
+#include "./types/token.hpp"
+#include "./utils/box.hpp"
+
+namespace {
+// Bump whenever the meaning of an encoded node changes without the number of
+// node types changing.
+constexpr std::size_t FORMAT_REVISION{10};
+
+constexpr std::string_view MAGIC{"LOXP"};
+
+// Resolutions of globals and of captured variables are told apart by the low
+// bits rather than by GLOBAL and UPVALUE, to stay small
+auto encode_resolution(std::size_t const resolution) -> std::size_t {
+  if (resolution >= GLOBAL) {
+    return (resolution - GLOBAL) << 2 | 1;
+  }
+  if (resolution >= UPVALUE) {
+    return (resolution - UPVALUE) << 2 | 2;
+  }
+  return resolution << 2;
+}
+
+auto decode_resolution(std::size_t const encoded) -> std::size_t {
+  switch (encoded & 3) {
+    case 1:
+      return GLOBAL + (encoded >> 2);
+    case 2:
+      return UPVALUE + (encoded >> 2);
+    default:
+      return encoded >> 2;
+  }
+}
+
+template <typename T>
+struct is_box : std::false_type {};
+
+template <typename T>
+struct is_box<Box<T>> : std::true_type {
+  using type = T;
+};
+
+template <typename T>
+struct is_vector : std::false_type {};
+
+template <typename T>
+struct is_vector<std::vector<T>> : std::true_type {};
+
+template <typename T>
+struct is_variant : std::false_type {};
+
+template <typename... Ts>
+struct is_variant<std::variant<Ts...>> : std::true_type {};
+
+template <typename T>
+constexpr bool always_false{false};
+
+struct CorruptInput {};
+
+class Encoder {
+ public:
+  Encoder() { out_.append(MAGIC); }
+
+  [[nodiscard]] auto bytes() && -> std::string { return std::move(out_); }
+
+  // Unsigned LEB128: small numbers (lines, distances, indices) take one byte.
+  auto write(std::size_t value) -> void {
+    while (value >= 0x80) {
+      out_.push_back(static_cast<char>((value & 0x7F) | 0x80));
+      value >>= 7;
+    }
+    out_.push_back(static_cast<char>(value));
+  }
+
+  auto write(bool const value) -> void { out_.push_back(value ? 1 : 0); }
+
+  auto write(double const value) -> void {
+    auto bits{std::bit_cast<std::uint64_t>(value)};
+    for (std::size_t i = 0; i < sizeof(bits); ++i) {
+      out_.push_back(static_cast<char>(bits & 0xFF));
+      bits >>= 8;
+    }
+  }
+
+  auto write(std::string const& str) -> void {
+    write(str.size());
+    out_.append(str);
+  }
+
+  auto write(std::monostate) -> void {}
+
+  auto write(TokenType const type) -> void {
+    write(static_cast<std::size_t>(type));
+  }
+
+  auto write(Token const& token) -> void {
+    write(token.type_);
+    write(token.lexeme_);
+    write(token.literal_);
+    write(token.line_);
+    write(token.token_id_);
+  }
+
+  template <typename... Ts>
+  auto write(std::variant<Ts...> const& variant) -> void {
+    write(variant.index());
+    std::visit([this](auto const& alternative) { write(alternative); },
+               variant);
+  }
+
+  template <typename T>
+  auto write(Box<T> const& box) -> void {
+    write(*box);
+  }
+
+  template <typename T>
+  auto write(std::vector<T> const& elements) -> void {
+    write(elements.size());
+    for (T const& element : elements) {
+      write(element);
+    }
+  }
+
+  auto write(LiteralExpression const& expr) -> void { write(expr.value_); }
+
+  auto write(ThisExpression const& expr) -> void { write(expr.keyword_); }
+
+  auto write(VariableExpression const& expr) -> void { write(expr.name_); }
+
+  auto write(AssignmentExpression const& expr) -> void {
+    write(expr.name_);
+    write(expr.value_);
+  }
+
+  auto write(BinaryExpression const& expr) -> void {
+    write(expr.left_);
+    write(expr.op_);
+    write(expr.right_);
+  }
+
+  auto write(CallExpression const& expr) -> void {
+    write(expr.callee_);
+    write(expr.paren_);
+    write(expr.arguments_);
+  }
+
+  auto write(GetExpression const& expr) -> void {
+    write(expr.name_);
+    write(expr.object_);
+  }
+
+  auto write(GroupingExpression const& expr) -> void {
+    write(expr.expression_);
+  }
+
+  auto write(LogicalExpression const& expr) -> void {
+    write(expr.left_);
+    write(expr.op_);
+    write(expr.right_);
+  }
+
+  auto write(SetExpression const& expr) -> void {
+    write(expr.name_);
+    write(expr.object_);
+    write(expr.value_);
+  }
+
+  auto write(UnaryExpression const& expr) -> void {
+    write(expr.op_);
+    write(expr.right_);
+  }
+
+  auto write(ListExpression const& expr) -> void {
+    write(expr.bracket_);
+    write(expr.elements_);
+  }
+
+  auto write(IndexExpression const& expr) -> void {
+    write(expr.object_);
+    write(expr.bracket_);
+    write(expr.index_);
+  }
+
+  auto write(IndexSetExpression const& expr) -> void {
+    write(expr.object_);
+    write(expr.bracket_);
+    write(expr.index_);
+    write(expr.value_);
+  }
+
+  auto write(SpawnExpression const& expr) -> void {
+    write(expr.keyword_);
+    write(expr.call_);
+  }
+
+  auto write(SuperExpression const& expr) -> void {
+    write(expr.keyword_);
+    write(expr.method_);
+  }
+
+  auto write(ExpressionStatement const& stmt) -> void {
+    write(stmt.expression_);
+  }
+
+  auto write(PrintStatement const& stmt) -> void { write(stmt.expression_); }
+
+  auto write(ReturnStatement const& stmt) -> void {
+    write(stmt.keyword_);
+    write(stmt.value_);
+  }
+
+  auto write(YieldStatement const& stmt) -> void {
+    write(stmt.keyword_);
+    write(stmt.value_);
+  }
+
+  auto write(VariableStatement const& stmt) -> void {
+    write(stmt.name_);
+    write(stmt.initializer_);
+  }
+
+  auto write(BlockStatement const& stmt) -> void { write(stmt.statements_); }
+
+  auto write(FunctionStatement const& stmt) -> void {
+    write(stmt.name_);
+    write(stmt.params_);
+    write(stmt.body_);
+    write(stmt.generator_);
+    write(stmt.captures_);
+  }
+
+  auto write(Capture const& capture) -> void {
+    write(capture.name_);
+    write(encode_resolution(capture.from_));
+  }
+
+  auto write(ClassStatement const& stmt) -> void {
+    write(stmt.name_);
+    write(stmt.superclass_);
+    write(stmt.methods_);
+  }
+
+  auto write(IfStatement const& stmt) -> void {
+    write(stmt.condition_);
+    write(stmt.then_branch_);
+    write(stmt.else_branch_);
+  }
+
+  auto write(WhileStatement const& stmt) -> void {
+    write(stmt.keyword_);
+    write(stmt.condition_);
+    write(stmt.body_);
+  }
+
+ private:
+  std::string out_;
+};
+
+class Decoder {
+ public:
+  explicit Decoder(std::string const& bytes) : bytes_{bytes}, current_{0} {
+    if (bytes_.compare(0, MAGIC.size(), MAGIC) != 0) {
+      throw CorruptInput{};
+    }
+    current_ = MAGIC.size();
+  }
+
+  [[nodiscard]] auto is_at_end() const -> bool {
+    return current_ == bytes_.size();
+  }
+
+  // Members of a braced initializer list are evaluated left to right, so the
+  // aggregates below read their fields in declaration order.
+  template <typename T>
+  [[nodiscard]] auto read() -> T {
+    if constexpr (std::is_same_v<T, std::size_t>) {
+      std::size_t value{0};
+      for (std::size_t shift = 0;; shift += 7) {
+        if (shift >= 64) {
+          throw CorruptInput{};
+        }
+        auto const byte{static_cast<unsigned char>(take())};
+        value |= static_cast<std::size_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+          return value;
+        }
+      }
+    } else if constexpr (std::is_same_v<T, bool>) {
+      return take() != 0;
+    } else if constexpr (std::is_same_v<T, double>) {
+      std::uint64_t bits{0};
+      for (std::size_t i = 0; i < sizeof(bits); ++i) {
+        bits |= static_cast<std::uint64_t>(static_cast<unsigned char>(take()))
+                << (8 * i);
+      }
+      return std::bit_cast<double>(bits);
+    } else if constexpr (std::is_same_v<T, std::string>) {
+      std::size_t const size{read<std::size_t>()};
+      if (size > bytes_.size() - current_) {
+        throw CorruptInput{};
+      }
+      std::string str{bytes_.substr(current_, size)};
+      current_ += size;
+      return str;
+    } else if constexpr (std::is_same_v<T, std::monostate>) {
+      return std::monostate{};
+    } else if constexpr (std::is_same_v<T, TokenType>) {
+      std::size_t const type{read<std::size_t>()};
+      if (type > static_cast<std::size_t>(TokenType::EOFF)) {
+        throw CorruptInput{};
+      }
+      return static_cast<TokenType>(type);
+    } else if constexpr (std::is_same_v<T, Token>) {
+      return Token{read<TokenType>(), read<std::string>(),
+                   read<Token::Literal>(), read<std::size_t>(),
+                   read<std::size_t>()};
+    } else if constexpr (is_variant<T>::value) {
+      std::size_t const index{read<std::size_t>()};
+      return read_alternative<T>(
+          index, std::make_index_sequence<std::variant_size_v<T>>{});
+    } else if constexpr (is_box<T>::value) {
+      return T{read<typename is_box<T>::type>()};
+    } else if constexpr (is_vector<T>::value) {
+      std::size_t const size{read<std::size_t>()};
+      T elements{};
+      elements.reserve(std::min(size, bytes_.size() - current_));
+      for (std::size_t i = 0; i < size; ++i) {
+        elements.push_back(read<typename T::value_type>());
+      }
+      return elements;
+    } else if constexpr (std::is_same_v<T, LiteralExpression>) {
+      return T{read<Token::Literal>()};
+    } else if constexpr (std::is_same_v<T, ThisExpression> ||
+                         std::is_same_v<T, VariableExpression>) {
+      return T{read<Token>()};
+    } else if constexpr (std::is_same_v<T, AssignmentExpression>) {
+      return T{read<Token>(), read<Expression>()};
+    } else if constexpr (std::is_same_v<T, BinaryExpression> ||
+                         std::is_same_v<T, LogicalExpression>) {
+      return T{read<Expression>(), read<Token>(), read<Expression>()};
+    } else if constexpr (std::is_same_v<T, CallExpression>) {
+      return T{read<Expression>(), read<Token>(),
+               read<std::vector<Expression>>()};
+    } else if constexpr (std::is_same_v<T, GetExpression>) {
+      return T{read<Token>(), read<Expression>()};
+    } else if constexpr (std::is_same_v<T, GroupingExpression>) {
+      return T{read<Expression>()};
+    } else if constexpr (std::is_same_v<T, SetExpression>) {
+      return T{read<Token>(), read<Expression>(), read<Expression>()};
+    } else if constexpr (std::is_same_v<T, UnaryExpression>) {
+      return T{read<Token>(), read<Expression>()};
+    } else if constexpr (std::is_same_v<T, ListExpression>) {
+      return T{read<Token>(), read<std::vector<Expression>>()};
+    } else if constexpr (std::is_same_v<T, IndexExpression>) {
+      return T{read<Expression>(), read<Token>(), read<Expression>()};
+    } else if constexpr (std::is_same_v<T, IndexSetExpression>) {
+      return T{read<Expression>(), read<Token>(), read<Expression>(),
+               read<Expression>()};
+    } else if constexpr (std::is_same_v<T, SpawnExpression>) {
+      return T{read<Token>(), read<Expression>()};
+    } else if constexpr (std::is_same_v<T, SuperExpression>) {
+      return T{read<Token>(), read<Token>()};
+    } else if constexpr (std::is_same_v<T, ExpressionStatement> ||
+                         std::is_same_v<T, PrintStatement>) {
+      return T{read<Expression>()};
+    } else if constexpr (std::is_same_v<T, ReturnStatement> ||
+                         std::is_same_v<T, YieldStatement> ||
+                         std::is_same_v<T, VariableStatement>) {
+      return T{read<Token>(), read<Expression>()};
+    } else if constexpr (std::is_same_v<T, BlockStatement>) {
+      return T{read<std::vector<Statement>>()};
+    } else if constexpr (std::is_same_v<T, FunctionStatement>) {
+      return T{read<Token>(), read<std::vector<Token>>(),
+               read<std::vector<Statement>>(), read<bool>(),
+               read<std::vector<Capture>>()};
+    } else if constexpr (std::is_same_v<T, Capture>) {
+      return T{read<std::string>(), decode_resolution(read<std::size_t>())};
+    } else if constexpr (std::is_same_v<T, ClassStatement>) {
+      return T{read<Token>(), read<Expression>(),
+               read<std::vector<Box<FunctionStatement>>>()};
+    } else if constexpr (std::is_same_v<T, IfStatement>) {
+      return T{read<Expression>(), read<Statement>(), read<Statement>()};
+    } else if constexpr (std::is_same_v<T, WhileStatement>) {
+      return T{read<Token>(), read<Expression>(), read<Statement>()};
+    } else {
+      static_assert(always_false<T>, "No decoder for this type");
+    }
+  }
+
+ private:
+  template <typename Variant, std::size_t... Is>
+  [[nodiscard]] auto read_alternative(std::size_t const index,
+                                      std::index_sequence<Is...>) -> Variant {
+    using Reader = Variant (*)(Decoder&);
+    static constexpr Reader readers[]{[](Decoder& decoder) -> Variant {
+      return decoder.read<std::variant_alternative_t<Is, Variant>>();
+    }...};
+
+    if (index >= sizeof...(Is)) {
+      throw CorruptInput{};
+    }
+    return readers[index](*this);
+  }
+
+  auto take() -> char {
+    if (is_at_end()) {
+      throw CorruptInput{};
+    }
+    return bytes_[current_++];
+  }
+
+  std::string const& bytes_;
+  std::size_t current_;
+};
+}  // namespace
+
+namespace Serializer {
+auto serialize(Program const& program) -> std::string {
+  Encoder encoder{};
+  encoder.write(program.statements_);
+
+  // Resolution entries are keyed by token identity only, so the id is all
+  // that needs to be stored for the key. They are written in the order of
+  // the ids, for a program to always encode to the same bytes.
+  std::vector<std::pair<std::size_t, std::size_t>> entries{};
+  entries.reserve(program.resolution_.size());
+  for (auto const& [token, distance] : program.resolution_) {
+    entries.emplace_back(token.token_id_, distance);
+  }
+  std::sort(entries.begin(), entries.end());
+
+  // Slots are only numbered for the process, so globals refer to a table of
+  // their names instead, which the decoding process numbers anew
+  std::vector<std::string> names{};
+  std::unordered_map<std::size_t, std::size_t> indices{};
+  for (auto& [token_id, distance] : entries) {
+    if (distance >= GLOBAL) {
+      auto const [index, added]{
+          indices.try_emplace(distance - GLOBAL, names.size())};
+      if (added) {
+        names.push_back(global_name(distance - GLOBAL));
+      }
+      distance = GLOBAL + index->second;
+    }
+    distance = encode_resolution(distance);
+  }
+
+  encoder.write(names);
+  encoder.write(entries.size());
+  for (auto const& [token_id, distance] : entries) {
+    encoder.write(token_id);
+    encoder.write(distance);
+  }
+
+  return std::move(encoder).bytes();
+}
+
+auto deserialize(std::string const& bytes) -> std::optional<Program> {
+  try {
+    Decoder decoder{bytes};
+    Program program{decoder.read<std::vector<Statement>>(), {}};
+
+    std::vector<std::size_t> slots{};
+    for (std::string const& name : decoder.read<std::vector<std::string>>()) {
+      slots.push_back(global_slot(name));
+    }
+
+    std::size_t const size{decoder.read<std::size_t>()};
+    program.resolution_.reserve(size);
+    for (std::size_t i = 0; i < size; ++i) {
+      std::size_t const token_id{decoder.read<std::size_t>()};
+      std::size_t distance{decode_resolution(decoder.read<std::size_t>())};
+      if (distance >= GLOBAL) {
+        if (distance - GLOBAL >= slots.size()) {
+          throw CorruptInput{};
+        }
+        distance = GLOBAL + slots[distance - GLOBAL];
+      }
+      program.resolution_.emplace(
+          Token{TokenType::IDENTIFIER, "", std::monostate{}, 0, token_id},
+          distance);
+    }
+
+    if (!decoder.is_at_end()) {
+      return std::nullopt;
+    }
+    return program;
+  } catch (CorruptInput const&) {
+    return std::nullopt;
+  }
+}
+
+auto format_version() -> std::string {
+  return std::to_string(FORMAT_REVISION) + "." +
+         std::to_string(std::variant_size_v<Expression>) + "." +
+         std::to_string(std::variant_size_v<Statement>);
+}
+}  // namespace Serializer
@@ -0,0 +1,37 @@
+#ifndef LOX_SERIALIZER
+#define LOX_SERIALIZER
+
+#include <optional>
+#include <string>
+
+#include "./types/program.hpp"
+
+namespace Serializer {
+/**
+ * Encodes a program into a compact binary representation.
+ *
+ * @param program The parsed and resolved program.
+ *
+ * @return The encoded bytes.
+ */
+[[nodiscard]] auto serialize(Program const& program) -> std::string;
+
+/**
+ * Decodes a program previously encoded with serialize().
+ *
+ * @param bytes The encoded bytes.
+ *
+ * @return The program, or std::nullopt if the bytes are truncated, corrupt or
+ * were written by an incompatible version of the encoder.
+ */
+[[nodiscard]] auto deserialize(std::string const& bytes)
+    -> std::optional<Program>;
+
+/**
+ * Identifies the encoding. Changes whenever the AST layout changes, so that
+ * stale encodings are never decoded into the wrong node types.
+ */
+[[nodiscard]] auto format_version() -> std::string;
+}  // namespace Serializer
+
+#endif
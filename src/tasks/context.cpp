@@ -0,0 +1,178 @@
+#include "./context.hpp"
+
+#include <sys/mman.h>
+
+#include <cstdint>
+#include <new>
+
+#if defined(__SANITIZE_THREAD__)
+#define LOX_TSAN_FIBERS
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define LOX_TSAN_FIBERS
+#endif
+#endif
+
+#ifdef LOX_TSAN_FIBERS
+#include <sanitizer/tsan_interface.h>
+#endif
+
+#if defined(__x86_64__)
+// Pushes the registers the System V ABI has callees preserve, plus the
+// floating point control words, onto the running stack, stores the stack
+// pointer to *from, then pops the same from the stack at `to`.
+extern "C" auto lox_switch_stack(void** from, void* to) -> void;
+// Where a prepared stack starts: calls r13 with r12 as the argument.
+extern "C" auto lox_start_stack() -> void;
+
+asm(R"(
+  .text
+  .globl lox_switch_stack
+  .hidden lox_switch_stack
+  .type lox_switch_stack, @function
+  .p2align 4
+lox_switch_stack:
+  pushq %rbp
+  pushq %rbx
+  pushq %r12
+  pushq %r13
+  pushq %r14
+  pushq %r15
+  subq $8, %rsp
+  stmxcsr (%rsp)
+  fnstcw 4(%rsp)
+  movq %rsp, (%rdi)
+  movq %rsi, %rsp
+  ldmxcsr (%rsp)
+  fldcw 4(%rsp)
+  addq $8, %rsp
+  popq %r15
+  popq %r14
+  popq %r13
+  popq %r12
+  popq %rbx
+  popq %rbp
+  ret
+  .size lox_switch_stack, .-lox_switch_stack
+
+  .globl lox_start_stack
+  .hidden lox_start_stack
+  .type lox_start_stack, @function
+  .p2align 4
+lox_start_stack:
+  .cfi_startproc
+  .cfi_undefined rip
+  movq %r12, %rdi
+  callq *%r13
+  ud2
+  .cfi_endproc
+  .size lox_start_stack, .-lox_start_stack
+)");
+#endif
+
+namespace Tasks {
+namespace {
+constexpr std::size_t GUARD_SIZE{std::size_t{64} << 10};
+}  // namespace
+
+Stack::Stack(std::size_t const size) : mapping_{nullptr}, size_{size} {
+  mapping_ = mmap(nullptr, GUARD_SIZE + size_, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1,
+                  0);
+  if (mapping_ == MAP_FAILED) {
+    throw std::bad_alloc{};
+  }
+  // Stacks grow down, so the guard goes at the bottom
+  mprotect(mapping_, GUARD_SIZE, PROT_NONE);
+}
+
+Stack::~Stack() { munmap(mapping_, GUARD_SIZE + size_); }
+
+auto Stack::base() const -> void* {
+  return static_cast<char*>(mapping_) + GUARD_SIZE;
+}
+
+auto Stack::size() const -> std::size_t { return size_; }
+
+Context::Context()
+    :
+#if defined(__x86_64__)
+      stack_pointer_{nullptr},
+#else
+      ucontext_{},
+      entry_{nullptr},
+      argument_{nullptr},
+#endif
+      sanitizer_fiber_{nullptr},
+      own_sanitizer_fiber_{nullptr} {
+}
+
+Context::~Context() {
+#ifdef LOX_TSAN_FIBERS
+  if (own_sanitizer_fiber_) {
+    __tsan_destroy_fiber(own_sanitizer_fiber_);
+  }
+#endif
+}
+
+auto Context::prepare(Stack& stack, void (*const entry)(void*),
+                      void* const argument) -> void {
+#if defined(__x86_64__)
+  auto const top{(reinterpret_cast<std::uintptr_t>(stack.base()) +
+                  stack.size()) &
+                 ~std::uintptr_t{15}};
+  // What lox_switch_stack pops, from the lowest address: the control words,
+  // r15, r14, r13, r12, rbx, rbp and the return address. The call in
+  // lox_start_stack then finds the stack aligned as the ABI requires.
+  auto const frame{reinterpret_cast<std::uint64_t*>(top) - 10};
+  frame[0] = 0x1F80 | (std::uint64_t{0x037F} << 32);
+  frame[1] = 0;
+  frame[2] = 0;
+  frame[3] = reinterpret_cast<std::uint64_t>(entry);
+  frame[4] = reinterpret_cast<std::uint64_t>(argument);
+  frame[5] = 0;
+  frame[6] = 0;
+  frame[7] = reinterpret_cast<std::uint64_t>(&lox_start_stack);
+  stack_pointer_ = frame;
+#else
+  entry_ = entry;
+  argument_ = argument;
+  getcontext(&ucontext_);
+  ucontext_.uc_stack.ss_sp = stack.base();
+  ucontext_.uc_stack.ss_size = stack.size();
+  ucontext_.uc_link = nullptr;
+  // makecontext only passes int arguments
+  auto const address{reinterpret_cast<std::uintptr_t>(this)};
+  makecontext(&ucontext_, reinterpret_cast<void (*)()>(&Context::start), 2,
+              static_cast<unsigned>(address >> 32),
+              static_cast<unsigned>(address));
+#endif
+
+#ifdef LOX_TSAN_FIBERS
+  if (!own_sanitizer_fiber_) {
+    own_sanitizer_fiber_ = __tsan_create_fiber(0);
+  }
+  sanitizer_fiber_ = own_sanitizer_fiber_;
+#endif
+}
+
+#if !defined(__x86_64__)
+auto Context::start(unsigned const high, unsigned const low) -> void {
+  auto const context{reinterpret_cast<Context*>(
+      (static_cast<std::uintptr_t>(high) << 32) | low)};
+  context->entry_(context->argument_);
+}
+#endif
+
+auto switch_context(Context& from, Context& to) -> void {
+#ifdef LOX_TSAN_FIBERS
+  from.sanitizer_fiber_ = __tsan_get_current_fiber();
+  __tsan_switch_to_fiber(to.sanitizer_fiber_, 0);
+#endif
+#if defined(__x86_64__)
+  lox_switch_stack(&from.stack_pointer_, to.stack_pointer_);
+#else
+  swapcontext(&from.ucontext_, &to.ucontext_);
+#endif
+}
+}  // namespace Tasks
@@ -0,0 +1,84 @@
+#ifndef LOX_TASKS_CONTEXT
+#define LOX_TASKS_CONTEXT
+
+#include <cstddef>
+
+#if !defined(__x86_64__)
+#include <ucontext.h>
+#endif
+
+namespace Tasks {
+/**
+ * Memory for running code on a stack of its own. The stack is reserved, not
+ * committed, so only the pages actually touched take memory. Overflowing it
+ * faults on a guard page instead of corrupting memory.
+ */
+class Stack {
+ public:
+  // As much as the main thread gets
+  static constexpr std::size_t DEFAULT_SIZE{std::size_t{8} << 20};
+
+  explicit Stack(std::size_t size = DEFAULT_SIZE);
+
+  Stack(Stack const&) = delete;
+  auto operator=(Stack const&) -> Stack& = delete;
+
+  ~Stack();
+
+  [[nodiscard]] auto base() const -> void*;
+
+  [[nodiscard]] auto size() const -> std::size_t;
+
+ private:
+  void* mapping_;
+  std::size_t size_;
+};
+
+/**
+ * Where execution continues when switched to: either a stack that has been
+ * switched away from, or a function prepared to start on a fresh stack.
+ * Switching saves and restores only the registers a function call preserves,
+ * so it costs about as much as a function call, with no system call.
+ */
+class Context {
+ public:
+  Context();
+
+  Context(Context const&) = delete;
+  auto operator=(Context const&) -> Context& = delete;
+
+  ~Context();
+
+  /**
+   * Makes the first switch to this context call entry(argument) on the
+   * stack. The entry function must never return; it ends by switching away
+   * for good.
+   */
+  auto prepare(Stack& stack, void (*entry)(void*), void* argument) -> void;
+
+  /**
+   * Saves where the running code is into `from`, and continues at `to`.
+   * Returns once something switches back to `from`.
+   */
+  friend auto switch_context(Context& from, Context& to) -> void;
+
+ private:
+#if defined(__x86_64__)
+  void* stack_pointer_;
+#else
+  static auto start(unsigned high, unsigned low) -> void;
+
+  ucontext_t ucontext_;
+  void (*entry_)(void*);
+  void* argument_;
+#endif
+  // For ThreadSanitizer, which has to be told about every switch: the fiber
+  // it knows the stack as, and the one created for a prepared context
+  void* sanitizer_fiber_;
+  void* own_sanitizer_fiber_;
+};
+
+auto switch_context(Context& from, Context& to) -> void;
+}  // namespace Tasks
+
+#endif
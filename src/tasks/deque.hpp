@@ -0,0 +1,123 @@
+#ifndef LOX_TASKS_DEQUE
+#define LOX_TASKS_DEQUE
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Tasks {
+/**
+ * A lock-free work-stealing deque (Chase and Lev, "Dynamic Circular
+ * Work-Stealing Deque", with the memory orderings of Lê et al.). The owning
+ * thread pushes and takes at the bottom; any other thread may steal from the
+ * top.
+ *
+ * Arrays are only freed with the deque, since a thief may still be reading
+ * from one that was just replaced by a larger one.
+ */
+template <typename T>
+class Deque {
+ public:
+  explicit Deque(std::size_t const capacity = 64)
+      : top_{0}, bottom_{0}, array_{nullptr} {
+    arrays_.push_back(std::make_unique<Array>(capacity));
+    array_.store(arrays_.back().get(), std::memory_order_relaxed);
+  }
+
+  Deque(Deque const&) = delete;
+  auto operator=(Deque const&) -> Deque& = delete;
+
+  // Owner only
+  auto push(T* const item) -> void {
+    std::int64_t const bottom{bottom_.load(std::memory_order_relaxed)};
+    std::int64_t const top{top_.load(std::memory_order_acquire)};
+    Array* array{array_.load(std::memory_order_relaxed)};
+    if (bottom - top > static_cast<std::int64_t>(array->size()) - 1) {
+      array = grow(array, top, bottom);
+    }
+    array->put(bottom, item);
+    bottom_.store(bottom + 1, std::memory_order_seq_cst);
+  }
+
+  // Owner only. Returns nullptr if the deque is empty.
+  [[nodiscard]] auto take() -> T* {
+    std::int64_t const bottom{bottom_.load(std::memory_order_relaxed) - 1};
+    Array* const array{array_.load(std::memory_order_relaxed)};
+    bottom_.store(bottom, std::memory_order_seq_cst);
+    std::int64_t top{top_.load(std::memory_order_seq_cst)};
+
+    if (top > bottom) {
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    T* item{array->get(bottom)};
+    if (top == bottom) {
+      // The last item: race thieves for it
+      if (!top_.compare_exchange_strong(top, top + 1,
+                                        std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+        item = nullptr;
+      }
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return item;
+  }
+
+  // Any thread. Returns nullptr if the deque is empty or another thread won
+  // the race for the top item.
+  [[nodiscard]] auto steal() -> T* {
+    std::int64_t top{top_.load(std::memory_order_seq_cst)};
+    std::int64_t const bottom{bottom_.load(std::memory_order_seq_cst)};
+    if (top >= bottom) {
+      return nullptr;
+    }
+    T* const item{array_.load(std::memory_order_acquire)->get(top)};
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return item;
+  }
+
+ private:
+  class Array {
+   public:
+    explicit Array(std::size_t const size) : slots_(size) {}
+
+    [[nodiscard]] auto size() const -> std::size_t { return slots_.size(); }
+
+    [[nodiscard]] auto get(std::int64_t const index) const -> T* {
+      return slots_[static_cast<std::size_t>(index) % slots_.size()].load(
+          std::memory_order_relaxed);
+    }
+
+    auto put(std::int64_t const index, T* const item) -> void {
+      slots_[static_cast<std::size_t>(index) % slots_.size()].store(
+          item, std::memory_order_relaxed);
+    }
+
+   private:
+    std::vector<std::atomic<T*>> slots_;
+  };
+
+  auto grow(Array* const array, std::int64_t const top,
+            std::int64_t const bottom) -> Array* {
+    arrays_.push_back(std::make_unique<Array>(array->size() * 2));
+    Array* const grown{arrays_.back().get()};
+    for (std::int64_t i = top; i < bottom; ++i) {
+      grown->put(i, array->get(i));
+    }
+    array_.store(grown, std::memory_order_release);
+    return grown;
+  }
+
+  std::atomic<std::int64_t> top_;
+  std::atomic<std::int64_t> bottom_;
+  std::atomic<Array*> array_;
+  // Every array this deque has used; only touched by the owner
+  std::vector<std::unique_ptr<Array>> arrays_;
+};
+}  // namespace Tasks
+
+#endif
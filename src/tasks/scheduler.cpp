@@ -0,0 +1,332 @@
+#include "./scheduler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../profiler.hpp"
+#include "../utils/error.hpp"
+#include "./context.hpp"
+#include "./deque.hpp"
+
+namespace Tasks {
+class Fiber {
+ public:
+  Fiber() : started_{false}, finished_{false}, running_{false} {}
+
+  Fiber(Fiber const&) = delete;
+  auto operator=(Fiber const&) -> Fiber& = delete;
+
+  // Prepares to run the body from the start, on a stack that is only
+  // allocated once the fiber first runs and then kept for reuse.
+  auto start() -> void {
+    if (!stack_) {
+      stack_.emplace();
+    }
+    context_.prepare(*stack_, &entry, this);
+    started_ = true;
+  }
+
+  std::function<void()> body_;
+  Context context_;
+  std::optional<Stack> stack_;
+  bool started_;
+  bool finished_;
+  // Set while some worker is on the stack of the fiber. A fiber that parks
+  // can be woken before it is off its stack, and must not run twice at once.
+  std::atomic<bool> running_;
+
+ private:
+  static auto entry(void* fiber) -> void;
+};
+
+struct Worker {
+  Scheduler* scheduler_{nullptr};
+  std::size_t index_{0};
+  Deque<Fiber> deque_{};
+  Context context_{};
+  // The fiber running on this worker, if any
+  Fiber* current_{nullptr};
+  std::thread thread_{};
+};
+
+namespace {
+thread_local Worker* current_worker{nullptr};
+
+// Fibers move between threads while suspended, and the compiler may keep the
+// address of a thread_local in a register across the switch. Fibers read it
+// through this function, which is never inlined, so they always see the
+// worker of the thread they are on.
+[[gnu::noinline]] auto this_worker() -> Worker* { return current_worker; }
+}  // namespace
+
+auto Fiber::entry(void* const argument) -> void {
+  auto const fiber{static_cast<Fiber*>(argument)};
+  fiber->body_();
+  fiber->body_ = nullptr;
+  fiber->finished_ = true;
+  switch_context(fiber->context_, this_worker()->context_);
+}
+
+struct WaitQueue::Waiter {
+  Scheduler* scheduler_;
+  Fiber* fiber_;
+  std::condition_variable* blocked_;
+  bool notified_;
+  // Set if the wait failed instead
+  bool abandoned_;
+  WaitQueue* queue_;
+  std::mutex* mutex_;
+  // Where the scheduler counts the waiter, unless it waits for I/O
+  std::optional<std::list<Waiter*>::iterator> parked_;
+};
+
+Scheduler::Scheduler(std::size_t const workers)
+    : epoch_{0}, sleepers_{0}, stopping_{false}, live_{0} {
+  std::size_t const count{std::max<std::size_t>(workers, 1)};
+  workers_.reserve(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    workers_.push_back(std::make_unique<Worker>());
+    workers_.back()->scheduler_ = this;
+    workers_.back()->index_ = i;
+  }
+  for (std::unique_ptr<Worker>& worker : workers_) {
+    worker->thread_ = std::thread{[this, &worker = *worker] {
+      current_worker = &worker;
+      work(worker);
+    }};
+  }
+}
+
+Scheduler::~Scheduler() {
+  while (true) {
+    WaitQueue::Waiter* deadlocked{nullptr};
+    {
+      std::unique_lock lock{state_mutex_};
+      settled_.wait(lock, [this] { return live_ == parked_.size(); });
+      if (live_ == 0) {
+        break;
+      }
+      deadlocked = parked_.front();
+    }
+    // Every task is waiting on another, so nothing wakes the waiter before
+    // it is taken out of its queue
+    WaitQueue::abandon(*deadlocked);
+  }
+  {
+    std::lock_guard const lock{idle_mutex_};
+    stopping_ = true;
+  }
+  idle_.notify_all();
+  for (std::unique_ptr<Worker>& worker : workers_) {
+    worker->thread_.join();
+  }
+}
+
+auto Scheduler::default_workers() -> std::size_t {
+  return std::max(1U, std::thread::hardware_concurrency());
+}
+
+auto Scheduler::spawn(std::function<void()> body) -> void {
+  Fiber* fiber{nullptr};
+  {
+    std::lock_guard const lock{fibers_mutex_};
+    if (free_fibers_.empty()) {
+      fibers_.push_back(std::make_unique<Fiber>());
+      fiber = fibers_.back().get();
+    } else {
+      fiber = free_fibers_.back();
+      free_fibers_.pop_back();
+    }
+  }
+  fiber->body_ = std::move(body);
+  {
+    std::lock_guard const lock{state_mutex_};
+    ++live_;
+  }
+  schedule(fiber);
+}
+
+auto Scheduler::park(WaitQueue::Waiter& waiter, std::mutex& mutex) -> void {
+  if (!waiter.queue_->external_) {
+    std::lock_guard const lock{state_mutex_};
+    waiter.parked_ = parked_.insert(parked_.end(), &waiter);
+    if (live_ == parked_.size()) {
+      settled_.notify_all();
+    }
+  }
+  mutex.unlock();
+  // The worker goes on to other tasks, which the profiler must not take for
+  // this one
+  Profiler::Stack* const profiled{Profiler::activate(nullptr)};
+  Worker* const worker{this_worker()};
+  switch_context(worker->current_->context_, worker->context_);
+  Profiler::activate(profiled);
+}
+
+auto Scheduler::resume(WaitQueue::Waiter& waiter) -> void {
+  if (waiter.parked_) {
+    std::lock_guard const lock{state_mutex_};
+    parked_.erase(*waiter.parked_);
+  }
+  schedule(waiter.fiber_);
+}
+
+auto Scheduler::schedule(Fiber* const fiber) -> void {
+  if (Worker* const worker{this_worker()};
+      worker && worker->scheduler_ == this) {
+    worker->deque_.push(fiber);
+  } else {
+    std::lock_guard const lock{injected_mutex_};
+    injected_.push_back(fiber);
+  }
+  epoch_.fetch_add(1);
+  if (sleepers_.load() > 0) {
+    // Taking the mutex orders this with a worker checking the epoch before
+    // going to sleep
+    { std::lock_guard const lock{idle_mutex_}; }
+    idle_.notify_one();
+  }
+}
+
+auto Scheduler::work(Worker& worker) -> void {
+  while (Fiber* const fiber{find_work(worker)}) {
+    run(worker, fiber);
+  }
+}
+
+auto Scheduler::find_work(Worker& worker) -> Fiber* {
+  std::size_t const count{workers_.size()};
+  while (true) {
+    std::uint64_t const epoch{epoch_.load()};
+
+    if (Fiber* const fiber{worker.deque_.take()}) {
+      return fiber;
+    }
+    {
+      std::lock_guard const lock{injected_mutex_};
+      if (!injected_.empty()) {
+        Fiber* const fiber{injected_.front()};
+        injected_.pop_front();
+        return fiber;
+      }
+    }
+    // A steal fails when another thread wins the race for the same task, so
+    // try every victim twice before giving up
+    for (std::size_t round = 0; round < 2; ++round) {
+      for (std::size_t i = 1; i < count; ++i) {
+        Worker& victim{*workers_[(worker.index_ + i) % count]};
+        if (Fiber* const fiber{victim.deque_.steal()}) {
+          return fiber;
+        }
+      }
+    }
+
+    std::unique_lock lock{idle_mutex_};
+    sleepers_.fetch_add(1);
+    idle_.wait(lock, [this, epoch] {
+      return stopping_.load() || epoch_.load() != epoch;
+    });
+    sleepers_.fetch_sub(1);
+    if (stopping_.load()) {
+      return nullptr;
+    }
+  }
+}
+
+auto Scheduler::run(Worker& worker, Fiber* const fiber) -> void {
+  // Only ever waits for the few instructions between a fiber parking and
+  // being off its stack
+  while (fiber->running_.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+  fiber->running_.store(true, std::memory_order_relaxed);
+  if (!fiber->started_) {
+    fiber->start();
+  }
+  worker.current_ = fiber;
+  switch_context(worker.context_, fiber->context_);
+  worker.current_ = nullptr;
+  // Read before releasing the fiber, which may then run elsewhere at once
+  bool const finished{fiber->finished_};
+  fiber->running_.store(false, std::memory_order_release);
+
+  if (finished) {
+    fiber->started_ = false;
+    fiber->finished_ = false;
+    {
+      std::lock_guard const lock{fibers_mutex_};
+      free_fibers_.push_back(fiber);
+    }
+    std::lock_guard const lock{state_mutex_};
+    --live_;
+    if (live_ == parked_.size()) {
+      settled_.notify_all();
+    }
+  }
+}
+
+auto WaitQueue::wait(std::unique_lock<std::mutex>& lock) -> void {
+  Waiter waiter{nullptr, nullptr, nullptr, false, false, this, lock.mutex(),
+                std::nullopt};
+
+  if (Worker* const worker{this_worker()}; worker && worker->current_) {
+    waiter.scheduler_ = worker->scheduler_;
+    waiter.fiber_ = worker->current_;
+    waiters_.push_back(&waiter);
+    std::mutex& mutex{*lock.release()};
+    waiter.scheduler_->park(waiter, mutex);
+    // Possibly on another thread now
+    lock = std::unique_lock{mutex};
+    if (waiter.abandoned_) {
+      throw NativeError{"Deadlock: every task is waiting."};
+    }
+    return;
+  }
+
+  std::condition_variable blocked{};
+  waiter.blocked_ = &blocked;
+  waiters_.push_back(&waiter);
+  blocked.wait(lock, [&waiter] { return waiter.notified_; });
+}
+
+auto WaitQueue::notify_one() -> void {
+  if (!waiters_.empty()) {
+    Waiter* const waiter{waiters_.front()};
+    waiters_.pop_front();
+    wake(*waiter);
+  }
+}
+
+auto WaitQueue::notify_all() -> void {
+  while (!waiters_.empty()) {
+    notify_one();
+  }
+}
+
+auto WaitQueue::wake(Waiter& waiter) -> void {
+  waiter.notified_ = true;
+  if (waiter.fiber_) {
+    waiter.scheduler_->resume(waiter);
+  } else {
+    waiter.blocked_->notify_one();
+  }
+}
+
+auto WaitQueue::abandon(Waiter& waiter) -> void {
+  std::lock_guard const lock{*waiter.mutex_};
+  std::deque<Waiter*>& waiters{waiter.queue_->waiters_};
+  waiters.erase(std::find(waiters.begin(), waiters.end(), &waiter));
+  waiter.abandoned_ = true;
+  waiter.queue_->wake(waiter);
+}
+}  // namespace Tasks
@@ -0,0 +1,137 @@
+#ifndef LOX_TASKS_SCHEDULER
+#define LOX_TASKS_SCHEDULER
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "./deque.hpp"
+
+namespace Tasks {
+class Fiber;
+struct Worker;
+
+/**
+ * Tasks, or threads outside any task, waiting for a condition guarded by a
+ * mutex; the counterpart of std::condition_variable.
+ */
+class WaitQueue {
+ public:
+  WaitQueue() = default;
+
+  /**
+   * @param external Whether the condition is met from outside the tasks, as
+   * by I/O. Tasks waiting for it are not counted as deadlocked.
+   */
+  explicit WaitQueue(bool const external) : external_{external} {}
+
+  /**
+   * Suspends the running task, or blocks the thread outside tasks, until
+   * notified. The lock is released while waiting and held again on return.
+   *
+   * @throws NativeError If the task deadlocked, and the scheduler gave up on
+   * it as the execution ended.
+   */
+  auto wait(std::unique_lock<std::mutex>& lock) -> void;
+
+  // The mutex of the waiters must be held.
+  auto notify_one() -> void;
+
+  auto notify_all() -> void;
+
+ private:
+  friend class Scheduler;
+
+  struct Waiter;
+
+  auto wake(Waiter& waiter) -> void;
+
+  // Takes the waiter out of the queue, for its wait to fail
+  static auto abandon(Waiter& waiter) -> void;
+
+  std::deque<Waiter*> waiters_;
+  bool external_{false};
+};
+
+/**
+ * Runs tasks on a fixed set of worker threads. Every task runs on a stack of
+ * its own, so a task that has to wait is suspended and its worker moves on to
+ * other tasks, instead of the thread blocking.
+ *
+ * Each worker keeps the tasks it spawns or wakes in a lock-free deque, taking
+ * the most recent one first while it is still warm in the cache. Workers that
+ * run out steal the oldest task of another worker. Tasks spawned from outside
+ * the workers go through a shared queue.
+ */
+class Scheduler {
+ public:
+  explicit Scheduler(std::size_t workers = default_workers());
+
+  Scheduler(Scheduler const&) = delete;
+  auto operator=(Scheduler const&) -> Scheduler& = delete;
+
+  /**
+   * Waits until every task has finished, then joins the workers. Tasks that
+   * are all waiting on each other can never finish. Their waits fail one at a
+   * time, oldest first, so that their stacks unwind and nothing is left
+   * waiting in a channel or task that outlives the scheduler.
+   */
+  ~Scheduler();
+
+  static auto default_workers() -> std::size_t;
+
+  auto spawn(std::function<void()> body) -> void;
+
+ private:
+  friend class WaitQueue;
+
+  // Suspends the running task, unlocking the mutex under which it was
+  // registered to be woken.
+  auto park(WaitQueue::Waiter& waiter, std::mutex& mutex) -> void;
+
+  auto resume(WaitQueue::Waiter& waiter) -> void;
+
+  auto schedule(Fiber* fiber) -> void;
+
+  auto work(Worker& worker) -> void;
+
+  auto find_work(Worker& worker) -> Fiber*;
+
+  auto run(Worker& worker, Fiber* fiber) -> void;
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  std::mutex injected_mutex_;
+  std::deque<Fiber*> injected_;
+
+  // Bumped whenever work is queued, so that a worker about to sleep notices
+  // work queued since it last looked
+  std::atomic<std::uint64_t> epoch_;
+  std::atomic<std::size_t> sleepers_;
+  std::atomic<bool> stopping_;
+  std::mutex idle_mutex_;
+  std::condition_variable idle_;
+
+  // Tasks not yet finished, and those of them waiting on other tasks,
+  // oldest first
+  std::mutex state_mutex_;
+  std::condition_variable settled_;
+  std::size_t live_;
+  std::list<WaitQueue::Waiter*> parked_;
+
+  // Every fiber, and those free to run another task
+  std::mutex fibers_mutex_;
+  std::vector<std::unique_ptr<Fiber>> fibers_;
+  std::vector<Fiber*> free_fibers_;
+};
+
+}  // namespace Tasks
+
+#endif
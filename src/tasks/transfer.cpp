@@ -0,0 +1,232 @@
+#include "./transfer.hpp"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "../environment.hpp"
+#include "../types/class.hpp"
+#include "../types/function.hpp"
+#include "../types/generator.hpp"
+#include "../types/list.hpp"
+#include "../types/map.hpp"
+#include "../types/native.hpp"
+#include "../types/object.hpp"
+#include "../types/rope.hpp"
+#include "../types/task.hpp"
+#include "../utils/box.hpp"
+
+namespace {
+struct Copy {
+  auto operator()(std::monostate) -> Object { return std::monostate{}; }
+
+  auto operator()(bool const b) -> Object { return b; }
+
+  auto operator()(double const number) -> Object { return number; }
+
+  auto operator()(std::string const& str) -> Object { return str; }
+
+  auto operator()(std::shared_ptr<LoxRope> const& rope) -> Object {
+    return rope->str();
+  }
+
+  auto operator()(Box<LoxFunction> const& func) -> Object {
+    return function(*func);
+  }
+
+  auto operator()(Box<LoxClass> const& klass) -> Object {
+    return copy_class(*klass);
+  }
+
+  auto operator()(std::shared_ptr<LoxInstance> const& instance) -> Object {
+    if (auto const found{copies_.find(instance.get())};
+        found != copies_.end()) {
+      return found->second;
+    }
+    auto const copy{std::make_shared<LoxInstance>()};
+    copies_[instance.get()] = copy;
+    copy->class_ = copy_class(instance->class_);
+    for (auto const& [name, value] : instance->fields_) {
+      copy->fields_[name] = std::visit(*this, value);
+    }
+    return copy;
+  }
+
+  // Natives are immutable and their state is thread-safe, but copying them
+  // keeps their reference counts local to the task
+  auto operator()(std::shared_ptr<NativeFunction> const& func) -> Object {
+    if (auto const found{copies_.find(func.get())}; found != copies_.end()) {
+      return found->second;
+    }
+    Object const copy{std::make_shared<NativeFunction>(*func)};
+    copies_[func.get()] = copy;
+    return copy;
+  }
+
+  auto operator()(std::shared_ptr<LoxList> const& list) -> Object {
+    if (auto const found{copies_.find(list.get())}; found != copies_.end()) {
+      return found->second;
+    }
+    auto const copy{std::make_shared<LoxList>()};
+    copies_[list.get()] = copy;
+    copy->elements_.reserve(list->elements_.size());
+    for (Object const& element : list->elements_) {
+      copy->elements_.push_back(std::visit(*this, element));
+    }
+    return copy;
+  }
+
+  auto operator()(std::shared_ptr<LoxMap> const& map) -> Object {
+    if (auto const found{copies_.find(map.get())}; found != copies_.end()) {
+      return found->second;
+    }
+    auto const copy{std::make_shared<LoxMap>()};
+    copies_[map.get()] = copy;
+    map->for_each([this, &copy](Object const& key, Object const& value) {
+      copy->insert_or_assign(std::visit(*this, key), std::visit(*this, value));
+    });
+    return copy;
+  }
+
+  auto operator()(std::shared_ptr<LoxTask> const& task) -> Object {
+    return task;
+  }
+
+  auto operator()(std::shared_ptr<LoxChannel> const& channel) -> Object {
+    return channel;
+  }
+
+  // A suspended body lives on a stack of its own, which can't be copied.
+  // Copies start out exhausted.
+  auto operator()(std::shared_ptr<LoxGenerator> const&) -> Object {
+    return std::make_shared<LoxGenerator>();
+  }
+
+  auto function(LoxFunction const& func) -> LoxFunction {
+    LoxFunction copy{func.declaration_, upvalues(func.upvalues_),
+                     globals(func.globals_), nullptr};
+    if (func.this_) {
+      copy.this_ = std::get<std::shared_ptr<LoxInstance>>((*this)(func.this_));
+    }
+    return copy;
+  }
+
+  // Copies of a class share their methods, as the originals do
+  auto copy_class(LoxClass const& klass) -> LoxClass {
+    if (auto const found{methods_.find(klass.methods_.get())};
+        found != methods_.end()) {
+      return LoxClass{klass.name_, found->second};
+    }
+    auto const methods{std::make_shared<LoxClass::Methods>()};
+    // Registered before copying the methods, whose closures may well hold
+    // the class
+    methods_[klass.methods_.get()] = methods;
+    for (auto const& [name, method] : *klass.methods_) {
+      (*methods)[name] = function(method);
+    }
+    return LoxClass{klass.name_, methods};
+  }
+
+  auto environment(std::shared_ptr<Environment> const& env)
+      -> std::shared_ptr<Environment> {
+    if (!env) {
+      return nullptr;
+    }
+    if (auto const found{environments_.find(env.get())};
+        found != environments_.end()) {
+      return found->second;
+    }
+    auto const copy{
+        make_environment(environment(env->enclosing()))};
+    // Registered before copying the values, which may well be closures over
+    // this very environment
+    environments_[env.get()] = copy;
+    env->for_each([this, &copy](std::string const& name, Object const& value) {
+      copy->define(name, std::visit(*this, value));
+    });
+    return copy;
+  }
+
+  auto globals(std::shared_ptr<GlobalEnvironment> const& env)
+      -> std::shared_ptr<GlobalEnvironment> {
+    if (!env) {
+      return nullptr;
+    }
+    if (auto const found{globals_.find(env.get())}; found != globals_.end()) {
+      return found->second;
+    }
+    auto const copy{std::make_shared<GlobalEnvironment>()};
+    // Registered before copying the values, as the functions among them
+    // refer back to these very globals
+    globals_[env.get()] = copy;
+    env->for_each([this, &copy](std::size_t const slot, Object const& value) {
+      copy->define(slot, std::visit(*this, value));
+    });
+    return copy;
+  }
+
+  // Copies are closed, as the environments the originals point into stay
+  // behind
+  auto upvalues(std::shared_ptr<LoxFunction::Upvalues const> const& originals)
+      -> std::shared_ptr<LoxFunction::Upvalues const> {
+    if (!originals) {
+      return nullptr;
+    }
+    if (auto const found{upvalue_lists_.find(originals.get())};
+        found != upvalue_lists_.end()) {
+      return found->second;
+    }
+    auto const copies{std::make_shared<LoxFunction::Upvalues>()};
+    upvalue_lists_[originals.get()] = copies;
+    for (std::shared_ptr<Upvalue> const& original : *originals) {
+      copies->push_back(upvalue(original));
+    }
+    return copies;
+  }
+
+  auto upvalue(std::shared_ptr<Upvalue> const& original)
+      -> std::shared_ptr<Upvalue> {
+    if (auto const found{upvalues_.find(original.get())};
+        found != upvalues_.end()) {
+      return found->second;
+    }
+    auto const copy{std::make_shared<Upvalue>()};
+    // Registered before copying the value, which may well be a closure
+    // capturing this very variable
+    upvalues_[original.get()] = copy;
+    copy->get() = std::visit(*this, original->get());
+    return copy;
+  }
+
+  std::unordered_map<void const*, Object> copies_;
+  std::unordered_map<Environment const*, std::shared_ptr<Environment>>
+      environments_;
+  std::unordered_map<GlobalEnvironment const*,
+                     std::shared_ptr<GlobalEnvironment>>
+      globals_;
+  std::unordered_map<LoxClass::Methods const*,
+                     std::shared_ptr<LoxClass::Methods const>>
+      methods_;
+  std::unordered_map<LoxFunction::Upvalues const*,
+                     std::shared_ptr<LoxFunction::Upvalues const>>
+      upvalue_lists_;
+  std::unordered_map<Upvalue const*, std::shared_ptr<Upvalue>> upvalues_;
+};
+}  // namespace
+
+auto Tasks::transfer(Object const& value) -> Object {
+  return std::visit(Copy{}, value);
+}
+
+auto Tasks::transfer(std::vector<Object> const& values)
+    -> std::vector<Object> {
+  Copy copy{};
+  std::vector<Object> copies{};
+  copies.reserve(values.size());
+  for (Object const& value : values) {
+    copies.push_back(std::visit(copy, value));
+  }
+  return copies;
+}
@@ -0,0 +1,22 @@
+#ifndef LOX_TASKS_TRANSFER
+#define LOX_TASKS_TRANSFER
+
+#include <vector>
+
+#include "../types/object.hpp"
+
+namespace Tasks {
+/**
+ * Copies a value for another task. Everything mutable the value reaches is
+ * copied, including the environments closures capture, so that no two tasks
+ * ever share mutable state; only task handles and channels, which are safe to
+ * share, are not copied. Sharing and cycles within the value are preserved,
+ * and ropes arrive flattened.
+ */
+auto transfer(Object const& value) -> Object;
+
+// Copies several values at once, preserving sharing between them too.
+auto transfer(std::vector<Object> const& values) -> std::vector<Object>;
+}  // namespace Tasks
+
+#endif
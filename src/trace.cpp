@@ -0,0 +1,131 @@
+#include "./trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+namespace {
+struct Event {
+  // Cut short if need be, so that events take no allocation
+  char name_[40];
+  bool call_;
+  std::uint32_t line_;
+  // Since the recorder started
+  std::int64_t start_ns_;
+  std::int64_t duration_ns_;
+};
+
+std::atomic<std::uint64_t> generations{0};
+
+// Written as microseconds, which the trace format counts in
+auto write_microseconds(std::ostream& out, std::int64_t const nanoseconds)
+    -> void {
+  out << nanoseconds / 1000 << '.' << std::setw(3) << std::setfill('0')
+      << nanoseconds % 1000 << std::setfill(' ');
+}
+}  // namespace
+
+namespace Trace {
+struct Recorder::Ring {
+  Ring(std::size_t const capacity, std::size_t const thread)
+      : events_(capacity), thread_{thread} {}
+
+  std::vector<Event> events_;
+  // Events ever written, the oldest of which are overwritten
+  std::uint64_t written_{0};
+  std::size_t thread_;
+};
+
+namespace {
+// The ring of the calling thread, and the recorder it was made for
+thread_local std::uint64_t ring_generation{0};
+thread_local Recorder::Ring* thread_ring{nullptr};
+}  // namespace
+
+Recorder::Recorder(std::chrono::nanoseconds const threshold,
+                   std::size_t const capacity)
+    : threshold_{threshold},
+      capacity_{std::max<std::size_t>(capacity, 1)},
+      started_{Clock::now()},
+      generation_{generations.fetch_add(1, std::memory_order_relaxed) + 1} {
+  // The ring of this thread is ready before the first event
+  static_cast<void>(ring());
+  active.store(this, std::memory_order_release);
+}
+
+Recorder::~Recorder() { active.store(nullptr, std::memory_order_release); }
+
+auto Recorder::ring() -> Ring& {
+  if (ring_generation != generation_) {
+    std::lock_guard const lock{rings_mutex_};
+    rings_.push_back(std::make_unique<Ring>(capacity_, rings_.size()));
+    thread_ring = rings_.back().get();
+    ring_generation = generation_;
+  }
+  return *thread_ring;
+}
+
+auto record(bool const call, std::string_view const name,
+            std::size_t const line, Clock::time_point const start,
+            Clock::time_point const end) -> void {
+  Recorder* const recorder{active.load(std::memory_order_acquire)};
+  if (!recorder || (call && end - start < recorder->threshold_)) {
+    return;
+  }
+
+  Recorder::Ring& ring{recorder->ring()};
+  Event& event{ring.events_[ring.written_ % ring.events_.size()]};
+  ++ring.written_;
+
+  std::size_t const size{std::min(name.size(), sizeof(event.name_) - 1)};
+  std::memcpy(event.name_, name.data(), size);
+  event.name_[size] = '\0';
+  event.call_ = call;
+  event.line_ = static_cast<std::uint32_t>(line);
+  event.start_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        start - recorder->started_)
+                        .count();
+  event.duration_ns_ =
+      std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+          .count();
+}
+
+auto Recorder::write_json(std::ostream& out) const -> void {
+  std::lock_guard const lock{rings_mutex_};
+  std::uint64_t dropped{0};
+  bool first{true};
+  out << "{\"traceEvents\": [";
+  for (std::unique_ptr<Ring> const& ring : rings_) {
+    std::uint64_t const size{ring->events_.size()};
+    std::uint64_t const oldest{ring->written_ > size ? ring->written_ - size
+                                                     : 0};
+    dropped += oldest;
+    for (std::uint64_t i = oldest; i < ring->written_; ++i) {
+      Event const& event{ring->events_[i % size]};
+      out << (first ? "\n" : ",\n") << "{\"name\": \"" << event.name_
+          << "\", \"cat\": \"" << (event.call_ ? "call" : "phase")
+          << "\", \"ph\": \"X\", \"ts\": ";
+      write_microseconds(out, event.start_ns_);
+      out << ", \"dur\": ";
+      write_microseconds(out, event.duration_ns_);
+      out << ", \"pid\": 1, \"tid\": " << ring->thread_;
+      if (event.call_) {
+        out << ", \"args\": {\"line\": " << event.line_ << '}';
+      }
+      out << '}';
+      first = false;
+    }
+  }
+  out << "\n], \"displayTimeUnit\": \"ns\", \"otherData\": {\"dropped\": "
+      << dropped << "}}\n";
+}
+}  // namespace Trace
@@ -0,0 +1,84 @@
+#ifndef LOX_TRACE
+#define LOX_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+/**
+ * Timelines of the phases of running a script and of the Lox calls it
+ * makes, as Chrome trace events, which chrome://tracing and Perfetto open.
+ * Only recorded when asked for: otherwise a call costs a relaxed load.
+ */
+namespace Trace {
+using Clock = std::chrono::steady_clock;
+
+/**
+ * Keeps the latest events of each thread in a ring allocated up front, so
+ * that recording takes no allocation nor lock. Only one recorder may exist
+ * at a time.
+ */
+class Recorder {
+ public:
+  static constexpr std::size_t DEFAULT_CAPACITY{std::size_t{1} << 16};
+
+  /**
+   * @param threshold How long a call must take to be recorded. Phases are
+   * recorded whatever they take.
+   * @param capacity The events of each thread to keep.
+   */
+  explicit Recorder(std::chrono::nanoseconds threshold = {},
+                    std::size_t capacity = DEFAULT_CAPACITY);
+
+  Recorder(Recorder const&) = delete;
+  auto operator=(Recorder const&) -> Recorder& = delete;
+
+  ~Recorder();
+
+  // Only complete once the threads that recorded are done
+  auto write_json(std::ostream& out) const -> void;
+
+  struct Ring;
+
+ private:
+  friend auto record(bool call, std::string_view name, std::size_t line,
+                     Clock::time_point start, Clock::time_point end) -> void;
+
+  auto ring() -> Ring&;
+
+  std::chrono::nanoseconds threshold_;
+  std::size_t capacity_;
+  Clock::time_point started_;
+  // Tells threads that kept a ring of an earlier recorder to make a new one
+  std::uint64_t generation_;
+  mutable std::mutex rings_mutex_;
+  std::vector<std::unique_ptr<Ring>> rings_;
+};
+
+// The recorder, while one is recording
+inline std::atomic<Recorder*> active{nullptr};
+
+// Something that ran from start to end: a call of a Lox function, class or
+// native function made on the line, or a phase
+auto record(bool call, std::string_view name, std::size_t line,
+            Clock::time_point start, Clock::time_point end) -> void;
+
+inline auto call(std::string_view const name, std::size_t const line,
+                 Clock::time_point const start, Clock::time_point const end)
+    -> void {
+  record(true, name, line, start, end);
+}
+
+inline auto phase(std::string_view const name, Clock::time_point const start,
+                  Clock::time_point const end) -> void {
+  record(false, name, 0, start, end);
+}
+}  // namespace Trace
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef LOX_TYPES_CLASS
 #define LOX_TYPES_CLASS
 
+#include <memory>
 #include <string>
 #include <unordered_map>
 
@@ -10,8 +11,13 @@
 #include "./token.hpp"
 
 struct LoxClass {
+  using Methods = std::unordered_map<std::string, LoxFunction>;
+
   std::string name_;
-  std::unordered_map<std::string, LoxFunction> methods_;
+  // Inherited methods included, so that finding one takes a single lookup
+  // however deep the hierarchy. Shared by every copy of the class, and so by
+  // its instances.
+  std::shared_ptr<Methods const> methods_;
 };
 
 struct LoxInstance {
@@ -19,6 +25,21 @@ struct LoxInstance {
   std::unordered_map<std::string, Object> fields_;
 };
 
+inline auto find_method(LoxClass const& klass, std::string const& name)
+    -> LoxFunction const* {
+  auto const method{klass.methods_->find(name)};
+  return method != klass.methods_->end() ? &method->second : nullptr;
+}
+
+// The method of the class of the instance, unless a field hides it
+inline auto find_method(LoxInstance const& instance, std::string const& name)
+    -> LoxFunction const* {
+  if (instance.fields_.contains(name)) {
+    return nullptr;
+  }
+  return find_method(instance.class_, name);
+}
+
 inline auto get(std::shared_ptr<LoxInstance> const& instance,
                 Token const& token) -> Object {
   if (auto const field{instance->fields_.find(token.lexeme_)};
@@ -26,11 +47,9 @@ inline auto get(std::shared_ptr<LoxInstance> const& instance,
     return field->second;
   }
 
-  if (auto const method{instance->class_.methods_.find(token.lexeme_)};
-      method != instance->class_.methods_.end()) {
-    auto const env{std::make_shared<Environment>(method->second.closure_)};
-    env->define("this", instance);
-    return LoxFunction{method->second.declaration_, env};
+  if (LoxFunction const* const method{find_method(*instance, token.lexeme_)}) {
+    return LoxFunction{method->declaration_, method->upvalues_,
+                       method->globals_, instance};
   }
 
   throw RuntimeError{token.line_,
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <variant>
+#include <vector>
 
 #include "../utils/box.hpp"
 #include "./token.hpp"
@@ -25,7 +26,9 @@ using Expression =
                  Box<struct BinaryExpression>, Box<struct CallExpression>,
                  Box<struct GetExpression>, Box<struct GroupingExpression>,
                  Box<struct LogicalExpression>, Box<struct SetExpression>,
-                 Box<struct UnaryExpression>>;
+                 Box<struct UnaryExpression>, Box<struct ListExpression>,
+                 Box<struct IndexExpression>, Box<struct IndexSetExpression>,
+                 Box<struct SpawnExpression>, Box<struct SuperExpression>>;
 
 struct AssignmentExpression {
   Token name_;
@@ -70,4 +73,33 @@ struct UnaryExpression {
   Expression right_;
 };
 
+struct ListExpression {
+  Token bracket_;
+  std::vector<Expression> elements_;
+};
+
+struct IndexExpression {
+  Expression object_;
+  Token bracket_;
+  Expression index_;
+};
+
+struct IndexSetExpression {
+  Expression object_;
+  Token bracket_;
+  Expression index_;
+  Expression value_;
+};
+
+// The call is always a CallExpression
+struct SpawnExpression {
+  Token keyword_;
+  Expression call_;
+};
+
+struct SuperExpression {
+  Token keyword_;
+  Token method_;
+};
+
 #endif
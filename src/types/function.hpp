@@ -2,13 +2,24 @@
 #define LOX_TYPES_FUNCTION
 
 #include <memory>
+#include <vector>
 
 #include "../environment.hpp"
 #include "./statement.hpp"
 
 struct LoxFunction {
-  FunctionStatement declaration_;
-  std::shared_ptr<Environment> closure_;
+  using Upvalues = std::vector<std::shared_ptr<Upvalue>>;
+
+  // Shared by every copy of the function and every closure it is bound to,
+  // so that copying the function doesn't copy its body
+  std::shared_ptr<FunctionStatement const> declaration_;
+  // The variables of its captures, in their order, if it has any. Shared
+  // like the declaration, so that binding a method doesn't copy them.
+  std::shared_ptr<Upvalues const> upvalues_;
+  // The environment of the globals it was declared among
+  std::shared_ptr<GlobalEnvironment> globals_;
+  // The instance a method was taken from, which its calls bind this to
+  std::shared_ptr<LoxInstance> this_;
 };
 
 #endif
@@ -0,0 +1,168 @@
+#ifndef LOX_TYPES_GENERATOR
+#define LOX_TYPES_GENERATOR
+
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "../tasks/context.hpp"
+#include "../utils/error.hpp"
+#include "./object.hpp"
+
+/**
+ * What calling a function that yields returns. The body runs on a stack of
+ * its own, so suspending at a yield keeps every interpreter frame where it is
+ * and resuming switches straight back to it: neither copies a frame.
+ */
+class LoxGenerator {
+ public:
+  using Body = std::function<void(LoxGenerator&)>;
+
+  // An exhausted generator
+  LoxGenerator() : state_{State::DONE} {}
+
+  /**
+   * @param execution Alive as long as the execution the body belongs to.
+   * Resuming the body after it has expired fails.
+   */
+  LoxGenerator(Body body, std::weak_ptr<void> execution)
+      : body_{std::move(body)},
+        execution_{std::move(execution)},
+        state_{State::READY} {}
+
+  LoxGenerator(LoxGenerator const&) = delete;
+  auto operator=(LoxGenerator const&) -> LoxGenerator& = delete;
+
+  // Unwinds a suspended body, so that what its frames hold is released
+  ~LoxGenerator() {
+    if (state_ == State::SUSPENDED) {
+      cancelled_ = true;
+      Tasks::switch_context(caller_, context_);
+    }
+    release();
+  }
+
+  /**
+   * Hands a value to the code resuming the generator, and suspends the body
+   * until it is resumed again. Only called by the body.
+   */
+  auto yield(Object value) -> void {
+    value_ = std::move(value);
+    state_ = State::SUSPENDED;
+    Tasks::switch_context(context_, caller_);
+    if (cancelled_) {
+      throw Cancelled{};
+    }
+  }
+
+  /**
+   * @throws NativeError If the generator is exhausted.
+   * @throws RuntimeError The error the body failed with.
+   */
+  auto next() -> Object {
+    if (!value_) {
+      resume();
+    }
+    if (!value_) {
+      throw NativeError{"Generator is exhausted."};
+    }
+    Object value{std::move(*value_)};
+    value_.reset();
+    return value;
+  }
+
+  /**
+   * Whether next would fail for want of values. Runs the body up to its next
+   * yield to find out.
+   */
+  auto done() -> bool {
+    if (!value_) {
+      resume();
+    }
+    return !value_;
+  }
+
+ private:
+  enum class State { READY, SUSPENDED, RUNNING, DONE };
+
+  // Thrown at the yield a destroyed generator is suspended at. Not an
+  // std::exception, so that nothing but the entry catches it.
+  struct Cancelled {};
+
+  // Stacks of finished generators, kept for the next ones
+  static constexpr std::size_t CACHED_STACKS{8};
+
+  static auto stacks() -> std::vector<std::unique_ptr<Tasks::Stack>>& {
+    thread_local std::vector<std::unique_ptr<Tasks::Stack>> stacks{};
+    return stacks;
+  }
+
+  static auto entry(void* const argument) -> void {
+    auto const generator{static_cast<LoxGenerator*>(argument)};
+    try {
+      generator->body_(*generator);
+    } catch (Cancelled const&) {
+    } catch (...) {
+      generator->error_ = std::current_exception();
+    }
+    generator->body_ = nullptr;
+    generator->state_ = State::DONE;
+    Tasks::switch_context(generator->context_, generator->caller_);
+  }
+
+  auto resume() -> void {
+    if (state_ == State::DONE) {
+      return;
+    }
+    if (state_ == State::RUNNING) {
+      throw NativeError{"Generator is already running."};
+    }
+    if (execution_.expired()) {
+      throw NativeError{
+          "Generators can't outlive the execution that created them."};
+    }
+
+    if (state_ == State::READY) {
+      if (stacks().empty()) {
+        stack_ = std::make_unique<Tasks::Stack>();
+      } else {
+        stack_ = std::move(stacks().back());
+        stacks().pop_back();
+      }
+      context_.prepare(*stack_, &entry, this);
+    }
+    state_ = State::RUNNING;
+    Tasks::switch_context(caller_, context_);
+
+    if (state_ == State::DONE) {
+      release();
+      if (error_) {
+        std::rethrow_exception(std::exchange(error_, nullptr));
+      }
+    }
+  }
+
+  auto release() -> void {
+    if (stack_ && stacks().size() < CACHED_STACKS) {
+      stacks().push_back(std::move(stack_));
+    }
+    stack_.reset();
+  }
+
+  Body body_;
+  std::weak_ptr<void> execution_;
+  State state_;
+  bool cancelled_{false};
+  // The value yielded and not taken by next yet
+  std::optional<Object> value_;
+  std::exception_ptr error_;
+  std::unique_ptr<Tasks::Stack> stack_;
+  Tasks::Context context_;
+  // Where the code that resumed the body continues once it yields
+  Tasks::Context caller_;
+};
+
+#endif
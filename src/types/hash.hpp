@@ -0,0 +1,115 @@
+#ifndef LOX_TYPES_HASH
+#define LOX_TYPES_HASH
+
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <variant>
+
+#include "../utils/box.hpp"
+#include "./class.hpp"
+#include "./function.hpp"
+#include "./object.hpp"
+#include "./rope.hpp"
+
+struct Equality {
+  auto operator()(std::monostate, std::monostate) -> bool { return true; }
+  auto operator()(bool left, bool right) -> bool { return left == right; }
+  auto operator()(double left, double right) -> bool { return left == right; }
+  auto operator()(std::string const& left, std::string const& right) -> bool {
+    return left == right;
+  }
+  auto operator()(std::string const& left,
+                  std::shared_ptr<LoxRope> const& right) -> bool {
+    return left.size() == right->size() && left == right->str();
+  }
+  auto operator()(std::shared_ptr<LoxRope> const& left,
+                  std::string const& right) -> bool {
+    return (*this)(right, left);
+  }
+  auto operator()(std::shared_ptr<LoxRope> const& left,
+                  std::shared_ptr<LoxRope> const& right) -> bool {
+    return left == right ||
+           (left->size() == right->size() && left->str() == right->str());
+  }
+  // Copies of a function, and methods taken from the same instance, are the
+  // same function: they share the declaration, the variables captured and
+  // the instance bound to
+  auto operator()(Box<LoxFunction> const& left,
+                  Box<LoxFunction> const& right) -> bool {
+    return left->declaration_ == right->declaration_ &&
+           left->upvalues_ == right->upvalues_ && left->this_ == right->this_;
+  }
+  // Copies of a class share its table of methods
+  auto operator()(Box<LoxClass> const& left, Box<LoxClass> const& right)
+      -> bool {
+    return left->methods_ == right->methods_;
+  }
+
+  // Instances, natives, lists and maps are equal only to themselves
+  template <typename T>
+  auto operator()(std::shared_ptr<T> const& left,
+                  std::shared_ptr<T> const& right) -> bool {
+    return left == right;
+  }
+
+  template <typename T, typename U>
+  auto operator()(T const& left, U const& right) -> bool {
+    return false;
+  }
+};
+
+inline auto is_equal(Object const& left, Object const& right) -> bool {
+  return std::visit(Equality{}, left, right);
+}
+
+/**
+ * Hashes values consistently with Equality: values that are equal hash the
+ * same.
+ */
+struct Hash {
+  auto operator()(std::monostate) -> std::size_t { return 0; }
+
+  auto operator()(bool b) -> std::size_t { return b ? 1 : 2; }
+
+  auto operator()(double number) -> std::size_t {
+    // 0 and -0 are equal
+    return number == 0 ? 0 : std::hash<double>{}(number);
+  }
+
+  auto operator()(std::string const& str) -> std::size_t {
+    return std::hash<std::string>{}(str);
+  }
+
+  // Ropes are equal to the strings they spell
+  auto operator()(std::shared_ptr<LoxRope> const& rope) -> std::size_t {
+    return (*this)(rope->str());
+  }
+
+  auto operator()(Box<LoxFunction> const& func) -> std::size_t {
+    std::size_t hash{std::hash<void const*>{}(func->declaration_.get())};
+    for (void const* const shared :
+         {static_cast<void const*>(func->upvalues_.get()),
+          static_cast<void const*>(func->this_.get())}) {
+      hash ^= std::hash<void const*>{}(shared) + 0x9E3779B97F4A7C15 +
+              (hash << 6) + (hash >> 2);
+    }
+    return hash;
+  }
+
+  auto operator()(Box<LoxClass> const& klass) -> std::size_t {
+    return std::hash<void const*>{}(klass->methods_.get());
+  }
+
+  template <typename T>
+  auto operator()(std::shared_ptr<T> const& ptr) -> std::size_t {
+    return std::hash<T*>{}(ptr.get());
+  }
+};
+
+inline auto hash_of(Object const& obj) -> std::size_t {
+  return std::visit(Hash{}, obj);
+}
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef LOX_TYPES_LIST
+#define LOX_TYPES_LIST
+
+#include <vector>
+
+#include "./object.hpp"
+
+struct LoxList {
+  std::vector<Object> elements_;
+};
+
+#endif
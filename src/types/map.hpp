@@ -0,0 +1,147 @@
+#ifndef LOX_TYPES_MAP
+#define LOX_TYPES_MAP
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "./class.hpp"
+#include "./function.hpp"
+#include "./hash.hpp"
+#include "./object.hpp"
+
+/**
+ * A hash map from Lox values to Lox values. Entries are stored inline in a
+ * single array with linear probing, so a lookup usually touches one or two
+ * adjacent slots and no further allocations. Removed entries leave a
+ * tombstone behind, which is dropped on the next rehash.
+ */
+class LoxMap {
+ public:
+  /**
+   * @return The value stored under the key, or nullptr if there is none.
+   */
+  [[nodiscard]] auto find(Object const& key) const -> Object const* {
+    if (size_ == 0) {
+      return nullptr;
+    }
+    Slot const& slot{slots_[probe(key, hash_of(key))]};
+    return slot.state_ == State::FULL ? &slot.value_ : nullptr;
+  }
+
+  auto insert_or_assign(Object const& key, Object const& value) -> void {
+    // Keep at least a quarter of the slots empty, counting tombstones as used
+    if ((used_ + 1) * 4 > slots_.size() * 3) {
+      rehash(std::max<std::size_t>(MIN_CAPACITY, std::bit_ceil(size_ * 2 + 1)));
+    }
+
+    std::size_t const hash{hash_of(key)};
+    Slot& slot{slots_[probe(key, hash)]};
+    if (slot.state_ == State::FULL) {
+      slot.value_ = value;
+      return;
+    }
+    if (slot.state_ == State::EMPTY) {
+      ++used_;
+    }
+    slot = Slot{key, value, hash, State::FULL};
+    ++size_;
+  }
+
+  /**
+   * @return Whether there was a value stored under the key.
+   */
+  auto erase(Object const& key) -> bool {
+    if (size_ == 0) {
+      return false;
+    }
+    Slot& slot{slots_[probe(key, hash_of(key))]};
+    if (slot.state_ != State::FULL) {
+      return false;
+    }
+    slot = Slot{std::monostate{}, std::monostate{}, 0, State::DELETED};
+    --size_;
+    return true;
+  }
+
+  [[nodiscard]] auto size() const -> std::size_t { return size_; }
+
+  /**
+   * Calls f(key, value) for every entry, in no particular order.
+   */
+  template <typename F>
+  auto for_each(F const& f) const -> void {
+    for (Slot const& slot : slots_) {
+      if (slot.state_ == State::FULL) {
+        f(slot.key_, slot.value_);
+      }
+    }
+  }
+
+ private:
+  enum class State : std::uint8_t { EMPTY, FULL, DELETED };
+
+  struct Slot {
+    Object key_;
+    Object value_;
+    std::size_t hash_{0};
+    State state_{State::EMPTY};
+  };
+
+  static constexpr std::size_t MIN_CAPACITY{8};
+
+  // The slot holding the key, or else the slot it should be inserted into:
+  // the first tombstone on its probe sequence, or the empty slot ending it.
+  [[nodiscard]] auto probe(Object const& key, std::size_t const hash) const
+      -> std::size_t {
+    std::size_t const mask{slots_.size() - 1};
+    std::size_t index{home(hash)};
+    std::size_t tombstone{slots_.size()};
+    while (true) {
+      Slot const& slot{slots_[index]};
+      if (slot.state_ == State::EMPTY) {
+        return tombstone < slots_.size() ? tombstone : index;
+      }
+      if (slot.state_ == State::DELETED) {
+        if (tombstone == slots_.size()) {
+          tombstone = index;
+        }
+      } else if (slot.hash_ == hash && is_equal(slot.key_, key)) {
+        return index;
+      }
+      index = (index + 1) & mask;
+    }
+  }
+
+  // Fibonacci hashing spreads hashes with poor low bits, such as pointers,
+  // over the whole table.
+  [[nodiscard]] auto home(std::size_t const hash) const -> std::size_t {
+    return static_cast<std::size_t>(
+        (static_cast<std::uint64_t>(hash) * 0x9E3779B97F4A7C15) >>
+        (64 - std::countr_zero(slots_.size())));
+  }
+
+  auto rehash(std::size_t const capacity) -> void {
+    std::vector<Slot> old(capacity);
+    std::swap(old, slots_);
+    used_ = size_;
+    for (Slot& slot : old) {
+      if (slot.state_ == State::FULL) {
+        std::size_t index{home(slot.hash_)};
+        while (slots_[index].state_ != State::EMPTY) {
+          index = (index + 1) & (capacity - 1);
+        }
+        slots_[index] = std::move(slot);
+      }
+    }
+  }
+
+  std::vector<Slot> slots_;
+  std::size_t size_{0};
+  // Full slots and tombstones
+  std::size_t used_{0};
+};
+
+#endif
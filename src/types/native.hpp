@@ -0,0 +1,26 @@
+#ifndef LOX_TYPES_NATIVE
+#define LOX_TYPES_NATIVE
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "./object.hpp"
+
+/**
+ * A function implemented in C++. Arguments have already been checked against
+ * the arity when the function is called.
+ */
+struct NativeFunction {
+  using Signature = auto (*)(void* state, std::vector<Object> const& args)
+      -> Object;
+
+  std::string name_;
+  std::size_t arity_;
+  Signature function_;
+  // What the function works on besides its arguments, if anything. Shared
+  // by the copies of the function, so it must be safe to use from any thread.
+  std::shared_ptr<void> state_{};
+};
+
+#endif
@@ -9,6 +9,13 @@
 
 using Object = std::variant<std::monostate, bool, double, std::string,
                             Box<struct LoxFunction>, Box<struct LoxClass>,
-                            std::shared_ptr<class LoxInstance>>;
+                            std::shared_ptr<class LoxInstance>,
+                            std::shared_ptr<struct NativeFunction>,
+                            std::shared_ptr<struct LoxList>,
+                            std::shared_ptr<class LoxMap>,
+                            std::shared_ptr<class LoxRope>,
+                            std::shared_ptr<class LoxTask>,
+                            std::shared_ptr<class LoxChannel>,
+                            std::shared_ptr<class LoxGenerator>>;
 
 #endif
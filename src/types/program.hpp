@@ -0,0 +1,43 @@
+#ifndef LOX_TYPES_PROGRAM
+#define LOX_TYPES_PROGRAM
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "./statement.hpp"
+#include "./token.hpp"
+
+/**
+ * Resolutions of globals are not scope distances but GLOBAL plus the slot
+ * the resolver numbered the name with, so that they are found at any depth.
+ * Those of declarations of globals are too, for them to define the slot.
+ */
+inline constexpr std::size_t GLOBAL{~(~std::size_t{0} >> 1)};
+
+/**
+ * The slot of a global name, numbered the first time any thread asks. Names
+ * are numbered once for the whole process, so that every program and every
+ * set of globals agree on them, and slots are never given back.
+ */
+auto global_slot(std::string const& name) -> std::size_t;
+
+auto global_name(std::size_t slot) -> std::string;
+
+/**
+ * Those of variables a function captures from around it are UPVALUE plus
+ * the index of the capture among those of the function.
+ */
+inline constexpr std::size_t UPVALUE{GLOBAL >> 1};
+
+/**
+ * The output of the front end: the parsed statements together with the
+ * scope distances computed by the resolver.
+ */
+struct Program {
+  std::vector<Statement> statements_;
+  std::unordered_map<Token, std::size_t> resolution_;
+};
+
+#endif
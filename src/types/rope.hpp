@@ -0,0 +1,133 @@
+#ifndef LOX_TYPES_ROPE
+#define LOX_TYPES_ROPE
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "./class.hpp"
+#include "./function.hpp"
+#include "./object.hpp"
+
+/**
+ * A string built by concatenation. Concatenating only links the two parts;
+ * the characters are copied once, when the string is first needed as a whole.
+ * Ropes behave exactly like strings in Lox.
+ *
+ * Accumulating a string piece by piece builds a rope as deep as there are
+ * pieces, so neither flattening nor destruction may recurse.
+ */
+class LoxRope {
+ public:
+  explicit LoxRope(std::string text)
+      : size_{text.size()}, flat_{std::move(text)} {}
+
+  LoxRope(std::shared_ptr<LoxRope> left, std::shared_ptr<LoxRope> right)
+      : size_{left->size_ + right->size_},
+        left_{std::move(left)},
+        right_{std::move(right)} {}
+
+  LoxRope(LoxRope const&) = delete;
+  auto operator=(LoxRope const&) -> LoxRope& = delete;
+
+  ~LoxRope() { release(); }
+
+  [[nodiscard]] auto size() const -> std::size_t { return size_; }
+
+  /**
+   * The characters of the string, flattened on first use.
+   */
+  [[nodiscard]] auto str() const -> std::string const& {
+    if (left_) {
+      std::string flat{};
+      flat.reserve(size_);
+      std::vector<LoxRope const*> pending{right_.get(), left_.get()};
+      while (!pending.empty()) {
+        LoxRope const* const node{pending.back()};
+        pending.pop_back();
+        if (node->left_) {
+          pending.push_back(node->right_.get());
+          pending.push_back(node->left_.get());
+        } else {
+          flat += node->flat_;
+        }
+      }
+      flat_ = std::move(flat);
+      release();
+    }
+    return flat_;
+  }
+
+ private:
+  // Drops the parts, taking over the parts of every part that dies with them.
+  auto release() const -> void {
+    if (!left_) {
+      return;
+    }
+    std::vector<std::shared_ptr<LoxRope>> pending{};
+    pending.push_back(std::move(left_));
+    pending.push_back(std::move(right_));
+    while (!pending.empty()) {
+      std::shared_ptr<LoxRope> node{std::move(pending.back())};
+      pending.pop_back();
+      if (node && node.use_count() == 1) {
+        pending.push_back(std::move(node->left_));
+        pending.push_back(std::move(node->right_));
+      }
+    }
+  }
+
+  std::size_t size_;
+  // The characters, once flattened; until then the parts below hold them
+  mutable std::string flat_;
+  mutable std::shared_ptr<LoxRope> left_;
+  mutable std::shared_ptr<LoxRope> right_;
+};
+
+/**
+ * @return The characters of a string or rope, or nullptr for other values.
+ */
+inline auto as_string(Object const& obj) -> std::string const* {
+  if (auto const str{std::get_if<std::string>(&obj)}) {
+    return str;
+  }
+  if (auto const rope{std::get_if<std::shared_ptr<LoxRope>>(&obj)}) {
+    return &(*rope)->str();
+  }
+  return nullptr;
+}
+
+inline auto is_string(Object const& obj) -> bool {
+  return std::holds_alternative<std::string>(obj) ||
+         std::holds_alternative<std::shared_ptr<LoxRope>>(obj);
+}
+
+/**
+ * Concatenates two strings or ropes. Short results are plain strings, which
+ * are cheaper to copy than to link.
+ */
+inline auto concatenate(Object const& left, Object const& right) -> Object {
+  constexpr std::size_t MIN_ROPE_SIZE{64};
+
+  auto const size{[](Object const& obj) -> std::size_t {
+    if (auto const rope{std::get_if<std::shared_ptr<LoxRope>>(&obj)}) {
+      return (*rope)->size();
+    }
+    return std::get<std::string>(obj).size();
+  }};
+  if (size(left) + size(right) < MIN_ROPE_SIZE) {
+    return *as_string(left) + *as_string(right);
+  }
+
+  auto const part{[](Object const& obj) -> std::shared_ptr<LoxRope> {
+    if (auto const rope{std::get_if<std::shared_ptr<LoxRope>>(&obj)}) {
+      return *rope;
+    }
+    return std::make_shared<LoxRope>(std::get<std::string>(obj));
+  }};
+  return std::make_shared<LoxRope>(part(left), part(right));
+}
+
+#endif
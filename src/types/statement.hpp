@@ -27,24 +27,45 @@ struct VariableStatement {
   Expression initializer_;
 };
 
+struct YieldStatement {
+  Token keyword_;
+  Expression value_;
+};
+
 using Statement =
     std::variant<std::monostate, ExpressionStatement, PrintStatement,
                  ReturnStatement, VariableStatement, Box<struct BlockStatement>,
                  Box<struct FunctionStatement>, Box<struct ClassStatement>,
-                 Box<struct IfStatement>, Box<struct WhileStatement>>;
+                 Box<struct IfStatement>, Box<struct WhileStatement>,
+                 YieldStatement>;
 
 struct BlockStatement {
   std::vector<Statement> statements_;
 };
 
+// A variable from around a function that its body uses
+struct Capture {
+  std::string name_;
+  // Resolved from where the function is declared: a scope distance, or
+  // UPVALUE plus the index of a capture of the function around it
+  std::size_t from_;
+};
+
 struct FunctionStatement {
   Token name_;
   std::vector<Token> params_;
   std::vector<Statement> body_;
+  // Whether the body yields. Calling a generator function returns a
+  // generator instead of running the body.
+  bool generator_;
+  // Filled in by the resolver, which only has the statement to read
+  mutable std::vector<Capture> captures_{};
 };
 
 struct ClassStatement {
   Token name_;
+  // A VariableExpression naming the superclass, if any
+  Expression superclass_;
   std::vector<Box<FunctionStatement>> methods_;
 };
 
@@ -55,6 +76,8 @@ struct IfStatement {
 };
 
 struct WhileStatement {
+  // The `while` or `for` it was written with
+  Token keyword_;
   Expression condition_;
   Statement body_;
 };
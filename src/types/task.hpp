@@ -0,0 +1,114 @@
+#ifndef LOX_TYPES_TASK
+#define LOX_TYPES_TASK
+
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <utility>
+
+#include "../tasks/scheduler.hpp"
+#include "../tasks/transfer.hpp"
+#include "../utils/error.hpp"
+#include "./object.hpp"
+
+/**
+ * The handle `spawn` and the I/O builtins return, through which the result of
+ * a task or an operation is joined. Handles may be shared between tasks.
+ */
+class LoxTask {
+ public:
+  LoxTask() = default;
+
+  /**
+   * @param io Whether I/O finishes the task, from outside the scheduler,
+   * rather than another task. Tasks joining it are not deadlocked.
+   */
+  explicit LoxTask(bool const io) : joiners_{io} {}
+
+  /**
+   * Called by the task as it finishes. The result must already be a
+   * transferred copy, reachable from nowhere else.
+   */
+  auto finish(Object result) -> void {
+    std::lock_guard const lock{mutex_};
+    result_ = std::move(result);
+    done_ = true;
+    joiners_.notify_all();
+  }
+
+  /**
+   * @param error A RuntimeError, or a NativeError to report at the line of
+   * each join.
+   */
+  auto fail(std::exception_ptr error) -> void {
+    std::lock_guard const lock{mutex_};
+    error_ = std::move(error);
+    done_ = true;
+    joiners_.notify_all();
+  }
+
+  /**
+   * Waits for the task to finish. Tasks may be joined any number of times,
+   * and each join gets a copy of the result of its own.
+   *
+   * @throws RuntimeError, NativeError The error the task failed with.
+   */
+  auto join() -> Object {
+    std::unique_lock lock{mutex_};
+    while (!done_) {
+      joiners_.wait(lock);
+    }
+    if (error_) {
+      std::rethrow_exception(error_);
+    }
+    return Tasks::transfer(result_);
+  }
+
+ private:
+  std::mutex mutex_;
+  Tasks::WaitQueue joiners_;
+  bool done_{false};
+  Object result_;
+  std::exception_ptr error_;
+};
+
+/**
+ * A bounded queue of values between tasks. Sending to a full channel or
+ * receiving from an empty one waits. Values are transferred, so the receiver
+ * gets a copy of its own.
+ */
+class LoxChannel {
+ public:
+  explicit LoxChannel(std::size_t const capacity) : capacity_{capacity} {}
+
+  auto send(Object const& value) -> void {
+    Object message{Tasks::transfer(value)};
+    std::unique_lock lock{mutex_};
+    while (buffer_.size() >= capacity_) {
+      senders_.wait(lock);
+    }
+    buffer_.push_back(std::move(message));
+    receivers_.notify_one();
+  }
+
+  auto receive() -> Object {
+    std::unique_lock lock{mutex_};
+    while (buffer_.empty()) {
+      receivers_.wait(lock);
+    }
+    Object message{std::move(buffer_.front())};
+    buffer_.pop_front();
+    senders_.notify_one();
+    return message;
+  }
+
+ private:
+  std::size_t capacity_;
+  std::mutex mutex_;
+  std::deque<Object> buffer_;
+  Tasks::WaitQueue senders_;
+  Tasks::WaitQueue receivers_;
+};
+
+#endif
@@ -9,6 +9,8 @@ enum class TokenType {
   RIGHT_PAREN,
   LEFT_BRACE,
   RIGHT_BRACE,
+  LEFT_BRACKET,
+  RIGHT_BRACKET,
   COMMA,
   DOT,
   MINUS,
@@ -41,11 +43,13 @@ enum class TokenType {
   OR,
   PRINT,
   RETURN,
+  SPAWN,
   SUPER,
   THIS,
   TRUE,
   VAR,
   WHILE,
+  YIELD,
 
   EOFF
 };
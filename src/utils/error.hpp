@@ -8,7 +8,9 @@
 #include "../types/token.hpp"
 
 struct CompileTimeError : std::exception {
-  virtual auto report() const -> void = 0;
+  virtual auto report(std::ostream& out) const -> void = 0;
+
+  auto report() const -> void { report(std::cerr); }
 };
 
 struct RuntimeError : std::exception {
@@ -18,9 +20,21 @@ struct RuntimeError : std::exception {
   std::size_t line_;
   std::string message_;
 
-  auto report() const -> void {
-    std::cerr << "[line " << line_ << "] " << message_ << '\n';
+  auto report(std::ostream& out = std::cerr) const -> void {
+    out << "[line " << line_ << "] " << message_ << '\n';
   }
 };
 
+// Thrown once an execution exceeds its Budget
+struct BudgetError : RuntimeError {
+  using RuntimeError::RuntimeError;
+};
+
+// Thrown by native functions, and reported as a RuntimeError at the call.
+struct NativeError : std::exception {
+  explicit NativeError(std::string const& message) : message_(message) {}
+
+  std::string message_;
+};
+
 #endif
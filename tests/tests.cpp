@@ -1,10 +1,209 @@
 #include <gtest/gtest.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
 #include <fstream>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <variant>
+#include <vector>
 
+#include "../src/builtins.hpp"
+#include "../src/core.hpp"
+#include "../src/counters.hpp"
+#include "../src/incremental.hpp"
+#include "../src/io/loop.hpp"
+#include "../src/isolate.hpp"
+#include "../src/memory.hpp"
+#include "../src/output.hpp"
+#include "../src/phases.hpp"
+#include "../src/profiler.hpp"
+#include "../src/scanner.hpp"
+#include "../src/serializer.hpp"
+#include "../src/tasks/deque.hpp"
+#include "../src/tasks/scheduler.hpp"
+#include "../src/trace.hpp"
+#include "../src/types/map.hpp"
+#include "../src/types/rope.hpp"
+#include "../src/types/task.hpp"
 #include "../src/utils/reader.hpp"
 
+namespace {
+// Gives the tokens of a tree the ids of the tokens in the same places of
+// another scan, for trees of the same text to compare equal
+struct Renumber {
+  std::unordered_map<std::size_t, std::size_t> const& ids_;
+
+  auto operator()(Token& token) const -> void {
+    token.token_id_ = ids_.at(token.token_id_);
+  }
+
+  template <typename... Ts>
+  auto operator()(std::variant<Ts...>& variant) const -> void {
+    std::visit(*this, variant);
+  }
+
+  template <typename T>
+  auto operator()(Box<T>& box) const -> void {
+    (*this)(*box);
+  }
+
+  template <typename T>
+  auto operator()(std::vector<T>& elements) const -> void {
+    for (T& element : elements) {
+      (*this)(element);
+    }
+  }
+
+  auto operator()(std::monostate) const -> void {}
+
+  auto operator()(LiteralExpression&) const -> void {}
+
+  auto operator()(ThisExpression& expr) const -> void {
+    (*this)(expr.keyword_);
+  }
+
+  auto operator()(VariableExpression& expr) const -> void {
+    (*this)(expr.name_);
+  }
+
+  auto operator()(AssignmentExpression& expr) const -> void {
+    (*this)(expr.name_);
+    (*this)(expr.value_);
+  }
+
+  auto operator()(BinaryExpression& expr) const -> void {
+    (*this)(expr.left_);
+    (*this)(expr.op_);
+    (*this)(expr.right_);
+  }
+
+  auto operator()(CallExpression& expr) const -> void {
+    (*this)(expr.callee_);
+    (*this)(expr.paren_);
+    (*this)(expr.arguments_);
+  }
+
+  auto operator()(GetExpression& expr) const -> void {
+    (*this)(expr.name_);
+    (*this)(expr.object_);
+  }
+
+  auto operator()(GroupingExpression& expr) const -> void {
+    (*this)(expr.expression_);
+  }
+
+  auto operator()(LogicalExpression& expr) const -> void {
+    (*this)(expr.left_);
+    (*this)(expr.op_);
+    (*this)(expr.right_);
+  }
+
+  auto operator()(SetExpression& expr) const -> void {
+    (*this)(expr.name_);
+    (*this)(expr.object_);
+    (*this)(expr.value_);
+  }
+
+  auto operator()(UnaryExpression& expr) const -> void {
+    (*this)(expr.op_);
+    (*this)(expr.right_);
+  }
+
+  auto operator()(ListExpression& expr) const -> void {
+    (*this)(expr.bracket_);
+    (*this)(expr.elements_);
+  }
+
+  auto operator()(IndexExpression& expr) const -> void {
+    (*this)(expr.object_);
+    (*this)(expr.bracket_);
+    (*this)(expr.index_);
+  }
+
+  auto operator()(IndexSetExpression& expr) const -> void {
+    (*this)(expr.object_);
+    (*this)(expr.bracket_);
+    (*this)(expr.index_);
+    (*this)(expr.value_);
+  }
+
+  auto operator()(SpawnExpression& expr) const -> void {
+    (*this)(expr.keyword_);
+    (*this)(expr.call_);
+  }
+
+  auto operator()(SuperExpression& expr) const -> void {
+    (*this)(expr.keyword_);
+    (*this)(expr.method_);
+  }
+
+  auto operator()(ExpressionStatement& stmt) const -> void {
+    (*this)(stmt.expression_);
+  }
+
+  auto operator()(PrintStatement& stmt) const -> void {
+    (*this)(stmt.expression_);
+  }
+
+  auto operator()(ReturnStatement& stmt) const -> void {
+    (*this)(stmt.keyword_);
+    (*this)(stmt.value_);
+  }
+
+  auto operator()(YieldStatement& stmt) const -> void {
+    (*this)(stmt.keyword_);
+    (*this)(stmt.value_);
+  }
+
+  auto operator()(VariableStatement& stmt) const -> void {
+    (*this)(stmt.name_);
+    (*this)(stmt.initializer_);
+  }
+
+  auto operator()(BlockStatement& stmt) const -> void {
+    (*this)(stmt.statements_);
+  }
+
+  auto operator()(FunctionStatement& stmt) const -> void {
+    (*this)(stmt.name_);
+    (*this)(stmt.params_);
+    (*this)(stmt.body_);
+  }
+
+  auto operator()(ClassStatement& stmt) const -> void {
+    (*this)(stmt.name_);
+    (*this)(stmt.superclass_);
+    (*this)(stmt.methods_);
+  }
+
+  auto operator()(IfStatement& stmt) const -> void {
+    (*this)(stmt.condition_);
+    (*this)(stmt.then_branch_);
+    (*this)(stmt.else_branch_);
+  }
+
+  auto operator()(WhileStatement& stmt) const -> void {
+    (*this)(stmt.keyword_);
+    (*this)(stmt.condition_);
+    (*this)(stmt.body_);
+  }
+};
+}  // namespace
+
 TEST(ReadFileTest, FileExists) {
   // Arrange
   std::string const path = "../tests/test.txt";
@@ -36,3 +235,1074 @@ TEST(ReadFileTest, EmptyFile) {
   std::string expected = "";
   ASSERT_EQ(expected, result);
 }
+
+TEST(SerializerTest, RoundTripsPrograms) {
+  // Arrange
+  Core::Script const script{std::get<Core::Script>(Core::compile(
+      "fun make() {\n"
+      "  var count = 0;\n"
+      "  fun inc() { count = count + 1; return count; }\n"
+      "  return inc;\n"
+      "}\n"
+      "class Shape {\n"
+      "  named(name) { this.name = name; return this; }\n"
+      "  describe() { return this.name + \" with \" + sides() + \" sides\"; }\n"
+      "}\n"
+      "class Square < Shape {\n"
+      "  describe() { return \"a \" + super.describe(); }\n"
+      "}\n"
+      "fun sides() { return \"four\"; }\n"
+      "var counter = make();\n"
+      "counter();\n"
+      "print counter();\n"
+      "print Square().named(\"square\").describe();\n"))};
+  Program const& program{script.program()};
+  Output::MemorySink expected{};
+  Output::MemorySink out{};
+
+  // Act
+  std::string const bytes{Serializer::serialize(program)};
+  std::optional<Program> decoded{Serializer::deserialize(bytes)};
+  std::optional<Program> const truncated{
+      Serializer::deserialize(bytes.substr(0, bytes.size() - 1))};
+
+  // Assert
+  ASSERT_TRUE(decoded.has_value());
+  ASSERT_FALSE(truncated.has_value());
+  ASSERT_EQ(bytes, Serializer::serialize(*decoded));
+  ASSERT_EQ(program.resolution_.size(), decoded->resolution_.size());
+  for (auto const& [token, resolution] : program.resolution_) {
+    ASSERT_EQ(resolution, decoded->resolution_.at(token));
+  }
+  ASSERT_TRUE(std::any_of(
+      program.resolution_.begin(), program.resolution_.end(),
+      [](auto const& entry) { return entry.second >= GLOBAL; }));
+  ASSERT_TRUE(std::any_of(
+      program.resolution_.begin(), program.resolution_.end(),
+      [](auto const& entry) {
+        return entry.second >= UPVALUE && entry.second < GLOBAL;
+      }));
+  ASSERT_FALSE(Core::execute(script, expected).has_value());
+  ASSERT_FALSE(
+      Core::execute(Core::Script{std::move(*decoded)}, out).has_value());
+  ASSERT_EQ("2\na square with four sides\n", expected.contents());
+  ASSERT_EQ(expected.contents(), out.contents());
+}
+
+TEST(CacheTest, HitsMissesAndRejectsStaleEntries) {
+  // Arrange
+  std::filesystem::path const directory{testing::TempDir() + "lox_cache_test"};
+  std::filesystem::remove_all(directory);
+  Cache::Store store{directory};
+  std::string const source{"var a = 1;\nprint a;\n"};
+  std::string const other{"print 2;\n"};
+  Core::Script const script{std::get<Core::Script>(Core::compile(source))};
+  auto const read{[](std::filesystem::path const& path) {
+    std::ifstream file{path, std::ios::binary};
+    std::stringstream contents{};
+    contents << file.rdbuf();
+    return contents.str();
+  }};
+  auto const entry{[&](std::string const& text) {
+    for (auto const& file : std::filesystem::directory_iterator{directory}) {
+      if (read(file.path()).find(text) != std::string::npos) {
+        return file.path();
+      }
+    }
+    return std::filesystem::path{};
+  }};
+
+  // Act
+  auto const missed{store.load(source)};
+  store.store(source, script.program());
+  store.store(other, std::get<Core::Script>(Core::compile(other)).program());
+  auto const hit{store.load(source)};
+  // An entry of another source at the path of this one, as a collision of
+  // their hashes would leave it
+  std::filesystem::copy_file(
+      entry(source), entry(other),
+      std::filesystem::copy_options::overwrite_existing);
+  auto const collided{store.load(other)};
+  // An entry of another encoding of the AST
+  std::string stale{read(entry(source))};
+  stale.replace(0, stale.find('\n'), "0.0.0");
+  std::ofstream{entry(source), std::ios::binary | std::ios::trunc} << stale;
+  auto const outdated{store.load(source)};
+
+  // Assert
+  ASSERT_FALSE(missed.has_value());
+  ASSERT_TRUE(hit.has_value());
+  ASSERT_EQ(Serializer::serialize(script.program()),
+            Serializer::serialize(*hit));
+  ASSERT_FALSE(collided.has_value());
+  ASSERT_FALSE(outdated.has_value());
+  ASSERT_EQ(1, store.stats().hits_);
+  ASSERT_EQ(3, store.stats().misses_);
+  std::filesystem::remove_all(directory);
+}
+
+TEST(IncrementalTest, MatchesFullCompileAfterEdits) {
+  // Arrange
+  Incremental::Document document{
+      "var a = 1;\n"
+      "fun f(x) {\n"
+      "  if (x > a) return x + a;\n"
+      "  return a;\n"
+      "}\n"
+      "class C { get() { return f(a); } }\n"
+      "print C().get();\n"};
+  auto const at{[&](std::string const& text) {
+    std::size_t const offset{document.source().find(text)};
+    EXPECT_NE(std::string::npos, offset) << text;
+    return offset;
+  }};
+  auto const edits{std::to_array<std::function<Incremental::Edit()>>({
+      // A single character
+      [&]() { return Incremental::Edit{at("1;"), 1, "7"}; },
+      // Lines added and removed before the rest of the file
+      [&]() { return Incremental::Edit{at("class"), 0, "\n\n"}; },
+      [&]() { return Incremental::Edit{at("\n\nclass"), 2, ""}; },
+      // A global added, then used and removed again
+      [&]() { return Incremental::Edit{at("fun"), 0, "var b = a;\n"}; },
+      [&]() { return Incremental::Edit{at("x + a"), 5, "x + b"}; },
+      [&]() { return Incremental::Edit{at("var b"), 11, ""}; },
+      // A string spanning lines, and a declaration renamed
+      [&]() { return Incremental::Edit{0, 0, "print \"two\nlines\";\n"}; },
+      [&]() { return Incremental::Edit{at("class C"), 7, "class D"}; },
+      [&]() { return Incremental::Edit{at("print C"), 7, "print D"}; },
+      // The string removed again
+      [&]() { return Incremental::Edit{0, at("var a"), ""}; },
+  })};
+  std::size_t reused{0};
+
+  for (auto const& edit : edits) {
+    // Act
+    document.apply(edit());
+    reused += document.stats().declarations_reused_;
+    std::vector<Token> const tokens{Scanner::scan_tokens(document.source())};
+    Core::Script const script{
+        std::get<Core::Script>(Core::compile(document.source()))};
+    Program const& full{script.program()};
+
+    // Assert
+    ASSERT_EQ(tokens.size(), document.tokens().size()) << document.source();
+    std::unordered_map<std::size_t, std::size_t> ids{};
+    for (std::size_t i = 0; i < tokens.size(); ++i) {
+      Token const& token{document.tokens()[i]};
+      ASSERT_EQ(tokens[i].type_, token.type_);
+      ASSERT_EQ(tokens[i].lexeme_, token.lexeme_);
+      ASSERT_EQ(tokens[i].literal_, token.literal_);
+      ASSERT_EQ(tokens[i].line_, token.line_) << token.lexeme_;
+      ids.emplace(token.token_id_, tokens[i].token_id_);
+    }
+
+    std::vector<Statement> statements{document.statements()};
+    Renumber{ids}(statements);
+    ASSERT_EQ(Serializer::serialize(Program{full.statements_, {}}),
+              Serializer::serialize(Program{std::move(statements), {}}))
+        << document.source();
+
+    ASSERT_EQ(full.resolution_.size(), document.resolution().size());
+    for (auto const& [token, resolution] : document.resolution()) {
+      ASSERT_EQ(full.resolution_.at(Token{TokenType::IDENTIFIER, "",
+                                          std::monostate{}, 0,
+                                          ids.at(token.token_id_)}),
+                resolution);
+    }
+  }
+  // The edits were applied incrementally rather than by starting over
+  ASSERT_LT(0, reused);
+}
+
+TEST(IncrementalTest, KeepsSyntaxErrorsUntilEditedAway) {
+  // Arrange
+  Incremental::Document document{
+      "var a = 1;\n"
+      "print a;\n"
+      "print a + 1;\n"};
+  auto const at{[&](std::string const& text) {
+    return document.source().find(text);
+  }};
+
+  // Act
+  document.apply(Incremental::Edit{at("+ 1") + 2, 1, ""});
+  std::vector<Parser::Error> const broken{document.diagnostics()};
+  document.apply(Incremental::Edit{0, 0, "\n"});
+  std::vector<Parser::Error> const shifted{document.diagnostics()};
+  document.apply(Incremental::Edit{at("+ ;"), 2, "+ 2"});
+  std::vector<Parser::Error> const fixed{document.diagnostics()};
+
+  // Assert
+  ASSERT_EQ(1, broken.size());
+  ASSERT_EQ(3, broken[0].line_);
+  ASSERT_EQ("Expected expression.", broken[0].message_);
+  ASSERT_EQ(1, shifted.size());
+  ASSERT_EQ(4, shifted[0].line_);
+  ASSERT_TRUE(fixed.empty());
+  ASSERT_EQ("\nvar a = 1;\nprint a;\nprint a + 2;\n", document.source());
+  ASSERT_TRUE(std::holds_alternative<Core::Script>(
+      Core::compile(document.source())));
+}
+
+TEST(NativeTest, DerivesArityAndChecksArguments) {
+  // Arrange
+  std::map<std::string, Object> const natives{builtins()};
+  auto const arity{[&](std::string const& name) {
+    return std::get<std::shared_ptr<NativeFunction>>(natives.at(name))->arity_;
+  }};
+  auto const run{[](std::string const& source) {
+    Output::MemorySink out{};
+    auto const error{
+        Core::execute(std::get<Core::Script>(Core::compile(source)), out)};
+    return error ? error->message_ : out.contents();
+  }};
+
+  // Act
+  std::string const timed{run(
+      "var start = clock();\n"
+      "for (var i = 0; i < 1000; i = i + 1) {}\n"
+      "print clock() - start >= 0;\n"
+      "print clock;\n")};
+  std::string const count{run("var l = List();\npush(l);\n")};
+  std::string const first{run("var l = List();\n\npush(1, l);\n")};
+  std::string const second{run("has(Map(), nil);\nChannel(nil);\n")};
+
+  // Assert
+  ASSERT_EQ(0, arity("clock"));
+  ASSERT_EQ(1, arity("len"));
+  ASSERT_EQ(2, arity("push"));
+  ASSERT_EQ("true\n<native fn clock>\n", timed);
+  ASSERT_EQ("[line 2] Expected 2 arguments but got 1.", count);
+  ASSERT_EQ("[line 3] Expected a list as argument 1.", first);
+  ASSERT_EQ("[line 2] Expected a number as argument 1.", second);
+}
+
+TEST(MapTest, KeysFunctionsClassesAndInstances) {
+  // Arrange
+  Core::Script const script{std::get<Core::Script>(Core::compile(
+      "fun f() {}\n"
+      "fun make() { var n = 0; fun g() { return n; } return g; }\n"
+      "class C { m() {} }\n"
+      "var c = C();\n"
+      "var m = Map();\n"
+      "m[f] = \"function\";\n"
+      "m[C] = \"class\";\n"
+      "m[c] = \"instance\";\n"
+      "m[c.m] = \"method\";\n"
+      "m[f] = \"function again\";\n"
+      "print len(m);\n"
+      "print m[f] + \", \" + m[C] + \", \" + m[c] + \", \" + m[c.m];\n"
+      "print has(m, C()) or has(m, C().m) or has(m, make);\n"
+      "print f == f and C == C and c.m == c.m;\n"
+      "print make() == make();\n"))};
+  Output::MemorySink out{};
+
+  // Act
+  auto const error{Core::execute(script, out)};
+
+  // Assert
+  ASSERT_FALSE(error.has_value());
+  ASSERT_EQ(
+      "4\nfunction again, class, instance, method\nfalse\ntrue\nfalse\n",
+      out.contents());
+}
+
+TEST(MapTest, ReinsertsOverTombstonesPastTheLoadFactor) {
+  // Arrange
+  LoxMap map{};
+
+  // Act
+  for (int i = 0; i < 100; ++i) {
+    map.insert_or_assign(static_cast<double>(i), static_cast<double>(i));
+  }
+  for (int i = 0; i < 100; i += 2) {
+    ASSERT_TRUE(map.erase(static_cast<double>(i)));
+  }
+  // Enough churn to fill the table with tombstones several times over
+  for (int round = 0; round < 20; ++round) {
+    for (int i = 100; i < 150; ++i) {
+      map.insert_or_assign(static_cast<double>(i), std::monostate{});
+    }
+    for (int i = 100; i < 150; ++i) {
+      ASSERT_TRUE(map.erase(static_cast<double>(i)));
+    }
+  }
+  for (int i = 0; i < 100; i += 2) {
+    map.insert_or_assign(static_cast<double>(i), static_cast<double>(-i));
+  }
+
+  // Assert
+  ASSERT_EQ(100, map.size());
+  for (int i = 0; i < 100; ++i) {
+    Object const* const value{map.find(static_cast<double>(i))};
+    ASSERT_NE(nullptr, value);
+    ASSERT_EQ(i % 2 == 0 ? -i : i, std::get<double>(*value));
+  }
+  ASSERT_EQ(nullptr, map.find(100.0));
+  ASSERT_FALSE(map.erase(100.0));
+  ASSERT_NE(nullptr, map.find(-0.0));
+}
+
+TEST(MapTest, FindsRopesAndStringsAlike) {
+  // Arrange
+  std::string const half(40, 'x');
+  Object const rope{concatenate(half, half)};
+  Object const str{half + half};
+  LoxMap map{};
+
+  // Act
+  map.insert_or_assign(rope, 1.0);
+  map.insert_or_assign(str, 2.0);
+  map.insert_or_assign(half, 3.0);
+
+  // Assert
+  ASSERT_TRUE(std::holds_alternative<std::shared_ptr<LoxRope>>(rope));
+  ASSERT_EQ(hash_of(str), hash_of(rope));
+  ASSERT_EQ(2, map.size());
+  ASSERT_EQ(2.0, std::get<double>(*map.find(rope)));
+  ASSERT_EQ(2.0, std::get<double>(*map.find(concatenate(half, half))));
+  ASSERT_TRUE(map.erase(rope));
+  ASSERT_EQ(nullptr, map.find(str));
+}
+
+TEST(IndexTest, ReportsBadIndices) {
+  // Arrange
+  auto const run{[](std::string const& source) {
+    Output::MemorySink out{};
+    auto const error{
+        Core::execute(std::get<Core::Script>(Core::compile(source)), out)};
+    return error ? error->message_ : out.contents();
+  }};
+  std::string const list{"var l = [1, 2];\n"};
+
+  // Act
+  std::string const indexed{run(list + "l[1] = l[0] + 2;\nprint l;\n")};
+  std::string const past_end{run(list + "print l[2];\n")};
+  std::string const negative{run(list + "l[-1] = 0;\n")};
+  std::string const fraction{run(list + "print l[0.5];\n")};
+  std::string const string{run(list + "print l[\"0\"];\n")};
+  std::string const missing{run("var m = Map();\nm[1] = 2;\nprint m[2];\n")};
+  std::string const number{run("print 1[0];\n")};
+
+  // Assert
+  ASSERT_EQ("[1, 3]\n", indexed);
+  ASSERT_EQ("[line 2] List index out of range.", past_end);
+  ASSERT_EQ("[line 2] List index out of range.", negative);
+  ASSERT_EQ("[line 2] List index must be an integer.", fraction);
+  ASSERT_EQ("[line 2] List index must be an integer.", string);
+  ASSERT_EQ("[line 3] Undefined key.", missing);
+  ASSERT_EQ("[line 1] Only lists and maps can be indexed.", number);
+}
+
+TEST(RopeTest, FlattensDeepConcatenations) {
+  // Arrange
+  Object text{std::string{}};
+  std::string expected{};
+
+  // Act
+  for (int i = 0; i < 100'000; ++i) {
+    std::string const piece{"ab" + std::to_string(i % 10)};
+    text = concatenate(text, piece);
+    expected += piece;
+  }
+  auto const rope{std::get<std::shared_ptr<LoxRope>>(text)};
+  std::size_t const size{rope->size()};
+
+  // Assert
+  ASSERT_EQ(expected.size(), size);
+  ASSERT_EQ(expected, rope->str());
+  ASSERT_TRUE(is_equal(text, expected));
+  ASSERT_TRUE(is_equal(expected, text));
+  ASSERT_FALSE(is_equal(text, expected + "!"));
+  ASSERT_EQ(hash_of(expected), hash_of(text));
+}
+
+TEST(RopeTest, BehavesLikeTheStringItSpells) {
+  // Arrange
+  std::string const spelled(200, 'a');
+  Core::Script const script{std::get<Core::Script>(Core::compile(
+      "var s = \"\";\n"
+      "var t = \"\";\n"
+      "for (var i = 0; i < 100; i = i + 1) {\n"
+      "  s = s + \"aa\";\n"
+      "  t = \"aa\" + t;\n"
+      "}\n"
+      "var m = Map();\n"
+      "m[s] = 1;\n"
+      "m[\"" + spelled + "\"] = 2;\n"
+      "print len(s) + len(t + \"a\");\n"
+      "print s == t and t == \"" + spelled + "\";\n"
+      "print s == t + \"a\";\n"
+      "print len(m) + m[t];\n"))};
+  Output::MemorySink out{};
+
+  // Act
+  auto const error{Core::execute(script, out)};
+
+  // Assert
+  ASSERT_FALSE(error.has_value());
+  ASSERT_EQ("401\ntrue\nfalse\n3\n", out.contents());
+}
+
+TEST(SinkTest, FormatsNumbers) {
+  // Arrange
+  Output::MemorySink sink{};
+
+  // Act
+  for (double const number : {0.0, -0.0, 3.0, -42.0, 1e6, 0.1, 2.5, 1.0 / 3,
+                               1e21, 1e-7}) {
+    sink.write(number);
+    sink.write('\n');
+  }
+
+  // Assert
+  std::string const expected =
+      "0\n-0\n3\n-42\n1000000\n0.1\n2.5\n0.3333333333333333\n1e+21\n1e-07\n";
+  ASSERT_EQ(expected, sink.contents());
+}
+
+TEST(SinkTest, WritesPastCapacity) {
+  // Arrange
+  Output::MemorySink sink{4};
+  std::string expected{};
+
+  // Act
+  for (int i = 0; i < 100; ++i) {
+    sink.write("ab");
+    sink.write(static_cast<double>(i));
+    sink.write(std::string(i % 7, 'x'));
+    expected += "ab" + std::to_string(i) + std::string(i % 7, 'x');
+  }
+
+  // Assert
+  ASSERT_EQ(expected, sink.contents());
+}
+
+TEST(CoreTest, ExecutesScriptManyTimes) {
+  // Arrange
+  Core::Script const script{std::get<Core::Script>(
+      Core::compile("var total = input * 2; print total;", {"input"}))};
+  Output::MemorySink out{};
+
+  // Act
+  for (double input : {1.0, 2.0, 3.0}) {
+    Core::Globals globals{};
+    globals.define("input", input);
+    ASSERT_FALSE(Core::execute(script, globals, out).has_value());
+  }
+
+  // Assert
+  ASSERT_EQ("2\n4\n6\n", out.contents());
+}
+
+TEST(CoreTest, ReturnsErrors) {
+  // Arrange
+  Output::MemorySink out{};
+
+  // Act
+  auto const compiled{Core::compile("print 1;\nprint (;")};
+  auto const failed{Core::execute(
+      std::get<Core::Script>(Core::compile("print nil.x;")), out)};
+
+  // Assert
+  auto const errors{std::get<std::vector<Core::Error>>(compiled)};
+  ASSERT_EQ(1, errors.size());
+  ASSERT_EQ(Core::Error::Phase::COMPILE, errors[0].phase_);
+  ASSERT_TRUE(failed.has_value());
+  ASSERT_EQ("[line 1] Only instances have properties.", failed->message_);
+}
+
+TEST(IsolateTest, RunsConcurrentlyWithSeparateGlobals) {
+  // Arrange
+  constexpr int ISOLATES{8};
+  Core::Script const script{std::get<Core::Script>(Core::compile(
+      "var counter = seed * 1000000;\n"
+      "for (var i = 0; i < 100000; i = i + 1) {\n"
+      "  counter = counter + 1;\n"
+      "  if (i == 50000) print counter;\n"
+      "}\n"
+      "print counter;\n",
+      {"seed"}))};
+  std::vector<std::unique_ptr<Core::Isolate>> isolates{};
+  std::vector<Output::MemorySink*> sinks{};
+  for (int i = 0; i < ISOLATES; ++i) {
+    auto out{std::make_unique<Output::MemorySink>()};
+    sinks.push_back(out.get());
+    isolates.push_back(std::make_unique<Core::Isolate>(script, std::move(out)));
+    isolates.back()->globals().define("seed", static_cast<double>(i));
+  }
+
+  // Act
+  std::vector<std::future<std::optional<Core::Error>>> results{};
+  {
+    Core::Pool pool{4};
+    for (auto& isolate : isolates) {
+      results.push_back(pool.submit(*isolate));
+    }
+    for (auto& result : results) {
+      ASSERT_FALSE(result.get().has_value());
+    }
+  }
+
+  // Assert
+  for (int i = 0; i < ISOLATES; ++i) {
+    ASSERT_EQ(std::to_string(i * 1000000 + 50001) + "\n" +
+                  std::to_string(i * 1000000 + 100000) + "\n",
+              sinks[i]->contents());
+  }
+}
+
+TEST(TaskTest, PassesCopiesBetweenTasks) {
+  // Arrange
+  Core::Script const script{std::get<Core::Script>(Core::compile(
+      "var c = Channel(1);\n"
+      "var l = [1];\n"
+      "fun f(ch, list) { push(list, 2); send(ch, list); return len(list); }\n"
+      "var t = spawn f(c, l);\n"
+      "print receive(c);\n"
+      "print join(t);\n"
+      "print l;\n"))};
+  Output::MemorySink out{};
+
+  // Act
+  auto const error{Core::execute(script, out)};
+
+  // Assert
+  ASSERT_FALSE(error.has_value());
+  ASSERT_EQ("[1, 2]\n2\n[1]\n", out.contents());
+}
+
+TEST(TaskTest, HandsEachDequeItemOutOnce) {
+  // Arrange: a small deque, for pushes to grow it under the thieves
+  constexpr int ITEMS{100000};
+  constexpr int THIEVES{3};
+  std::vector<int> items(ITEMS);
+  std::vector<std::atomic<int>> seen(ITEMS);
+  Tasks::Deque<int> deque{2};
+  std::atomic<bool> pushing{true};
+  auto const record{[&](int* const item) {
+    seen[static_cast<std::size_t>(item - items.data())].fetch_add(1);
+  }};
+
+  // Act: the owner pushes and takes every other item as thieves steal
+  std::vector<std::thread> thieves{};
+  for (int i = 0; i < THIEVES; ++i) {
+    thieves.emplace_back([&] {
+      while (pushing.load()) {
+        if (int* const item{deque.steal()}) {
+          record(item);
+        }
+      }
+      while (int* const item{deque.steal()}) {
+        record(item);
+      }
+    });
+  }
+  for (int i = 0; i < ITEMS; ++i) {
+    deque.push(&items[static_cast<std::size_t>(i)]);
+    if (i % 2 == 1) {
+      if (int* const item{deque.take()}) {
+        record(item);
+      }
+    }
+  }
+  while (int* const item{deque.take()}) {
+    record(item);
+  }
+  pushing = false;
+  for (std::thread& thief : thieves) {
+    thief.join();
+  }
+
+  // Assert
+  ASSERT_TRUE(std::all_of(seen.begin(), seen.end(),
+                          [](std::atomic<int> const& n) { return n == 1; }));
+}
+
+TEST(TaskTest, BlocksSendersOfAFullChannel) {
+  // Arrange
+  LoxChannel channel{1};
+  std::atomic<int> sent{0};
+  auto scheduler{std::make_unique<Tasks::Scheduler>(2)};
+
+  // Act
+  scheduler->spawn([&] {
+    for (double value : {1.0, 2.0}) {
+      channel.send(value);
+      ++sent;
+    }
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds{50});
+  int const while_full{sent};
+  Object const first{channel.receive()};
+  Object const second{channel.receive()};
+  scheduler.reset();
+
+  // Assert
+  ASSERT_EQ(1, while_full);
+  ASSERT_EQ(2, sent);
+  ASSERT_EQ(1.0, std::get<double>(first));
+  ASSERT_EQ(2.0, std::get<double>(second));
+}
+
+TEST(TaskTest, JoinRaisesTheErrorOfAFailedTask) {
+  // Arrange
+  Core::Script const script{std::get<Core::Script>(Core::compile(
+      "fun f() { return nil.x; }\n"
+      "var t = spawn f();\n"
+      "join(t);\n"))};
+  Output::MemorySink out{};
+
+  // Act
+  auto const error{Core::execute(script, out)};
+
+  // Assert: at the line the task failed at
+  ASSERT_TRUE(error.has_value());
+  ASSERT_EQ(Core::Error::Phase::RUNTIME, error->phase_);
+  ASSERT_EQ("[line 1] Only instances have properties.", error->message_);
+}
+
+TEST(TaskTest, FailsDeadlockedTasksBeforeGlobalsAreReused) {
+  // Arrange
+  Core::Script const deadlock{std::get<Core::Script>(Core::compile(
+      "var c = Channel(1);\n"
+      "fun f(c) { return receive(c); }\n"
+      "var t = spawn f(c);\n"))};
+  Core::Script const send{
+      std::get<Core::Script>(Core::compile("send(c, 1);\nprint \"sent\";\n"))};
+  Core::Script const join{std::get<Core::Script>(Core::compile("join(t);\n"))};
+  Core::Globals globals{};
+  Output::MemorySink out{};
+
+  // Act
+  auto const deadlocked{Core::execute(deadlock, globals, out)};
+  auto const sent{Core::execute(send, globals, out)};
+  auto const joined{Core::execute(join, globals, out)};
+
+  // Assert: the task no longer waits in the channel, and failed
+  ASSERT_FALSE(deadlocked.has_value());
+  ASSERT_FALSE(sent.has_value());
+  ASSERT_EQ("sent\n", out.contents());
+  ASSERT_TRUE(joined.has_value());
+  ASSERT_EQ("[line 2] Deadlock: every task is waiting.", joined->message_);
+}
+
+TEST(GeneratorTest, ResumesWhereItYielded) {
+  // Arrange
+  Core::Script const script{std::get<Core::Script>(Core::compile(
+      "fun count(n) {\n"
+      "  for (var i = 0; i < n; i = i + 1) yield i;\n"
+      "}\n"
+      "var g = count(3);\n"
+      "print next(g);\n"
+      "while (!done(g)) print next(g);\n"
+      "print done(g);\n"))};
+  Output::MemorySink out{};
+
+  // Act
+  auto const error{Core::execute(script, out)};
+
+  // Assert
+  ASSERT_FALSE(error.has_value());
+  ASSERT_EQ("0\n1\n2\ntrue\n", out.contents());
+}
+
+TEST(BudgetTest, StopsRunawayScripts) {
+  // Arrange
+  Core::Script const loop{std::get<Core::Script>(
+      Core::compile("var i = 0;\nwhile (true) {\n  i = i + 1;\n}\n"))};
+  Core::Script const recursion{std::get<Core::Script>(
+      Core::compile("fun f(n) { return f(n + 1); }\nf(0);\n"))};
+  Output::MemorySink out{};
+
+  // Act
+  auto const statements{Core::execute(loop, out, {.statements_ = 10000})};
+  auto const depth{Core::execute(recursion, out, {.call_depth_ = 100})};
+
+  // Assert
+  ASSERT_TRUE(statements.has_value());
+  ASSERT_EQ(Core::Error::Phase::BUDGET, statements->phase_);
+  ASSERT_EQ("[line 2] Exceeded the statement budget.", statements->message_);
+  ASSERT_TRUE(depth.has_value());
+  ASSERT_EQ("[line 1] Stack overflow.", depth->message_);
+}
+
+TEST(RecursionTest, RecursesAMillionCallsDeep) {
+  // Arrange
+  Core::Script const script{std::get<Core::Script>(Core::compile(
+      "fun depth(n) { if (n == 0) return 0; return depth(n - 1) + 1; }\n"
+      "print depth(1000000);\n"))};
+  Phases::Report report{};
+  Output::MemorySink out{};
+
+  // Act
+  auto const error{Core::execute(script, out, {}, &report)};
+
+  // Assert: under a kilobyte of heap per call, and no native stack
+  ASSERT_FALSE(error.has_value());
+  ASSERT_EQ("1000000\n", out.contents());
+  Phases::Measurement const& interpret{report.phases_.back()};
+  ASSERT_EQ(Phases::Phase::INTERPRET, interpret.phase_);
+  ASSERT_LT(interpret.peak_heap_bytes_, std::uint64_t{1000000} * 1024);
+}
+
+TEST(RecursionTest, StopsRunawayRecursionInBoundedMemory) {
+  // Arrange
+  Core::Script const script{std::get<Core::Script>(
+      Core::compile("fun f(n) { return f(n + 1); }\nf(0);\n"))};
+  Phases::Report report{};
+  Output::MemorySink out{};
+
+  // Act
+  auto const error{Core::execute(script, out, {}, &report)};
+
+  // Assert: the default depth of a million or so calls, under a kilobyte each
+  ASSERT_TRUE(error.has_value());
+  ASSERT_EQ("[line 1] Stack overflow.", error->message_);
+  Phases::Measurement const& interpret{report.phases_.back()};
+  ASSERT_EQ(Phases::Phase::INTERPRET, interpret.phase_);
+  ASSERT_LT(interpret.peak_heap_bytes_, (std::uint64_t{1} << 20) * 1024);
+}
+
+TEST(MethodCallTest, BindsThisWithoutBoundMethods) {
+  // Arrange
+  auto const allocations{[](std::string const& source) {
+    auto const compiled{Core::compile(source)};
+    Output::MemorySink out{};
+    std::uint64_t const before{Memory::allocations()};
+    EXPECT_FALSE(
+        Core::execute(std::get<Core::Script>(compiled), out).has_value());
+    EXPECT_EQ("500500\n", out.contents());
+    return Memory::allocations() - before;
+  }};
+
+  // Act
+  std::uint64_t const methods{allocations(
+      "class P { m(a) { return this.x + a; } }\n"
+      "var p = P(); p.x = 1; var s = 0;\n"
+      "for (var i = 0; i < 1000; i = i + 1) s = s + p.m(i);\n"
+      "print s;\n")};
+  std::uint64_t const functions{allocations(
+      "var x = 1; fun m(a) { return x + a; }\n"
+      "var s = 0;\n"
+      "for (var i = 0; i < 1000; i = i + 1) s = s + m(i);\n"
+      "print s;\n")};
+
+  // Assert: scopes come from the pool, so a function call allocates at most
+  // a copy of the callee, and a method call nothing at all
+  ASSERT_LE(functions, 1000 + 200);
+  ASSERT_LE(methods, 200);
+}
+
+TEST(InheritanceTest, InheritsMethodsAndCallsSuper) {
+  // Arrange
+  auto const compiled{Core::compile(
+      "class A { who() { return \"A\"; } hi() { return \"hi \" + "
+      "this.who(); } }\n"
+      "class B < A { who() { return \"B\" + super.who(); } }\n"
+      "class C < B { who() { return \"C\" + super.who(); } }\n"
+      "print C().hi();\n")};
+  Output::MemorySink out{};
+
+  // Act
+  auto const error{Core::execute(std::get<Core::Script>(compiled), out)};
+
+  // Assert
+  ASSERT_FALSE(error.has_value());
+  ASSERT_EQ("hi CBA\n", out.contents());
+}
+
+TEST(GlobalTest, BindsGlobalsDeclaredAfterUse) {
+  // Arrange
+  auto const compiled{Core::compile(
+      "fun even(n) { if (n == 0) return true; { return odd(n - 1); } }\n"
+      "fun odd(n) { if (n == 0) return false; { return even(n - 1); } }\n"
+      "print even(10);\n"
+      "print later;\n"
+      "var later = 1;\n")};
+  Output::MemorySink out{};
+
+  // Act
+  auto const error{Core::execute(std::get<Core::Script>(compiled), out)};
+
+  // Assert
+  ASSERT_EQ("true\n", out.contents());
+  ASSERT_TRUE(error.has_value());
+  ASSERT_EQ("[line 4] later is not defined", error->message_);
+}
+
+TEST(GlobalTest, SharesSlotsBetweenScriptsCompiledApart) {
+  // Arrange
+  Core::Script const first{std::get<Core::Script>(
+      Core::compile("var total = 1;\n"))};
+  Core::Script const second{std::get<Core::Script>(
+      Core::compile("var step = 2;\ntotal = total + step;\nprint total;\n"))};
+  std::optional<Program> decoded{
+      Serializer::deserialize(Serializer::serialize(second.program()))};
+  Core::Globals globals{};
+  Output::MemorySink out{};
+
+  // Act
+  auto const defined{Core::execute(first, globals, out)};
+  auto const added{Core::execute(second, globals, out)};
+  auto const cached{
+      Core::execute(Core::Script{std::move(*decoded)}, globals, out)};
+
+  // Assert
+  ASSERT_FALSE(defined.has_value());
+  ASSERT_FALSE(added.has_value());
+  ASSERT_FALSE(cached.has_value());
+  ASSERT_EQ("3\n5\n", out.contents());
+}
+
+TEST(ClosureTest, SharesOnlyTheVariablesItUses) {
+  // Arrange
+  auto const compiled{Core::compile(
+      "fun make() {\n"
+      "  var unused = \"large\";\n"
+      "  var count = 0;\n"
+      "  fun inc() { count = count + 1; return count; }\n"
+      "  fun get() { return count; }\n"
+      "  inc();\n"
+      "  return get;\n"
+      "}\n"
+      "print make()();\n")};
+  auto const& script{std::get<Core::Script>(compiled)};
+  auto const& make{
+      std::get<Box<FunctionStatement>>(script.program().statements_[0])};
+  auto const& body{std::get<Box<BlockStatement>>(make->body_.front())};
+  auto const& get{std::get<Box<FunctionStatement>>(body->statements_[3])};
+  Output::MemorySink out{};
+
+  // Act
+  auto const error{Core::execute(script, out)};
+
+  // Assert
+  ASSERT_FALSE(error.has_value());
+  ASSERT_EQ("1\n", out.contents());
+  ASSERT_EQ(std::size_t{1}, get->captures_.size());
+  ASSERT_EQ("count", get->captures_[0].name_);
+}
+
+TEST(PoolTest, ReusesEnvironmentsOfCalls) {
+  // Arrange
+  auto const compiled{Core::compile(
+      "fun add(a, b) { return a + b; }\n"
+      "var total = 0;\n"
+      "for (var i = 0; i < 10000; i = i + 1) total = add(total, i);\n"
+      "print total;\n")};
+  Phases::Report report{};
+  Output::MemorySink out{};
+
+  // Act
+  auto const error{
+      Core::execute(std::get<Core::Script>(compiled), out, {}, &report)};
+
+  // Assert
+  ASSERT_FALSE(error.has_value());
+  ASSERT_EQ("49995000\n", out.contents());
+  Phases::Measurement const& interpret{report.phases_.back()};
+  ASSERT_EQ(Phases::Phase::INTERPRET, interpret.phase_);
+  ASSERT_GT(interpret.pool_hits_, 10000);
+  ASSERT_LT(interpret.pool_misses_, interpret.pool_hits_ / 100);
+}
+
+TEST(PhasesTest, MeasuresEachPhase) {
+  // Arrange
+  Phases::Report report{};
+  Output::MemorySink out{};
+
+  // Act
+  auto const compiled{Core::compile("var a = 1;\nprint a + 2;", {}, nullptr,
+                                    &report)};
+  auto const error{
+      Core::execute(std::get<Core::Script>(compiled), out, {}, &report)};
+
+  // Assert
+  ASSERT_FALSE(error.has_value());
+  ASSERT_EQ(4, report.phases_.size());
+  ASSERT_EQ(Phases::Phase::SCAN, report.phases_[0].phase_);
+  ASSERT_EQ(Phases::Phase::INTERPRET, report.phases_[3].phase_);
+  ASSERT_EQ(11, report.tokens_);
+  ASSERT_EQ(6, report.nodes_);
+  // The declaration of a as well as its use
+  ASSERT_EQ(2, report.resolved_names_);
+}
+
+TEST(ProfilerTest, SamplesLoxCalls) {
+  // Arrange
+  auto const compiled{Core::compile(
+      "fun spin(n) { var i = 0; while (i < n) i = i + 1; return i; }\n"
+      "var total = 0;\n"
+      "for (var i = 0; i < 100; i = i + 1) total = total + spin(10000);\n")};
+  Output::MemorySink out{};
+  Profiler::Sampler sampler{std::chrono::microseconds{100}};
+
+  // Act
+  auto const error{Core::execute(std::get<Core::Script>(compiled), out)};
+  std::ostringstream folded{};
+  sampler.write_folded(folded);
+
+  // Assert
+  ASSERT_FALSE(error.has_value());
+  ASSERT_NE(std::string::npos, folded.str().find("<script>:3;spin:1 "));
+}
+
+TEST(HeapProfileTest, AttributesAllocationsToSites) {
+  // Arrange
+  auto const compiled{Core::compile(
+      "var s = \"\";\n"
+      "for (var i = 0; i < 100; i = i + 1) s = s + \"abcdefghijklmnopq\";\n")};
+  Output::MemorySink out{};
+
+  // Act
+  Memory::start_profile();
+  auto const error{Core::execute(std::get<Core::Script>(compiled), out)};
+  Memory::Profile const profile{Memory::stop_profile()};
+
+  // Assert
+  ASSERT_FALSE(error.has_value());
+  auto const concatenation{std::find_if(
+      profile.sites_.begin(), profile.sites_.end(),
+      [](Memory::SiteUsage const& site) {
+        return site.category_ == Memory::Category::STRING && site.line_ == 2;
+      })};
+  ASSERT_NE(profile.sites_.end(), concatenation);
+  ASSERT_LE(100, concatenation->allocations_);
+  ASSERT_LT(0, profile.peak_live_bytes_);
+}
+
+TEST(CountersTest, CountsNodesAndBranches) {
+  // Arrange
+  auto const compiled{Core::compile(
+      "var i = 0;\n"
+      "while (i < 3) i = i + 1;\n")};
+  auto const& script{std::get<Core::Script>(compiled)};
+  Counters::Profile counters{script.program().statements_};
+  Output::MemorySink out{};
+
+  // Act
+  auto const error{Core::execute(script, out, {}, nullptr, &counters)};
+  std::ostringstream json{};
+  counters.write_json(json);
+
+  // Assert
+  ASSERT_FALSE(error.has_value());
+  ASSERT_NE(std::string::npos,
+            json.str().find("\"2\": {\"2\": {\"kind\": \"while\", "
+                            "\"executed\": 1, \"taken\": 3, "
+                            "\"not_taken\": 1}"));
+}
+
+TEST(TraceTest, RecordsPhasesAndCalls) {
+  // Arrange
+  Output::MemorySink out{};
+  std::ostringstream json{};
+
+  // Act
+  {
+    Trace::Recorder const recorder{};
+    auto const compiled{Core::compile(
+        "fun add(a, b) { return a + b; }\n"
+        "print add(1, 2);\n")};
+    ASSERT_FALSE(
+        Core::execute(std::get<Core::Script>(compiled), out).has_value());
+    recorder.write_json(json);
+  }
+
+  // Assert
+  ASSERT_NE(std::string::npos,
+            json.str().find("{\"name\": \"scan\", \"cat\": \"phase\""));
+  ASSERT_NE(std::string::npos,
+            json.str().find("{\"name\": \"add\", \"cat\": \"call\""));
+  ASSERT_NE(std::string::npos, json.str().find("\"args\": {\"line\": 2}"));
+}
+
+TEST(IoTest, TransfersThroughFilesAndPipes) {
+  for (Io::Loop::Kind const kind :
+       {Io::Loop::Kind::EPOLL, Io::Loop::Kind::IO_URING}) {
+    // Arrange
+    Io::Loop loop{kind};
+    std::string const file{testing::TempDir() + "lox_io_test.txt"};
+    std::array<int, 2> ends{};
+    ASSERT_EQ(0, pipe(ends.data()));
+    std::string const pipe_writer{"/proc/self/fd/" + std::to_string(ends[1])};
+    std::string const pipe_reader{"/proc/self/fd/" + std::to_string(ends[0])};
+
+    // Act
+    std::promise<Io::Result<std::size_t>> file_written{};
+    std::promise<Io::Result<std::size_t>> pipe_written{};
+    loop.write_file(file, "to a file", [&](Io::Result<std::size_t> result) {
+      file_written.set_value(result);
+    });
+    loop.write_file(pipe_writer, "through a pipe",
+                    [&](Io::Result<std::size_t> result) {
+                      pipe_written.set_value(result);
+                    });
+    Io::Result<std::size_t> const file_bytes{file_written.get_future().get()};
+    Io::Result<std::size_t> const pipe_bytes{pipe_written.get_future().get()};
+    // The reader only finds the end once every writer is gone
+    close(ends[1]);
+
+    std::promise<Io::Result<std::string>> file_read{};
+    std::promise<Io::Result<std::string>> pipe_read{};
+    loop.read_file(file, [&](Io::Result<std::string> result) {
+      file_read.set_value(result);
+    });
+    loop.read_file(pipe_reader, [&](Io::Result<std::string> result) {
+      pipe_read.set_value(result);
+    });
+    Io::Result<std::string> const file_contents{file_read.get_future().get()};
+    Io::Result<std::string> const pipe_contents{pipe_read.get_future().get()};
+    close(ends[0]);
+
+    // Assert
+    ASSERT_EQ(std::size_t{9}, std::get<std::size_t>(file_bytes));
+    ASSERT_EQ(std::size_t{14}, std::get<std::size_t>(pipe_bytes));
+    ASSERT_EQ("to a file", std::get<std::string>(file_contents));
+    ASSERT_EQ("through a pipe", std::get<std::string>(pipe_contents));
+  }
+}
+
+TEST(IoTest, GivesEachSetOfGlobalsItsOwnLoop) {
+  // Arrange
+  std::map<std::string, Object> const first{builtins()};
+  std::map<std::string, Object> const second{builtins()};
+  auto const state{[](std::map<std::string, Object> const& natives,
+                      std::string const& name) {
+    return std::get<std::shared_ptr<NativeFunction>>(natives.at(name))
+        ->state_;
+  }};
+  Core::Script const script{std::get<Core::Script>(
+      Core::compile("join(writeFile(path, text));\n"
+                    "join(timer(0.01));\n"
+                    "print join(readFile(path));\n",
+                    {"path", "text"}))};
+  std::vector<std::unique_ptr<Core::Isolate>> isolates{};
+  std::vector<Output::MemorySink*> sinks{};
+  for (std::string const text : {"first", "second"}) {
+    auto out{std::make_unique<Output::MemorySink>()};
+    sinks.push_back(out.get());
+    isolates.push_back(std::make_unique<Core::Isolate>(script, std::move(out)));
+    isolates.back()->globals().define(
+        "path", testing::TempDir() + "lox_io_" + text + ".txt");
+    isolates.back()->globals().define("text", text);
+  }
+
+  // Act
+  {
+    Core::Pool pool{2};
+    auto first_run{pool.submit(*isolates[0])};
+    auto second_run{pool.submit(*isolates[1])};
+    ASSERT_FALSE(first_run.get().has_value());
+    ASSERT_FALSE(second_run.get().has_value());
+  }
+
+  // Assert
+  ASSERT_NE(nullptr, state(first, "timer"));
+  ASSERT_EQ(state(first, "readFile"), state(first, "timer"));
+  ASSERT_NE(state(first, "timer"), state(second, "timer"));
+  ASSERT_EQ(nullptr, state(first, "clock"));
+  ASSERT_EQ("first\n", sinks[0]->contents());
+  ASSERT_EQ("second\n", sinks[1]->contents());
+}